@@ -0,0 +1,159 @@
+/// \file
+/// \brief Benchmark of the parse success and quashed error paths against
+/// nesting depth.
+///
+/// Documents of nested maps, {"a": {"a": ... {"v": 1} ... }}, are parsed
+/// with a matching schema at a range of depths, with logging and error
+/// handling left at their defaults. The time per level should be flat, as
+/// nothing about the path to a value is rendered or formatted unless it
+/// is actually logged or reported.
+///
+/// The same documents with an unexpected key at the deepest level are then
+/// parsed with an error handler which quashes the error, and with a lazy
+/// one which does the same without asking for the message, to show what
+/// rendering the stack path and formatting the message costs.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "easyjsonparser.h"
+
+
+#define BENCH_NODES_PER_RUN 4000000
+
+
+/// Count the values seen, so the parse can't be optimised away.
+
+static void bench_handle_v (easyjsonparser_stack * stack, int val, long * sum)
+{
+  *sum += val;
+}
+
+
+/// Quash every error, as a caller skipping over what it doesn't
+/// understand would.
+
+static int bench_quash (int err_code, const void * data, const char * reason, const char * errmsg)
+{
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Quash every error, without the message being formatted.
+
+static int bench_quash_lazy (int err_code, const void * data, const char * reason, easyjsonparser_error * err)
+{
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Build a document nested \p depth maps deep, with an unexpected key
+/// alongside the value if \p errors is set.
+
+static char * bench_mk_json (int depth, int errors)
+{
+  char * json = (char *) malloc(depth * 7 + 24);
+  char * p    = json;
+
+  for (int i = 0; i < depth; i++)
+    p += sprintf(p, "{\"a\": ");
+  p += sprintf(p, errors ? "{\"x\": 0, \"v\": 1}" : "{\"v\": 1}");
+  for (int i = 0; i < depth; i++)
+    *p++ = '}';
+  *p = '\0';
+
+  return json;
+}
+
+
+/// Build the schema for a document \p depth maps deep, the schema entry
+/// arrays are allocated in one block.
+
+static easyjsonparser_schema * bench_mk_schema (int depth)
+{
+  easyjsonparser_schema * ys = (easyjsonparser_schema *) calloc((depth + 2) * 2, sizeof(easyjsonparser_schema));
+
+  ys[0].type = EASYJSONPARSER_SCHEMA_ROO | EASYJSONPARSER_SCHEMA_MAP;
+
+  easyjsonparser_schema * sub = ys + 1;
+  for (int i = 0; i < depth; i++, sub += 2) {
+    sub[0].key   = "a";
+    sub[0].type  = EASYJSONPARSER_SCHEMA_MAP;
+    sub[0].data  = sub + 2;
+    sub[0].descr = "nested map";
+  }
+  sub[0].key   = "v";
+  sub[0].type  = EASYJSONPARSER_SCHEMA_INT;
+  sub[0].data  = bench_handle_v;
+  sub[0].descr = "value";
+
+  return ys;
+}
+
+
+static double bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main (int argc, char ** argv)
+{
+  static const int depths[] = { 1, 4, 16, 64, 256 };
+  // The json-c tokener refuses documents nested more than 32 deep.
+  static const struct { int backend; const char * name; int max_depth; } backends[] = {
+    { EASYJSONPARSER_BACKEND_NATIVE, "native", 256 },
+    { EASYJSONPARSER_BACKEND_JSONC,  "json-c", 30 },
+  };
+
+  static const char * handlers[] = { "none", "quash", "lazy" };
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+
+  printf("%-8s %-8s %6s %12s %14s %12s\n", "backend", "handler", "depth", "parses", "ns/parse", "ns/level");
+
+  for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+    for (size_t h = 0; h < sizeof(handlers) / sizeof(handlers[0]); h++) {
+      easyjsonparser_ctx_reset(ctx);
+      easyjsonparser_ctx_set_backend(ctx, backends[b].backend);
+      if (h == 1)
+        easyjsonparser_ctx_set_errhandler(ctx, bench_quash);
+      else if (h == 2)
+        easyjsonparser_ctx_set_errhandler_lazy(ctx, bench_quash_lazy);
+
+      for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]) && depths[d] <= backends[b].max_depth; d++) {
+        int                     depth = depths[d];
+        char *                  json  = bench_mk_json(depth, h != 0);
+        size_t                  len   = strlen(json);
+        easyjsonparser_schema * ys    = bench_mk_schema(depth);
+        long                    runs  = BENCH_NODES_PER_RUN / (depth + 1);
+        long                    sum   = 0;
+
+        double start = bench_now();
+        for (long i = 0; i < runs; i++)
+          if (easyjsonparser_ctx_parse_buffer(ctx, json, len, ys, &sum) != EASYJSONPARSER_SUCCESS)
+            return EXIT_FAILURE;
+        double elapsed = bench_now() - start;
+
+        if (sum != runs)
+          return EXIT_FAILURE;
+
+        printf("%-8s %-8s %6d %12ld %14.1f %12.2f\n", backends[b].name, handlers[h], depth, runs,
+               elapsed * 1e9 / runs, elapsed * 1e9 / runs / (depth + 1));
+
+        free(ys);
+        free(json);
+      }
+    }
+  }
+
+  easyjsonparser_ctx_free(ctx);
+
+  return EXIT_SUCCESS;
+}
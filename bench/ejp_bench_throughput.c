@@ -0,0 +1,134 @@
+/// \file
+/// \brief Benchmark of parse throughput on a large document.
+///
+/// A document of some tens of megabytes of records, each a map of strings
+/// (a few with escapes), integers and a short list, is parsed with a
+/// matching schema by the native backend, with and without the structural
+/// index and UTF-8 validation, and by the json-c backend, reporting GB/s
+/// for each.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "easyjsonparser.h"
+#include "easyjsonparser_internal.h"
+
+
+#define BENCH_RECORDS 200000
+#define BENCH_RUNS    5
+
+
+/// Count the values seen, so the parse can't be optimised away.
+
+static void bench_handle_str (easyjsonparser_stack * stack, char * val, long * sum)
+{
+  *sum += val[0];
+}
+
+static void bench_handle_int (easyjsonparser_stack * stack, int val, long * sum)
+{
+  *sum += val;
+}
+
+
+static EASYJSONPARSER_SUBSCHEMA(bench_access_schema)
+  EASYJSONPARSER_STR(NULL, bench_handle_str, "access right"),
+  EASYJSONPARSER_END();
+
+static EASYJSONPARSER_SUBSCHEMA(bench_record_schema)
+  EASYJSONPARSER_INT("id", bench_handle_int, "record id"),
+  EASYJSONPARSER_STR("name", bench_handle_str, "record name"),
+  EASYJSONPARSER_STR("email", bench_handle_str, "record email"),
+  EASYJSONPARSER_STR("comment", bench_handle_str, "record comment"),
+  EASYJSONPARSER_INT("quota", bench_handle_int, "record quota"),
+  EASYJSONPARSER_LST("access", bench_access_schema, "record access list"),
+  EASYJSONPARSER_END();
+
+static EASYJSONPARSER_SUBSCHEMA(bench_records_schema)
+  EASYJSONPARSER_MAP(NULL, bench_record_schema, "record"),
+  EASYJSONPARSER_END();
+
+static EASYJSONPARSER_SCHEMA(bench_schema, EASYJSONPARSER_SCHEMA_MAP)
+  EASYJSONPARSER_LST("records", bench_records_schema, "records"),
+  EASYJSONPARSER_END();
+
+
+/// Build the document, returning its length in \p len.
+
+static char * bench_mk_json (size_t * len)
+{
+  char * json = (char *) malloc((size_t) BENCH_RECORDS * 320 + 64);
+  char * p    = json;
+
+  p += sprintf(p, "{\"records\": [\n");
+  for (int i = 0; i < BENCH_RECORDS; i++) {
+    p += sprintf(p,
+                 "%s  {\"id\": %d, \"name\": \"user number %d of the benchmark\", "
+                 "\"email\": \"user%d@example.com\", "
+                 "\"comment\": \"%s\", \"quota\": %d, "
+                 "\"access\": [\"read\", \"write\", \"admin\"]}",
+                 i ? ",\n" : "", i, i, i,
+                 i % 8 == 0
+                   ? "a comment with \\\"quotes\\\" and a \\\\ backslash in it, {not: [structural]}"
+                   : "a comment with nothing special in it at all, but quite long all the same",
+                 i * 7);
+  }
+  p += sprintf(p, "\n]}\n");
+
+  *len = p - json;
+  return json;
+}
+
+
+static double bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main (int argc, char ** argv)
+{
+  static const struct { int backend; const char * name; size_t index_min; int options; } runs[] = {
+    { EASYJSONPARSER_BACKEND_NATIVE, "native (indexed)",  0,        0 },
+    { EASYJSONPARSER_BACKEND_NATIVE, "native (trusted)",  0,        EASYJSONPARSER_OPTION_TRUSTED_INPUT },
+    { EASYJSONPARSER_BACKEND_NATIVE, "native (no index)", SIZE_MAX, 0 },
+    { EASYJSONPARSER_BACKEND_JSONC,  "json-c",            0,        0 },
+  };
+
+  size_t len;
+  char * json = bench_mk_json(&len);
+
+  printf("%-20s %10s %10s %8s\n", "backend", "MB", "ms/parse", "GB/s");
+
+  for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+    easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+    easyjsonparser_ctx_set_backend(ctx, runs[r].backend);
+    easyjsonparser_ctx_set_options(ctx, runs[r].options);
+    ctx->index_min = runs[r].index_min;
+
+    double best = 0;
+    for (int i = 0; i < BENCH_RUNS; i++) {
+      long sum = 0;
+      double start = bench_now();
+      if (easyjsonparser_ctx_parse_buffer(ctx, json, len, bench_schema, &sum) != EASYJSONPARSER_SUCCESS)
+        return EXIT_FAILURE;
+      double elapsed = bench_now() - start;
+      if (i == 0 || elapsed < best)
+        best = elapsed;
+    }
+
+    printf("%-20s %10.1f %10.1f %8.3f\n", runs[r].name, len / 1e6, best * 1e3, len / best / 1e9);
+
+    easyjsonparser_ctx_free(ctx);
+  }
+
+  free(json);
+
+  return EXIT_SUCCESS;
+}
@@ -4,28 +4,77 @@
 #include <stdarg.h>
 #include <malloc.h>
 #include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "config.h"
-#include "easyjsonparser.h"
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include "easyjsonparser_internal.h"
+
+#ifndef THREAD_LOCAL
+#define THREAD_LOCAL
+#endif
 
 
 /// Local function declarations.
 
-static int    parse (json_object * jobj, easyjsonparser_schema * js, void * cfg);
-static int    rec_parse (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * c);
-static int    rec_parse_obj (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * c);
-static int    rec_parse_obj_varkeys (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
-static int    rec_parse_obj_fixedkeys (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
-static int    rec_parse_list (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * c);
+static int    parse (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, void * cfg);
+static int    rec_parse (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * c);
+static int    rec_parse_obj (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * c, int lenient);
+static int    rec_parse_obj_varkeys (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
+static int    rec_parse_obj_fixedkeys (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg, int lenient);
+static int    rec_parse_list (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * c);
+static int    rec_parse_array (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * c);
 static char * jobj_type_to_str (enum json_type jobj_type);
+static int    jobj_type_to_schema (enum json_type jobj_type);
+static struct json_tokener * tokener_new (easyjsonparser_ctx * ctx);
 static char * stack_render_rec (easyjsonparser_stack * stack, char * buf, char * buf_of);
-static int    error_handler (int err_code, const void * data, const char * reason, const char * errmsg_fmt, ...);
-
-/// Logger, log level and error handler intialisation.
+static void   ejp_vlog (easyjsonparser_ctx * ctx, int level, const char * fmt, va_list args);
+
+/// Push parser state, see \ref easyjsonparser_parser_new.
+
+struct easyjsonparser_parser_st {
+  easyjsonparser_ctx      ctx;
+  easyjsonparser_schema * js;
+  void *                  cfg;
+  int                     complete;
+  int                     retval;
+  size_t                  offset;
+  ejp_utf8_stream         utf8;
+};
+
+/// An error being reported to a lazy error handler, see
+/// \ref easyjsonparser_error_message.
+
+struct easyjsonparser_error_st {
+  easyjsonparser_ctx *   ctx;
+  easyjsonparser_stack * stack;
+  const char *           fmt;
+  va_list *              args;
+  const char *           msg;
+  char                   buf[MAX_LOGMSG_LEN];
+};
+
+/// Logger, log level, error handler, backend and option defaults, which each
+/// context takes a copy of when it is created. Nothing else is shared
+/// between parses, so parsing is reentrant and contexts may be used by
+/// different threads at once, so long as these are not changed meanwhile.
 
 static int logger_loglevel = EASYJSONPARSER_LOG_LEVEL_ERROR;
 static void (*alt_logger)(int level, const char * fmt) = NULL;
 static int (*alt_errhandler)(int err_code, const void * data, const char * reason, const char * errmsg_fmt) = NULL;
+static int (*alt_errhandler_lazy)(int err_code, const void * data, const char * reason, easyjsonparser_error * err) = NULL;
+static int backend = EASYJSONPARSER_BACKEND_NATIVE;
+static int options = 0;
+static size_t max_depth = EJP_MAX_DEPTH;
 
 
 /// Set the log level (used only by the default logger).
@@ -48,31 +97,340 @@ void easyjsonparser_set_logger (void (*logger)(int, const char *))
 
 void easyjsonparser_set_errhandler (int (*handler)(int, const void *, const char *, const char *))
 {
-  alt_errhandler = handler;
+  alt_errhandler      = handler;
+  alt_errhandler_lazy = NULL;
+}
+
+
+/// Replace the error handler with one which formats the error message
+/// only if it asks for it, see \ref easyjsonparser_error_message.
+
+void easyjsonparser_set_errhandler_lazy (int (*handler)(int, const void *, const char *, easyjsonparser_error *))
+{
+  alt_errhandler_lazy = handler;
+  alt_errhandler      = NULL;
+}
+
+
+/// Select the parser backend.
+
+void easyjsonparser_set_backend (int new_backend)
+{
+  backend = new_backend;
+}
+
+
+/// Set the parse options, a combination of the EASYJSONPARSER_OPTION_*
+/// flags.
+
+void easyjsonparser_set_options (int new_options)
+{
+  options = new_options;
+}
+
+
+/// Set how deep maps and lists may be nested, deeper input being an
+/// \ref EASYJSONPARSER_ERROR_PARSE_DEPTH error.
+
+void easyjsonparser_set_max_depth (size_t new_max_depth)
+{
+  max_depth = new_max_depth;
 }
 
 
-/// Open and parse the JSON file.
+/// Open and parse the JSON file (with a context private to this call).
 
 int easyjsonparser_parse_file (const char * filename, easyjsonparser_schema * js, void * cfg)
 {
-  FILE * fh = fopen(filename, "r");
-  if (fh == NULL)
-    return error_handler(EASYJSONPARSER_ERROR_FILEOPEN, filename, strerror(errno), "error opening config file (%s)", strerror(errno));
+  easyjsonparser_ctx ctx;
+  ejp_ctx_init(&ctx);
+
+  int retval = easyjsonparser_ctx_parse_file(&ctx, filename, js, cfg);
+
+  ejp_ctx_release(&ctx);
+  return retval;
+}
+
+
+/// Parse the zero byte terminated JSON string (with a context private to
+/// this call).
+
+int easyjsonparser_parse_string (const char * input_string, easyjsonparser_schema * js, void * cfg)
+{
+  return easyjsonparser_parse_buffer(input_string, strlen(input_string), js, cfg);
+}
+
+
+/// Parse \p len bytes of JSON at \p buf (with a context private to this
+/// call), the buffer need not be zero byte terminated.
+
+int easyjsonparser_parse_buffer (const char * buf, size_t len, easyjsonparser_schema * js, void * cfg)
+{
+  easyjsonparser_ctx ctx;
+  ejp_ctx_init(&ctx);
+
+  int retval = easyjsonparser_ctx_parse_buffer(&ctx, buf, len, js, cfg);
+
+  ejp_ctx_release(&ctx);
+  return retval;
+}
+
+
+/// Initialise a context, taking the current process wide logger, log
+/// level, error handler, backend and options.
+
+void ejp_ctx_init (easyjsonparser_ctx * ctx)
+{
+  ctx->loglevel        = logger_loglevel;
+  ctx->logger          = alt_logger;
+  ctx->errhandler      = alt_errhandler;
+  ctx->errhandler_lazy = alt_errhandler_lazy;
+  ctx->error_stack     = NULL;
+  ctx->backend         = backend;
+  ctx->tokener         = NULL;
+  ctx->scratch         = NULL;
+  ctx->scratch_size    = 0;
+  ctx->compiled        = 0;
+  ctx->lenient         = 0;
+  ctx->arena           = NULL;
+  ctx->own_arena       = NULL;
+  ctx->intern          = NULL;
+  ctx->own_intern      = NULL;
+  ctx->index_entries   = NULL;
+  ctx->index_min       = EJP_INDEX_MIN;
+  ctx->isa             = EJP_ISA_BEST;
+  ctx->options         = options;
+  ctx->max_depth       = max_depth;
+  ctx->frames          = NULL;
+  ctx->frames_size     = 0;
+}
+
+
+/// Release everything a context has allocated, the counterpart of
+/// \ref ejp_ctx_init.
+
+void ejp_ctx_release (easyjsonparser_ctx * ctx)
+{
+  if (ctx->tokener != NULL)
+    json_tokener_free(ctx->tokener);
+  free(ctx->scratch);
+  easyjsonparser_arena_free(ctx->own_arena);
+  easyjsonparser_intern_free(ctx->own_intern);
+  free(ctx->index_entries);
+  free(ctx->frames);
+}
+
+
+/// Create a parser context. A context owns the tokener and scratch buffers
+/// a parse needs, and its own logger, log level, error handler and backend
+/// (initially the process wide ones), so that a context reused for many
+/// parses makes no allocations once warmed up, and contexts used by
+/// different threads share nothing.
+
+easyjsonparser_ctx * easyjsonparser_ctx_new (void)
+{
+  easyjsonparser_ctx * ctx = (easyjsonparser_ctx *) malloc(sizeof(easyjsonparser_ctx));
+  if (ctx == NULL)
+    return NULL;
+
+  ejp_ctx_init(ctx);
+
+  return ctx;
+}
+
+
+/// Free a parser context.
+
+void easyjsonparser_ctx_free (easyjsonparser_ctx * ctx)
+{
+  if (ctx == NULL)
+    return;
+
+  ejp_ctx_release(ctx);
+  free(ctx);
+}
+
+
+/// Reset a parser context, returning its logger, log level, error handler,
+/// backend and options to the process wide ones and unsetting its arena
+/// and intern table, but keeping the buffers it has allocated for reuse.
+
+void easyjsonparser_ctx_reset (easyjsonparser_ctx * ctx)
+{
+  ctx->loglevel        = logger_loglevel;
+  ctx->logger          = alt_logger;
+  ctx->errhandler      = alt_errhandler;
+  ctx->errhandler_lazy = alt_errhandler_lazy;
+  ctx->backend         = backend;
+  ctx->options         = options;
+  ctx->arena           = NULL;
+  ctx->intern          = NULL;
+
+  easyjsonparser_ctx_set_max_depth(ctx, max_depth);
+
+  if (ctx->tokener != NULL)
+    json_tokener_reset(ctx->tokener);
+}
+
+
+/// Set the log level of a context (used only by the default logger).
+
+void easyjsonparser_ctx_set_loglevel (easyjsonparser_ctx * ctx, int loglevel)
+{
+  ctx->loglevel = loglevel;
+}
+
+
+/// Replace the logger of a context.
+
+void easyjsonparser_ctx_set_logger (easyjsonparser_ctx * ctx, void (*logger)(int, const char *))
+{
+  ctx->logger = logger;
+}
+
+
+/// Replace the error handler of a context.
+
+void easyjsonparser_ctx_set_errhandler (easyjsonparser_ctx * ctx, int (*handler)(int, const void *, const char *, const char *))
+{
+  ctx->errhandler      = handler;
+  ctx->errhandler_lazy = NULL;
+}
+
+
+/// Replace the error handler of a context with one which formats the error
+/// message only if it asks for it, see \ref easyjsonparser_error_message.
+
+void easyjsonparser_ctx_set_errhandler_lazy (easyjsonparser_ctx * ctx, int (*handler)(int, const void *, const char *, easyjsonparser_error *))
+{
+  ctx->errhandler_lazy = handler;
+  ctx->errhandler      = NULL;
+}
+
+
+/// Select the parser backend of a context.
+
+void easyjsonparser_ctx_set_backend (easyjsonparser_ctx * ctx, int new_backend)
+{
+  ctx->backend = new_backend;
+}
+
+
+/// Set the parse options of a context, a combination of the
+/// EASYJSONPARSER_OPTION_* flags.
+
+void easyjsonparser_ctx_set_options (easyjsonparser_ctx * ctx, int new_options)
+{
+  ctx->options = new_options;
+}
+
+
+/// Set how deep maps and lists may be nested for parses with a context.
+/// The json-c tokener is made again for the new depth when next needed.
+
+void easyjsonparser_ctx_set_max_depth (easyjsonparser_ctx * ctx, size_t new_max_depth)
+{
+  if (new_max_depth != ctx->max_depth && ctx->tokener != NULL) {
+    json_tokener_free(ctx->tokener);
+    ctx->tokener = NULL;
+  }
+
+  ctx->max_depth = new_max_depth;
+}
+
+
+/// Set the arena of a context, which \ref easyjsonparser_stack_arena gives
+/// callbacks and strings bound to struct fields are copied into, so the
+/// results of a parse may be released in one go. The arena is not owned by
+/// the context, and may be NULL to go back to one private to each parse.
+
+void easyjsonparser_ctx_set_arena (easyjsonparser_ctx * ctx, easyjsonparser_arena * arena)
+{
+  ctx->arena = arena;
+}
+
+
+/// Set the intern table of a context, which strings for intern schema
+/// entries (see \ref EASYJSONPARSER_STR_INTERN) are added to, so that ids
+/// and pointers are shared by every parse with the context. The table is
+/// not owned by the context, and may be NULL to go back to one private to
+/// each parse.
+
+void easyjsonparser_ctx_set_intern (easyjsonparser_ctx * ctx, easyjsonparser_intern * intern)
+{
+  ctx->intern = intern;
+}
+
+
+/// Open and parse the JSON file. Regular files are mapped and parsed in
+/// place, anything else (pipes, procfs and so on) is read into memory.
+
+int easyjsonparser_ctx_parse_file (easyjsonparser_ctx * ctx, const char * filename, easyjsonparser_schema * js, void * cfg)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_FILEOPEN, filename, strerror(errno), "error opening config file (%s)", strerror(errno));
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int fstat_errno = errno;
+    close(fd);
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_FILEREAD, filename, strerror(fstat_errno), "error reading config file (%s)", strerror(fstat_errno));
+  }
+
+#ifdef HAVE_MMAP
+  if (S_ISREG(st.st_mode) && st.st_size > 0 && (uint64_t) st.st_size <= SIZE_MAX) {
+    size_t map_len = (size_t) st.st_size;
+    void * map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      close(fd);
+#ifdef HAVE_MADVISE
+      madvise(map, map_len, MADV_SEQUENTIAL);
+#endif
+      int retval = easyjsonparser_ctx_parse_buffer(ctx, map, map_len, js, cfg);
+      munmap(map, map_len);
+      return retval;
+    }
+  }
+#endif
+
+  // Not mappable, so read it, in one go if the size is known, growing the
+  // buffer geometrically if not.
+  size_t buf_size = S_ISREG(st.st_mode) && st.st_size > 0 ? (size_t) st.st_size + 1 : 4096;
+  size_t buf_used = 0;
+  char * buf = (char *) malloc(buf_size);
+
+  for (;;) {
+    if (buf == NULL) {
+      close(fd);
+      return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, filename,
+                               "out of memory",
+                               "could not allocate %zu bytes while reading config file", buf_size);
+    }
 
-  char * buf = NULL;
-  int buf_size = 0, buf_used = 0;
-  for (int read_len = -1; read_len != 0;) {
-    if (buf_size - buf_used == 0) {
-      buf_size += 1024;
-      buf = (char *) realloc(buf, buf_size);
+    ssize_t read_len = read(fd, buf + buf_used, buf_size - buf_used);
+    if (read_len < 0) {
+      if (errno == EINTR)
+        continue;
+      int read_errno = errno;
+      free(buf);
+      close(fd);
+      return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_FILEREAD, filename, strerror(read_errno), "error reading config file (%s)", strerror(read_errno));
     }
-    read_len = fread(buf, 1, buf_size - buf_used, fh);
+    if (read_len == 0)
+      break;
+
     buf_used += read_len;
+    if (buf_used == buf_size) {
+      char * new_buf = (char *) realloc(buf, buf_size *= 2);
+      if (new_buf == NULL)
+        free(buf);
+      buf = new_buf;
+    }
   }
-  fclose(fh);
+  close(fd);
 
-  int retval = easyjsonparser_parse_string(buf, js, cfg);
+  int retval = easyjsonparser_ctx_parse_buffer(ctx, buf, buf_used, js, cfg);
   free(buf);
   return retval;
 }
@@ -80,64 +438,294 @@ int easyjsonparser_parse_file (const char * filename, easyjsonparser_schema * js
 
 /// Parse the zero byte terminated JSON string.
 
-int easyjsonparser_parse_string (const char * input_string, easyjsonparser_schema * js, void * cfg)
+int easyjsonparser_ctx_parse_string (easyjsonparser_ctx * ctx, const char * input_string, easyjsonparser_schema * js, void * cfg)
 {
-  struct json_tokener * parser = json_tokener_new();
+  return easyjsonparser_ctx_parse_buffer(ctx, input_string, strlen(input_string), js, cfg);
+}
+
 
-  struct json_object * jobj = json_tokener_parse_ex(parser, input_string, strlen(input_string));
+/// Parse \p len bytes of JSON at \p buf with the backend selected for the
+/// context, the buffer need not be zero byte terminated. The input is
+/// first validated as UTF-8, unless the context has the
+/// \ref EASYJSONPARSER_OPTION_TRUSTED_INPUT option. The native backend
+/// validates as it goes instead if it may stop before the end (see
+/// \ref EASYJSONPARSER_OPTION_STOP_WHEN_COMPLETE).
 
-  if (jobj == NULL) {
-    enum json_tokener_error libjsonc_err = json_tokener_get_error(parser);
-    return error_handler(EASYJSONPARSER_ERROR_LIBJSONC_PARSE, &libjsonc_err,
-                         "json_tokener_parse_ex() returned error",
-                         "could not parse JSON (json_tokener_parse_ex() returned error)");
+int easyjsonparser_ctx_parse_buffer (easyjsonparser_ctx * ctx, const char * buf, size_t len, easyjsonparser_schema * js, void * cfg)
+{
+  if (ctx->own_arena != NULL)
+    easyjsonparser_arena_reset(ctx->own_arena);
+  if (ctx->own_intern != NULL)
+    easyjsonparser_intern_reset(ctx->own_intern);
+
+  int validate = !(ctx->options & EASYJSONPARSER_OPTION_TRUSTED_INPUT)
+    && !(ctx->backend == EASYJSONPARSER_BACKEND_NATIVE && (ctx->options & EASYJSONPARSER_OPTION_STOP_WHEN_COMPLETE));
+
+  size_t offset;
+  if (validate && !ejp_utf8_validate(ctx, buf, len, &offset))
+    return ejp_utf8_error(ctx, offset);
+
+  if (ctx->backend == EASYJSONPARSER_BACKEND_NATIVE)
+    return ejp_native_parse(ctx, buf, len, js, cfg);
+
+  if (ctx->tokener == NULL) {
+    if ((ctx->tokener = tokener_new(ctx)) == NULL)
+      return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                               "out of memory",
+                               "could not allocate json-c tokener");
+  } else {
+    json_tokener_reset(ctx->tokener);
   }
 
-  int retval = parse(jobj, js, cfg);
+  const char * start = buf;
+
+  // The tokener takes an int length, so very large inputs are fed to it in
+  // pieces.
+  struct json_object * jobj = NULL;
+  enum json_tokener_error libjsonc_err = json_tokener_continue;
+  size_t chunk_offset = 0;
+  while (len > 0 && libjsonc_err == json_tokener_continue) {
+    int chunk_len = len > INT_MAX ? INT_MAX : (int) len;
+    jobj = json_tokener_parse_ex(ctx->tokener, buf, chunk_len);
+    libjsonc_err = json_tokener_get_error(ctx->tokener);
+    if (libjsonc_err == json_tokener_continue)
+      chunk_offset += chunk_len;
+    buf += chunk_len;
+    len -= chunk_len;
+  }
 
-  json_tokener_free(parser);
+  if (jobj == NULL && libjsonc_err == json_tokener_error_depth) {
+    offset = chunk_offset + json_tokener_get_parse_end(ctx->tokener);
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_PARSE_DEPTH, &offset,
+                             "nesting too deep",
+                             "could not parse JSON (nested more than %zu deep at offset %zu)",
+                             ctx->max_depth, offset);
+  }
+  if (jobj == NULL)
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_LIBJSONC_PARSE, &libjsonc_err,
+                             "json_tokener_parse_ex() returned error",
+                             "could not parse JSON (json_tokener_parse_ex() returned error)");
+
+  // json-c lets through some of what the native backend rejects (trailing
+  // commas, leading zeros, raw control characters in strings and so on),
+  // which is checked for once json-c has accepted the value.
+  int retval = ejp_native_check(ctx, start, chunk_offset + json_tokener_get_parse_end(ctx->tokener));
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = parse(ctx, jobj, js, cfg);
+
+  json_object_put(jobj);
 
   return retval;
 }
 
 
-/// Parse the JSON. Called from \ref easyjsonparser_parse_file or
-/// \ref easyjsonparser_parse_string to complete the parsing of the source.
+/// Create a json-c tokener which fails at the nesting depth limit of
+/// \p ctx, as the native backend does (json-c counts the root as a level).
+
+struct json_tokener * tokener_new (easyjsonparser_ctx * ctx)
+{
+  return json_tokener_new_ex(ctx->max_depth < INT_MAX ? (int) ctx->max_depth + 1 : INT_MAX);
+}
+
+
+/// Create a push parser, to which the document may be fed in arbitrarily
+/// sized chunks as they become available, by \ref easyjsonparser_parser_feed.
+/// The json-c tokener is used for this whatever the backend selected, as it
+/// can be suspended and resumed between any two bytes of the input. The
+/// tokener builds the whole document as json-c objects, and the schema is
+/// applied to them once it is complete, so this saves the caller buffering
+/// the input, not the memory for the document.
+
+easyjsonparser_parser * easyjsonparser_parser_new (easyjsonparser_schema * js, void * cfg)
+{
+  return easyjsonparser_ctx_parser_new(NULL, js, cfg);
+}
+
+
+/// Create a push parser as \ref easyjsonparser_parser_new, but with the
+/// logger, log level, error handler, options, nesting depth limit, arena
+/// and intern table of \p ctx (as they are now) instead of the process
+/// wide ones. The context itself is not used by the parser, and may be
+/// used for other parses or freed while the parser is in use.
 
-int parse (json_object * jobj, easyjsonparser_schema * js, void * cfg)
+easyjsonparser_parser * easyjsonparser_ctx_parser_new (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, void * cfg)
 {
-  easyjsonparser_log(EASYJSONPARSER_LOG_LEVEL_TRACE, "JSON root processing");
+  easyjsonparser_parser * parser = (easyjsonparser_parser *) malloc(sizeof(easyjsonparser_parser));
+  if (parser == NULL)
+    return NULL;
+
+  ejp_ctx_init(&parser->ctx);
+  if (ctx != NULL) {
+    parser->ctx.loglevel        = ctx->loglevel;
+    parser->ctx.logger          = ctx->logger;
+    parser->ctx.errhandler      = ctx->errhandler;
+    parser->ctx.errhandler_lazy = ctx->errhandler_lazy;
+    parser->ctx.options         = ctx->options;
+    parser->ctx.max_depth       = ctx->max_depth;
+    parser->ctx.arena           = ctx->arena;
+    parser->ctx.intern          = ctx->intern;
+    parser->ctx.isa             = ctx->isa;
+  }
+  if ((parser->ctx.tokener = tokener_new(&parser->ctx)) == NULL) {
+    free(parser);
+    return NULL;
+  }
+
+  parser->js            = js;
+  parser->cfg           = cfg;
+  parser->complete      = 0;
+  parser->retval        = EASYJSONPARSER_SUCCESS;
+  parser->offset        = 0;
+  parser->utf8.tail_len = 0;
+  parser->utf8.offset   = 0;
+
+  return parser;
+}
+
+
+/// Feed the next \p len bytes of the document to the push parser. The
+/// schema is applied (and so the callbacks called) when the chunk which
+/// completes the document is fed. Each chunk is validated as UTF-8 first
+/// (unless the parser has the \ref EASYJSONPARSER_OPTION_TRUSTED_INPUT
+/// option), a sequence split between chunks being checked when the second
+/// arrives. Once an error is returned, the same error is returned for any
+/// further input.
+
+int easyjsonparser_parser_feed (easyjsonparser_parser * parser, const char * buf, size_t len)
+{
+  easyjsonparser_ctx * ctx = &parser->ctx;
+
+  size_t utf8_offset;
+  if (parser->retval == EASYJSONPARSER_SUCCESS && !(ctx->options & EASYJSONPARSER_OPTION_TRUSTED_INPUT)
+      && !ejp_utf8_validate_stream(ctx, &parser->utf8, buf, len, &utf8_offset))
+    parser->retval = ejp_utf8_error(ctx, utf8_offset);
+
+  while (len > 0 && parser->retval == EASYJSONPARSER_SUCCESS) {
+    if (parser->complete) {
+      for (size_t i = 0; i < len; i++)
+        if (buf[i] != ' ' && buf[i] != '\t' && buf[i] != '\n' && buf[i] != '\r') {
+          size_t offset = parser->offset + i;
+          parser->retval = ejp_error_handler(ctx, EASYJSONPARSER_ERROR_PARSE_UNEXPECTED, &offset,
+                                             "unexpected input",
+                                             "could not parse JSON (expected end of input at offset %zu)",
+                                             offset);
+          break;
+        }
+      parser->offset += len;
+      break;
+    }
+
+    // The tokener takes an int length, so very large chunks are split.
+    int chunk_len = len > INT_MAX ? INT_MAX : (int) len;
+    struct json_object * jobj = json_tokener_parse_ex(ctx->tokener, buf, chunk_len);
+    enum json_tokener_error libjsonc_err = json_tokener_get_error(ctx->tokener);
+
+    if (jobj != NULL) {
+      size_t used = json_tokener_get_parse_end(ctx->tokener);
+      parser->complete = 1;
+      parser->retval   = parse(ctx, jobj, parser->js, parser->cfg);
+      json_object_put(jobj);
+      parser->offset += used;
+      buf            += used;
+      len            -= used;
+    } else if (libjsonc_err == json_tokener_continue) {
+      parser->offset += chunk_len;
+      buf            += chunk_len;
+      len            -= chunk_len;
+    } else if (libjsonc_err == json_tokener_error_depth) {
+      size_t offset = parser->offset + json_tokener_get_parse_end(ctx->tokener);
+      parser->retval = ejp_error_handler(ctx, EASYJSONPARSER_ERROR_PARSE_DEPTH, &offset,
+                                         "nesting too deep",
+                                         "could not parse JSON (nested more than %zu deep at offset %zu)",
+                                         ctx->max_depth, offset);
+    } else {
+      parser->retval = ejp_error_handler(ctx, EASYJSONPARSER_ERROR_LIBJSONC_PARSE, &libjsonc_err,
+                                         "json_tokener_parse_ex() returned error",
+                                         "could not parse JSON (json_tokener_parse_ex() returned error)");
+    }
+  }
+
+  return parser->retval;
+}
+
+
+/// Signal the end of the document to the push parser, returning the final
+/// result of the parse.
+
+int easyjsonparser_parser_finish (easyjsonparser_parser * parser)
+{
+  easyjsonparser_ctx * ctx = &parser->ctx;
+
+  // A sequence still waiting for the rest of its bytes never gets them.
+  if (parser->retval == EASYJSONPARSER_SUCCESS && parser->utf8.tail_len > 0)
+    parser->retval = ejp_utf8_error(ctx, parser->utf8.offset);
+
+  if (parser->retval == EASYJSONPARSER_SUCCESS && !parser->complete) {
+    enum json_tokener_error libjsonc_err = json_tokener_error_parse_eof;
+    parser->retval = ejp_error_handler(ctx, EASYJSONPARSER_ERROR_LIBJSONC_PARSE, &libjsonc_err,
+                                       "document incomplete",
+                                       "could not parse JSON (input ended after %zu bytes, document incomplete)",
+                                       parser->offset);
+  }
+
+  return parser->retval;
+}
+
+
+/// Free the push parser.
+
+void easyjsonparser_parser_free (easyjsonparser_parser * parser)
+{
+  if (parser == NULL)
+    return;
+
+  ejp_ctx_release(&parser->ctx);
+  free(parser);
+}
+
+
+/// Parse the JSON. Called from \ref easyjsonparser_parse_buffer or the push
+/// parser to complete the parsing of the source.
+
+int parse (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, void * cfg)
+{
+  EJP_TRACE(ctx, "JSON root processing");
+
+  ctx->compiled = (js->type & EASYJSONPARSER_SCHEMA_CMP) != 0;
+  ctx->lenient  = (js->type & EASYJSONPARSER_SCHEMA_IGN) != 0;
 
   easyjsonparser_stack stack;
   stack.key  = NULL;
   stack.prev = NULL;
+  stack.ctx  = ctx;
 
   if ((js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_MAP)
-    return rec_parse_obj(jobj, js + 1, &stack, cfg);
+    return rec_parse_obj(ctx, jobj, js + 1, &stack, cfg, ctx->lenient);
   else if ((js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_LST)
-    return rec_parse_list(jobj, js + 1, &stack, cfg);
+    return rec_parse_list(ctx, jobj, js + 1, &stack, cfg);
   else
-    return rec_parse(jobj, js, &stack, cfg);
+    return rec_parse(ctx, jobj, js, &stack, cfg);
 }
 
 
-/// Recursive parse of a JSON map/object.
+/// Recursive parse of a JSON map/object, ignoring keys the schema has no
+/// entry for if \p lenient is set.
 
-int rec_parse_obj (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+int rec_parse_obj (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg, int lenient)
 {
-  easyjsonparser_log(EASYJSONPARSER_LOG_LEVEL_TRACE, "JSON object processing");
+  EJP_TRACE(ctx, "JSON object processing");
 
   return js[0].type != EASYJSONPARSER_SCHEMA_END && js[1].type == EASYJSONPARSER_SCHEMA_END && js[0].key == NULL
-    ? rec_parse_obj_varkeys (jobj, js, stack, cfg)
-    : rec_parse_obj_fixedkeys (jobj, js, stack, cfg);
+    ? rec_parse_obj_varkeys (ctx, jobj, js, stack, cfg)
+    : rec_parse_obj_fixedkeys (ctx, jobj, js, stack, cfg, lenient);
 }
 
 
 /// Recursive parse JSON map variable keys.
 
-int rec_parse_obj_varkeys (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+int rec_parse_obj_varkeys (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
 {
-  easyjsonparser_log(EASYJSONPARSER_LOG_LEVEL_TRACE, "JSON variable key object processing");
+  EJP_TRACE(ctx, "JSON variable key object processing");
 
   int retval = EASYJSONPARSER_SUCCESS;
 
@@ -145,8 +733,9 @@ int rec_parse_obj_varkeys (json_object * jobj, easyjsonparser_schema * js, easyj
     easyjsonparser_stack stack2;
     stack2.key  = (char *) key;
     stack2.prev = stack;
+    stack2.ctx  = ctx;
 
-    if ((retval = rec_parse(jobj2, js, &stack2, cfg)) != EASYJSONPARSER_SUCCESS)
+    if ((retval = rec_parse(ctx, jobj2, js, &stack2, cfg)) != EASYJSONPARSER_SUCCESS)
       break;
   }
 
@@ -156,31 +745,26 @@ int rec_parse_obj_varkeys (json_object * jobj, easyjsonparser_schema * js, easyj
 
 /// Recursive parse JSON map fixed keys.
 
-int rec_parse_obj_fixedkeys (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+int rec_parse_obj_fixedkeys (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg, int lenient)
 {
-  easyjsonparser_log(EASYJSONPARSER_LOG_LEVEL_TRACE, "JSON fixed key object processing");
+  EJP_TRACE(ctx, "JSON fixed key object processing");
 
   int retval = EASYJSONPARSER_SUCCESS;
 
   json_object_object_foreach(jobj, key, jobj2) {
-    easyjsonparser_schema * js2 = js;
-    while (js2->type != EASYJSONPARSER_SCHEMA_END) {
-      if (strcmp(js2->key, (char *) key) == 0) {
-        easyjsonparser_stack stack2;
-        stack2.key  = key;
-        stack2.prev = stack;
-
-        retval = rec_parse(jobj2, js2, &stack2, cfg);
-        break;
-      }
-
-      js2++;
-    }
+    easyjsonparser_schema * js2 = ejp_schema_find(ctx, js, key, strlen(key));
 
-    if (js2->type == EASYJSONPARSER_SCHEMA_END) {
-      char * stack_path = easyjsonparser_stack_path(stack);
+    if (js2 != NULL) {
+      easyjsonparser_stack stack2;
+      stack2.key  = key;
+      stack2.prev = stack;
+      stack2.ctx  = ctx;
+
+      retval = rec_parse(ctx, jobj2, js2, &stack2, cfg);
+    } else if (!lenient) {
+      char * stack_path = ejp_error_path(ctx, stack);
       void * data[3] = {js, stack_path, key};
-      retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY, data,
+      retval = ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY, data,
                                  "unexpected key",
                                  "key %s unexpected while parsing map at %s",
                                  key, stack_path);
@@ -194,15 +778,35 @@ int rec_parse_obj_fixedkeys (json_object * jobj, easyjsonparser_schema * js, eas
 }
 
 
-/// Recursive parse of a JSON list.
+/// Recursive parse of a JSON list. The schema entries are alternatives, each
+/// element being parsed by the first for its type (and for an object, a
+/// map entry with a key only if the object has that key), and failing the
+/// first entry if none of them take it.
 
-int rec_parse_list (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+int rec_parse_list (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
 {
-  easyjsonparser_log(EASYJSONPARSER_LOG_LEVEL_TRACE, "JSON list/array processing");
+  EJP_TRACE(ctx, "JSON list/array processing");
 
   for (int i = 0; i < json_object_array_length(jobj); i++) {
-    for (easyjsonparser_schema * js2 = js; js2->type != EASYJSONPARSER_SCHEMA_END; js2++) {
-      int rec_result = rec_parse(json_object_array_get_idx(jobj, i), js2, stack, cfg);
+    json_object *           elem      = json_object_array_get_idx(jobj, i);
+    enum json_type          elem_type = json_object_get_type(elem);
+    int                     type      = jobj_type_to_schema(elem_type);
+    easyjsonparser_schema * js2       = js;
+
+    for (; js2->type != EASYJSONPARSER_SCHEMA_END; js2++) {
+      if (!ejp_schema_accepts(js2, type))
+        continue;
+      if (type == EASYJSONPARSER_SCHEMA_MAP && js2->key != NULL && !json_object_object_get_ex(elem, js2->key, NULL))
+        continue;
+      break;
+    }
+
+    if (js2->type != EASYJSONPARSER_SCHEMA_END) {
+      int rec_result = rec_parse(ctx, elem, js2, stack, cfg);
+      if (rec_result != EASYJSONPARSER_SUCCESS)
+        return rec_result;
+    } else if (js->type != EASYJSONPARSER_SCHEMA_END) {
+      int rec_result = ejp_mandate_error(ctx, js, stack, jobj_type_to_str(elem_type));
       if (rec_result != EASYJSONPARSER_SUCCESS)
         return rec_result;
     }
@@ -212,137 +816,329 @@ int rec_parse_list (json_object * jobj, easyjsonparser_schema * js, easyjsonpars
 }
 
 
-/// Recursive parse of a JSON something (could be anything in this context).
+/// Parse a JSON list of numbers for the typed array schema entry \p js (see
+/// \ref EASYJSONPARSER_INT_ARRAY), handing them to the handler
+/// \ref EJP_ARRAY_BATCH at a time, then once more with none and the length
+/// of the list. A double array takes integers too.
 
-int rec_parse (json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+int rec_parse_array (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
 {
-  enum json_type jobj_type = json_object_get_type(jobj);
-  char * stack_path = easyjsonparser_stack_path(stack);
-  char * jobj_type_str = jobj_type_to_str(jobj_type);
-  void * data[3] = {js, stack_path, jobj_type_str};
+  EJP_TRACE(ctx, "JSON typed array processing");
 
-  easyjsonparser_log(EASYJSONPARSER_LOG_LEVEL_TRACE, "JSON scalar processing, found %s", jobj_type_str);
+  int dbl = (js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_DBL;
+  ejp_array_batch batch;
+  size_t n = 0, offset = 0;
 
-  if (js->type == EASYJSONPARSER_SCHEMA_STR) {
-    if (jobj_type == json_type_string) {
-      if (js->data != NULL)
-        ((void (*)(easyjsonparser_stack *, char *, void *)) js->data)(stack, (char *) json_object_get_string(jobj), cfg);
-    } else {
-      int retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING, data,
-                                 "string mandated by schema",
-                                 "%s (%s) must be a string at %s",
-                                 js->key, js->descr, stack_path);
-      if (retval != EASYJSONPARSER_SUCCESS)
-        return retval;
-    }
-  } else if (js->type == EASYJSONPARSER_SCHEMA_INT) {
-    if (jobj_type == json_type_int) {
-      if (js->data != NULL)
-        ((void (*)(easyjsonparser_stack *, int, void *)) js->data)(stack, json_object_get_int(jobj), cfg);
-    } else {
-      int retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT, data,
-                                 "integer mandated by schema",
-                                 "%s (%s) must be an integer at %s",
-                                 js->key, js->descr, stack_path);
-      if (retval != EASYJSONPARSER_SUCCESS)
-        return retval;
-    }
-  } else if (js->type == EASYJSONPARSER_SCHEMA_DBL) {
-    if (jobj_type == json_type_double) {
-      if (js->data != NULL)
-        ((void (*)(easyjsonparser_stack *, double, void *)) js->data)(stack, json_object_get_double(jobj), cfg);
-    } else {
-      int retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_MANDATES_DOUBLE, data,
-                                 "double mandated by schema",
-                                 "%s (%s) must be a double/float at %s",
-                                 js->key, js->descr, stack_path);
-      if (retval != EASYJSONPARSER_SUCCESS)
-        return retval;
-    }
-  } else if (js->type == EASYJSONPARSER_SCHEMA_BOO) {
-    if (jobj_type == json_type_boolean) {
-      if (js->data != NULL)
-        ((void (*)(easyjsonparser_stack *, int, void *)) js->data)(stack, json_object_get_boolean(jobj), cfg);
-    } else {
-      int retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_MANDATES_BOOL, data,
-                                 "boolean mandated by schema",
-                                 "%s (%s) must be a boolean at %s",
-                                 js->key, js->descr, stack_path);
-      if (retval != EASYJSONPARSER_SUCCESS)
-        return retval;
-    }
-  } else if (js->type == EASYJSONPARSER_SCHEMA_MAP) {
-    if (jobj_type == json_type_object) {
-      return rec_parse_obj(jobj, js->data, stack, cfg);
-    } else {
-      int retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP, data,
-                                 "map/object mandated by schema",
-                                 "%s (%s) must be a map/object at %s",
-                                 js->key, js->descr, stack_path);
-      if (retval != EASYJSONPARSER_SUCCESS)
-        return retval;
-    }
-  } else if (js->type == EASYJSONPARSER_SCHEMA_LST) {
-    if (jobj_type == json_type_array) {
-      return rec_parse_list(jobj, js->data, stack, cfg);
+  int len = json_object_array_length(jobj);
+  for (int i = 0; i < len; i++) {
+    json_object *  elem      = json_object_array_get_idx(jobj, i);
+    enum json_type elem_type = json_object_get_type(elem);
+
+    if (elem_type == json_type_int && !dbl) {
+      batch.i[n++] = json_object_get_int64(elem);
+    } else if ((elem_type == json_type_int || elem_type == json_type_double) && dbl) {
+      batch.d[n++] = json_object_get_double(elem);
     } else {
-      int retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST, data,
-                                 "list/array mandated by schema",
-                                 "%s (%s) must be a list/array at %s",
-                                 js->key, js->descr, stack_path);
+      easyjsonparser_schema elem_js = *js;
+      elem_js.type &= ~EASYJSONPARSER_SCHEMA_ARR;
+      int retval = ejp_mandate_error(ctx, &elem_js, stack, jobj_type_to_str(elem_type));
       if (retval != EASYJSONPARSER_SUCCESS)
         return retval;
     }
-  } else if (js->type == EASYJSONPARSER_SCHEMA_NUL) {
-    if (jobj_type == json_type_null) {
-      if (js->data != NULL)
-        ((void (*)(easyjsonparser_stack *, void *)) js->data)(stack, cfg);
-    } else {
-      int retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_MANDATES_NULL, data,
-                                 "null mandated by schema",
-                                 "%s (%s) must be a null at %s",
-                                 js->key, js->descr, stack_path);
-      if (retval != EASYJSONPARSER_SUCCESS)
-        return retval;
+
+    if (n == EJP_ARRAY_BATCH) {
+      ejp_array_flush(js, stack, &batch, n, offset, cfg);
+      offset += n;
+      n = 0;
     }
+  }
+
+  if (n > 0)
+    ejp_array_flush(js, stack, &batch, n, offset, cfg);
+  ejp_array_flush(js, stack, &batch, 0, offset + n, cfg);
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Hand the first \p n values in \p batch, the first of which is element
+/// \p offset of the list, to the handler of the typed array schema entry
+/// \p js (none, with \p offset the length of the list, at the end).
+
+void ejp_array_flush (easyjsonparser_schema * js, easyjsonparser_stack * stack, ejp_array_batch * batch, size_t n, size_t offset, void * cfg)
+{
+  if (js->data == NULL)
+    return;
+
+  if ((js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_DBL)
+    ((void (*)(easyjsonparser_stack *, const double *, size_t, size_t, void *)) js->data)(stack, batch->d, n, offset, cfg);
+  else
+    ((void (*)(easyjsonparser_stack *, const int64_t *, size_t, size_t, void *)) js->data)(stack, batch->i, n, offset, cfg);
+}
+
+
+/// Recursive parse of a JSON something (could be anything in this context).
+
+int rec_parse (easyjsonparser_ctx * ctx, json_object * jobj, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+{
+  enum json_type jobj_type = json_object_get_type(jobj);
+
+  EJP_TRACE(ctx, "JSON scalar processing, found %s", jobj_type_to_str(jobj_type));
+
+  if (js->type == EASYJSONPARSER_SCHEMA_STR && jobj_type == json_type_string) {
+    if (js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, char *, void *)) js->data)(stack, (char *) json_object_get_string(jobj), cfg);
+  } else if (js->type == EASYJSONPARSER_SCHEMA_INT && jobj_type == json_type_int) {
+    if (js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, int, void *)) js->data)(stack, json_object_get_int(jobj), cfg);
+  } else if (js->type == EASYJSONPARSER_SCHEMA_I64 && jobj_type == json_type_int) {
+    if (js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, int64_t, void *)) js->data)(stack, json_object_get_int64(jobj), cfg);
+  } else if (js->type == EASYJSONPARSER_SCHEMA_DBL && jobj_type == json_type_double) {
+    if (js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, double, void *)) js->data)(stack, json_object_get_double(jobj), cfg);
+  } else if (js->type == EASYJSONPARSER_SCHEMA_BOO && jobj_type == json_type_boolean) {
+    if (js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, int, void *)) js->data)(stack, json_object_get_boolean(jobj), cfg);
+  } else if (js->type == (EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_VEW) && jobj_type == json_type_string) {
+    if (js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, const char *, size_t, int, void *)) js->data)(stack, json_object_get_string(jobj), json_object_get_string_len(jobj), 0, cfg);
+  } else if (js->type == (EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_ITN) && jobj_type == json_type_string) {
+    return ejp_intern_str(ctx, js, stack, cfg, json_object_get_string(jobj), json_object_get_string_len(jobj));
+  } else if (js->type == (EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_FLD) && jobj_type == json_type_string) {
+    return ejp_store_str_field(ctx, js, stack, cfg, json_object_get_string(jobj), json_object_get_string_len(jobj));
+  } else if (js->type == (EASYJSONPARSER_SCHEMA_INT | EASYJSONPARSER_SCHEMA_FLD) && jobj_type == json_type_int) {
+    *EJP_FIELD(cfg, js, int) = json_object_get_int(jobj);
+  } else if (js->type == (EASYJSONPARSER_SCHEMA_I64 | EASYJSONPARSER_SCHEMA_FLD) && jobj_type == json_type_int) {
+    *EJP_FIELD(cfg, js, int64_t) = json_object_get_int64(jobj);
+  } else if (js->type == (EASYJSONPARSER_SCHEMA_DBL | EASYJSONPARSER_SCHEMA_FLD) && jobj_type == json_type_double) {
+    *EJP_FIELD(cfg, js, double) = json_object_get_double(jobj);
+  } else if (js->type == (EASYJSONPARSER_SCHEMA_BOO | EASYJSONPARSER_SCHEMA_FLD) && jobj_type == json_type_boolean) {
+    *EJP_FIELD(cfg, js, int) = json_object_get_boolean(jobj);
+  } else if ((js->type & ~EASYJSONPARSER_SCHEMA_IGN) == EASYJSONPARSER_SCHEMA_MAP && jobj_type == json_type_object) {
+    return rec_parse_obj(ctx, jobj, js->data, stack, cfg, ctx->lenient || (js->type & EASYJSONPARSER_SCHEMA_IGN));
+  } else if (js->type == EASYJSONPARSER_SCHEMA_LST && jobj_type == json_type_array) {
+    return rec_parse_list(ctx, jobj, js->data, stack, cfg);
+  } else if ((js->type & EASYJSONPARSER_SCHEMA_ARR) && jobj_type == json_type_array) {
+    return rec_parse_array(ctx, jobj, js, stack, cfg);
+  } else if (js->type == EASYJSONPARSER_SCHEMA_NUL && jobj_type == json_type_null) {
+    if (js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, void *)) js->data)(stack, cfg);
   } else {
-    int retval = error_handler(EASYJSONPARSER_ERROR_SCHEMA_INVALID, data,
-                               "schema invalid",
-                               "schema has invalid/corrupt type %d at %s",
-                               js->type, stack_path);
-    if (retval != EASYJSONPARSER_SUCCESS)
-      return retval;
+    return ejp_mandate_error(ctx, js, stack, jobj_type_to_str(jobj_type));
   }
 
   return EASYJSONPARSER_SUCCESS;
 }
 
 
-/// Return a string representing the given libjsonparser token.
+/// Report that the schema entry \p js mandates something other than the
+/// \p found_type_str value found at \p stack (or that the entry is itself
+/// invalid). Shared by all backends so the errors are identical.
+
+int ejp_mandate_error (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, easyjsonparser_stack * stack, char * found_type_str)
+{
+  char * stack_path = ejp_error_path(ctx, stack);
+  void * data[3] = {js, stack_path, found_type_str};
+
+  switch (js->type & ~(EASYJSONPARSER_SCHEMA_FLD | EASYJSONPARSER_SCHEMA_VEW | EASYJSONPARSER_SCHEMA_ITN | EASYJSONPARSER_SCHEMA_IGN)) {
+  case EASYJSONPARSER_SCHEMA_STR:
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING, data,
+                             "string mandated by schema",
+                             "%s (%s) must be a string at %s",
+                             js->key, js->descr, stack_path);
+
+  case EASYJSONPARSER_SCHEMA_INT:
+  case EASYJSONPARSER_SCHEMA_I64:
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT, data,
+                             "integer mandated by schema",
+                             "%s (%s) must be an integer at %s",
+                             js->key, js->descr, stack_path);
+
+  case EASYJSONPARSER_SCHEMA_DBL:
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_DOUBLE, data,
+                             "double mandated by schema",
+                             "%s (%s) must be a double/float at %s",
+                             js->key, js->descr, stack_path);
+
+  case EASYJSONPARSER_SCHEMA_BOO:
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_BOOL, data,
+                             "boolean mandated by schema",
+                             "%s (%s) must be a boolean at %s",
+                             js->key, js->descr, stack_path);
+
+  case EASYJSONPARSER_SCHEMA_MAP:
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP, data,
+                             "map/object mandated by schema",
+                             "%s (%s) must be a map/object at %s",
+                             js->key, js->descr, stack_path);
+
+  case EASYJSONPARSER_SCHEMA_LST:
+  case EASYJSONPARSER_SCHEMA_I64 | EASYJSONPARSER_SCHEMA_ARR:
+  case EASYJSONPARSER_SCHEMA_DBL | EASYJSONPARSER_SCHEMA_ARR:
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST, data,
+                             "list/array mandated by schema",
+                             "%s (%s) must be a list/array at %s",
+                             js->key, js->descr, stack_path);
+
+  case EASYJSONPARSER_SCHEMA_NUL:
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_NULL, data,
+                             "null mandated by schema",
+                             "%s (%s) must be a null at %s",
+                             js->key, js->descr, stack_path);
+
+  default:
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_INVALID, data,
+                             "schema invalid",
+                             "schema has invalid/corrupt type %d at %s",
+                             js->type, stack_path);
+  }
+}
+
+
+/// Store a copy of the string \p val (\p val_len bytes long) in the char
+/// pointer struct field bound by the field schema entry \p js, freeing
+/// the string it held before, or if the context has an arena, copying it
+/// into that and leaving the string it held before alone.
+
+int ejp_store_str_field (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg, const char * val, size_t val_len)
+{
+  char * copy = ctx->arena != NULL
+    ? easyjsonparser_arena_strndup(ctx->arena, val, val_len)
+    : (char *) malloc(val_len + 1);
+  if (copy == NULL) {
+    char * stack_path = ejp_error_path(ctx, stack);
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, stack_path,
+                             "out of memory",
+                             "could not allocate %zu bytes for %s at %s",
+                             val_len + 1, js->key, stack_path);
+  }
+
+  char ** field = EJP_FIELD(cfg, js, char *);
+
+  if (ctx->arena == NULL) {
+    memcpy(copy, val, val_len);
+    copy[val_len] = '\0';
+    free(*field);
+  }
+
+  *field = copy;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Intern the string \p val (\p val_len bytes long) in the intern table of
+/// the context (creating one private to the parse if it has none) and
+/// call the handler of the intern schema entry \p js with the canonical
+/// copy and its id.
+
+int ejp_intern_str (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg, const char * val, size_t val_len)
+{
+  easyjsonparser_intern * intern = ctx->intern;
+  if (intern == NULL && (intern = ctx->own_intern) == NULL)
+    intern = ctx->own_intern = easyjsonparser_intern_new();
+
+  uint32_t id;
+  const char * str = intern != NULL ? easyjsonparser_intern_add(intern, val, val_len, &id) : NULL;
+  if (str == NULL) {
+    char * stack_path = ejp_error_path(ctx, stack);
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, stack_path,
+                             "out of memory",
+                             "could not intern %zu bytes for %s at %s",
+                             val_len + 1, js->key, stack_path);
+  }
+
+  if (js->data != NULL)
+    ((void (*)(easyjsonparser_stack *, const char *, uint32_t, void *)) js->data)(stack, str, id, cfg);
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Return a string representing the given stack, in a buffer private to
+/// the calling thread (where the compiler supports thread local storage)
+/// which is overwritten by the next call.
 
 char * easyjsonparser_stack_path (easyjsonparser_stack * stack)
 {
-  static char buf[MAX_STACKPATH_LEN];
+  static THREAD_LOCAL char buf[MAX_STACKPATH_LEN];
+
+  return easyjsonparser_stack_path_r(stack, buf, MAX_STACKPATH_LEN);
+}
+
+
+/// Return the arena a callback may copy what it keeps into, that set for
+/// the context with \ref easyjsonparser_ctx_set_arena, or failing that one
+/// private to the parse (created when first asked for, and reset when the
+/// next parse begins), or NULL if out of memory.
+
+easyjsonparser_arena * easyjsonparser_stack_arena (easyjsonparser_stack * stack)
+{
+  easyjsonparser_ctx * ctx = stack->ctx;
+
+  if (ctx->arena != NULL)
+    return ctx->arena;
+  if (ctx->own_arena == NULL)
+    ctx->own_arena = easyjsonparser_arena_new();
+
+  return ctx->own_arena;
+}
+
+
+/// Render a string representing the given stack into \p buf, which is
+/// \p buf_len bytes long, and return it.
+
+char * easyjsonparser_stack_path_r (easyjsonparser_stack * stack, char * buf, size_t buf_len)
+{
+  if (buf_len == 0)
+    return buf;
 
   if (stack->key == NULL)
-    snprintf(buf, MAX_STACKPATH_LEN, "/");
+    snprintf(buf, buf_len, "/");
   else
-    stack_render_rec(stack, buf, buf + MAX_STACKPATH_LEN);
+    stack_render_rec(stack, buf, buf + buf_len);
 
   return buf;
 }
 
 
-/// Recursively render the stack, called by \ref easyjsonparser_stack_path.
+/// Render a string representing the given stack into the context, for
+/// error messages.
+
+char * ejp_stack_path (easyjsonparser_ctx * ctx, easyjsonparser_stack * stack)
+{
+  return easyjsonparser_stack_path_r(stack, ctx->stack_path, MAX_STACKPATH_LEN);
+}
+
+
+/// Return the stack path to report an error at the given stack with: NULL
+/// if errors are silent, or for a lazy error handler the context's path
+/// buffer, left empty until the message is asked for.
+
+char * ejp_error_path (easyjsonparser_ctx * ctx, easyjsonparser_stack * stack)
+{
+  if (ctx->errhandler_lazy != NULL) {
+    ctx->error_stack = stack;
+    ctx->stack_path[0] = '\0';
+    return ctx->stack_path;
+  }
+
+  return EJP_ERRORS_SILENT(ctx) ? NULL : ejp_stack_path(ctx, stack);
+}
+
+
+/// Recursively render the stack, called by \ref easyjsonparser_stack_path_r.
 
 char * stack_render_rec (easyjsonparser_stack * stack, char * buf, char * buf_of)
 {
   if (stack->key == NULL)
     return buf;
 
-  snprintf(stack_render_rec(stack->prev, buf, buf_of), buf_of - buf, "/%s", stack->key);
+  char * p = stack_render_rec(stack->prev, buf, buf_of);
+  snprintf(p, buf_of - p, "/%s", stack->key);
 
-  return buf + strlen(buf);
+  return p + strlen(p);
 }
 
 
@@ -386,15 +1182,57 @@ char * jobj_type_to_str (enum json_type jobj_type)
 }
 
 
-/// Log something (the library logs at the 'error' and 'trace' levels).
+/// Return the schema entry type for the JSON type \p jobj_type, as
+/// \ref ejp_schema_accepts takes it.
+
+int jobj_type_to_schema (enum json_type jobj_type)
+{
+  switch (jobj_type) {
+  case json_type_object:  return EASYJSONPARSER_SCHEMA_MAP;
+  case json_type_array:   return EASYJSONPARSER_SCHEMA_LST;
+  case json_type_null:    return EASYJSONPARSER_SCHEMA_NUL;
+  case json_type_boolean: return EASYJSONPARSER_SCHEMA_BOO;
+  case json_type_double:  return EASYJSONPARSER_SCHEMA_DBL;
+  case json_type_int:     return EASYJSONPARSER_SCHEMA_INT;
+  case json_type_string:  return EASYJSONPARSER_SCHEMA_STR;
+  default:                return EASYJSONPARSER_SCHEMA_END;
+  }
+}
+
+
+/// Log something (the library logs at the 'error' and 'trace' levels),
+/// with the process wide logger.
 
 void easyjsonparser_log (int level, const char * fmt, ...)
+{
+  easyjsonparser_ctx ctx;
+  ejp_ctx_init(&ctx);
+
+  va_list args;
+  va_start(args, fmt);
+  ejp_vlog(&ctx, level, fmt, args);
+  va_end(args);
+}
+
+
+/// Log something with the logger of the given context.
+
+void ejp_log (easyjsonparser_ctx * ctx, int level, const char * fmt, ...)
 {
   va_list args;
   va_start(args, fmt);
+  ejp_vlog(ctx, level, fmt, args);
+  va_end(args);
+}
+
 
-  if (alt_logger == NULL) {
-    if (level > logger_loglevel)
+/// Log something with the logger of the given context, \ref ejp_log with
+/// a va_list.
+
+void ejp_vlog (easyjsonparser_ctx * ctx, int level, const char * fmt, va_list args)
+{
+  if (ctx->logger == NULL) {
+    if (level > ctx->loglevel)
       return;
 
     fprintf(stderr, "libeasyjsonparser: ");
@@ -407,27 +1245,68 @@ void easyjsonparser_log (int level, const char * fmt, ...)
   char msg[MAX_LOGMSG_LEN];
   vsnprintf(msg, MAX_LOGMSG_LEN, fmt, args);
 
-  alt_logger(level, msg);
+  ctx->logger(level, msg);
 }
 
 
-/// Handle an error.
+/// Handle an error, with the error handler of the given context. The
+/// message is only formatted if an error handler is installed or the
+/// logger will take it, and a lazy error handler is left to ask for it.
 
-int error_handler (int err_code, const void * data, const char * reason, const char * errmsg_fmt, ...)
+int ejp_error_handler (easyjsonparser_ctx * ctx, int err_code, const void * data, const char * reason, const char * errmsg_fmt, ...)
 {
   va_list args;
   va_start(args, errmsg_fmt);
-  char errmsg[MAX_LOGMSG_LEN];
-  vsnprintf(errmsg, MAX_LOGMSG_LEN, errmsg_fmt, args);
 
-  if (alt_errhandler == NULL) {
-    easyjsonparser_log(EASYJSONPARSER_LOG_LEVEL_ERROR, errmsg);
+  if (ctx->errhandler_lazy != NULL) {
+    easyjsonparser_error err;
+    err.ctx   = ctx;
+    err.stack = ctx->error_stack;
+    err.fmt   = errmsg_fmt;
+    err.args  = &args;
+    err.msg   = NULL;
+    ctx->error_stack = NULL;
+
+    int retval = ctx->errhandler_lazy(err_code, data, reason, &err);
+    va_end(args);
+
+    return (err_code & EASYJSONPARSER_ERROR_FATAL_BITS) == 0 ? retval : err_code;
+  }
+
+  if (ctx->errhandler == NULL) {
+    ejp_vlog(ctx, EASYJSONPARSER_LOG_LEVEL_ERROR, errmsg_fmt, args);
+    va_end(args);
     return err_code;
   }
 
+  char errmsg[MAX_LOGMSG_LEN];
+  vsnprintf(errmsg, MAX_LOGMSG_LEN, errmsg_fmt, args);
+  va_end(args);
+
   if ((err_code & EASYJSONPARSER_ERROR_FATAL_BITS) == 0)
-    return alt_errhandler(err_code, data, reason, errmsg);
+    return ctx->errhandler(err_code, data, reason, errmsg);
 
-  alt_errhandler(err_code, data, reason, errmsg);
+  ctx->errhandler(err_code, data, reason, errmsg);
   return err_code;
 }
+
+
+/// Return the message for an error passed to a lazy error handler,
+/// formatting it (and the stack path in the error data, if any) the first
+/// time it is asked for. Valid only until the handler returns.
+
+const char * easyjsonparser_error_message (easyjsonparser_error * err)
+{
+  if (err->msg != NULL)
+    return err->msg;
+
+  if (err->stack != NULL)
+    ejp_stack_path(err->ctx, err->stack);
+
+  va_list args;
+  va_copy(args, *err->args);
+  vsnprintf(err->buf, MAX_LOGMSG_LEN, err->fmt, args);
+  va_end(args);
+
+  return err->msg = err->buf;
+}
@@ -2,6 +2,15 @@
 #define EASYJSONPARSER_INCLUDED
 
 
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
 #define EASYJSONPARSER_SUCCESS                      0x00000000
 #define EASYJSONPARSER_ERROR_FILEOPEN               0x00001001
 #define EASYJSONPARSER_ERROR_LIBJSONC_PARSE         0x00005002
@@ -17,10 +26,20 @@
 #define EASYJSONPARSER_ERROR_SCHEMA_MANDATES_BOOL   0x00002011
 #define EASYJSONPARSER_ERROR_SCHEMA_MANDATES_NULL   0x00002012
 #define EASYJSONPARSER_ERROR_SCHEMA_INVALID         0x0000200b
+#define EASYJSONPARSER_ERROR_MEMORY                 0x0000100c
+#define EASYJSONPARSER_ERROR_FILEREAD               0x0000100d
+#define EASYJSONPARSER_ERROR_PARSE_UTF8             0x0000100e
+#define EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND       0x0000800f
+#define EASYJSONPARSER_ERROR_PARSE_DEPTH            0x00001013
+#define EASYJSONPARSER_ERROR_WRITE_OVERFLOW         0x00001014
+#define EASYJSONPARSER_ERROR_FILEWRITE              0x00001015
+#define EASYJSONPARSER_ERROR_SCHEMA_UNWRITABLE      0x00002016
+#define EASYJSONPARSER_WRITE_NONE                   0x00000017
 
 #define EASYJSONPARSER_ERROR_FATAL_BITS             0x00001000
 #define EASYJSONPARSER_ERROR_SCHEMA_BITS            0x00002000
 #define EASYJSONPARSER_ERROR_LIBJSONC_BITS          0x00004000
+#define EASYJSONPARSER_ERROR_CURSOR_BITS            0x00008000
 
 
 #define EASYJSONPARSER_LOG_LEVEL_NONE  0x0000
@@ -28,6 +47,14 @@
 #define EASYJSONPARSER_LOG_LEVEL_TRACE 0x0200
 
 
+#define EASYJSONPARSER_BACKEND_NATIVE 0x0000
+#define EASYJSONPARSER_BACKEND_JSONC  0x0001
+
+
+#define EASYJSONPARSER_OPTION_TRUSTED_INPUT    0x0001
+#define EASYJSONPARSER_OPTION_STOP_WHEN_COMPLETE 0x0002
+
+
 #define EASYJSONPARSER_SCHEMA_END       0x0000
 #define EASYJSONPARSER_SCHEMA_INT       0x0001
 #define EASYJSONPARSER_SCHEMA_STR       0x0002
@@ -36,18 +63,37 @@
 #define EASYJSONPARSER_SCHEMA_DBL       0x0010
 #define EASYJSONPARSER_SCHEMA_BOO       0x0011
 #define EASYJSONPARSER_SCHEMA_NUL       0x0012
+#define EASYJSONPARSER_SCHEMA_I64       0x0013
 #define EASYJSONPARSER_SCHEMA_ROO       0x0100
+#define EASYJSONPARSER_SCHEMA_CMP       0x0200
+#define EASYJSONPARSER_SCHEMA_FLD       0x0400
+#define EASYJSONPARSER_SCHEMA_VEW       0x0800
+#define EASYJSONPARSER_SCHEMA_ITN       0x1000
+#define EASYJSONPARSER_SCHEMA_IGN       0x2000
+#define EASYJSONPARSER_SCHEMA_ARR       0x4000
 
 #define EASYJSONPARSER_SCHEMA_TYPE_BITS 0x00ff
 
+#define EASYJSONPARSER_STRVIEW_INPUT    0x0001
+
+#define EASYJSONPARSER_VALUE_STRLEN     SIZE_MAX
+
 
 typedef struct easyjsonparser_stack_st easyjsonparser_stack;
 typedef struct easyjsonparser_schema_st easyjsonparser_schema;
+typedef struct easyjsonparser_parser_st easyjsonparser_parser;
+typedef struct easyjsonparser_ctx_st easyjsonparser_ctx;
+typedef struct easyjsonparser_arena_st easyjsonparser_arena;
+typedef struct easyjsonparser_intern_st easyjsonparser_intern;
+typedef struct easyjsonparser_cursor_st easyjsonparser_cursor;
+typedef struct easyjsonparser_value_st easyjsonparser_value;
+typedef struct easyjsonparser_error_st easyjsonparser_error;
 
 
 typedef struct easyjsonparser_stack_st {
   char *           key;
   easyjsonparser_stack * prev;
+  easyjsonparser_ctx *   ctx;
 } easyjsonparser_stack;
 
 
@@ -58,14 +104,113 @@ typedef struct easyjsonparser_schema_st {
   char * descr;
 } easyjsonparser_schema;
 
+typedef struct easyjsonparser_cursor_st {
+  easyjsonparser_ctx * ctx;
+  const char *         buf;
+  const char *         end;
+  const char *         p;
+  const char *         key;
+} easyjsonparser_cursor;
+
+typedef struct easyjsonparser_value_st {
+  easyjsonparser_schema * js;
+  const char *            key;
+  const char *            str;
+  size_t                  len;
+  int64_t                 i;
+  double                  d;
+  void *                  cfg;
+} easyjsonparser_value;
+
 
 extern void   easyjsonparser_set_loglevel (int loglevel);
 extern void   easyjsonparser_set_logger (void (*logger)(int, const char *));
 extern void   easyjsonparser_set_errhandler (int (*handler)(int, const void *, const char *, const char *));
+extern void   easyjsonparser_set_errhandler_lazy (int (*handler)(int, const void *, const char *, easyjsonparser_error *));
+extern void   easyjsonparser_set_backend (int backend);
+extern void   easyjsonparser_set_options (int options);
+extern void   easyjsonparser_set_max_depth (size_t max_depth);
 extern void   easyjsonparser_log (int level, const char *, ...);
 extern int    easyjsonparser_parse_file (const char * filename, easyjsonparser_schema * ys, void * cfg);
 extern int    easyjsonparser_parse_string (const char * input_string, easyjsonparser_schema * ys, void * cfg);
+extern int    easyjsonparser_parse_buffer (const char * buf, size_t len, easyjsonparser_schema * ys, void * cfg);
+extern const char * easyjsonparser_error_message (easyjsonparser_error * err);
 extern char * easyjsonparser_stack_path (easyjsonparser_stack * stack);
+extern char * easyjsonparser_stack_path_r (easyjsonparser_stack * stack, char * buf, size_t buf_len);
+extern easyjsonparser_arena * easyjsonparser_stack_arena (easyjsonparser_stack * stack);
+
+extern easyjsonparser_parser * easyjsonparser_parser_new (easyjsonparser_schema * js, void * cfg);
+extern int    easyjsonparser_parser_feed (easyjsonparser_parser * parser, const char * buf, size_t len);
+extern int    easyjsonparser_parser_finish (easyjsonparser_parser * parser);
+extern void   easyjsonparser_parser_free (easyjsonparser_parser * parser);
+
+extern easyjsonparser_schema * easyjsonparser_schema_compile (easyjsonparser_schema * js);
+extern void   easyjsonparser_schema_free (easyjsonparser_schema * js);
+
+extern easyjsonparser_ctx * easyjsonparser_ctx_new (void);
+extern void   easyjsonparser_ctx_free (easyjsonparser_ctx * ctx);
+extern void   easyjsonparser_ctx_reset (easyjsonparser_ctx * ctx);
+extern void   easyjsonparser_ctx_set_loglevel (easyjsonparser_ctx * ctx, int loglevel);
+extern void   easyjsonparser_ctx_set_logger (easyjsonparser_ctx * ctx, void (*logger)(int, const char *));
+extern void   easyjsonparser_ctx_set_errhandler (easyjsonparser_ctx * ctx, int (*handler)(int, const void *, const char *, const char *));
+extern void   easyjsonparser_ctx_set_errhandler_lazy (easyjsonparser_ctx * ctx, int (*handler)(int, const void *, const char *, easyjsonparser_error *));
+extern void   easyjsonparser_ctx_set_backend (easyjsonparser_ctx * ctx, int backend);
+extern void   easyjsonparser_ctx_set_options (easyjsonparser_ctx * ctx, int options);
+extern void   easyjsonparser_ctx_set_max_depth (easyjsonparser_ctx * ctx, size_t max_depth);
+extern void   easyjsonparser_ctx_set_arena (easyjsonparser_ctx * ctx, easyjsonparser_arena * arena);
+extern void   easyjsonparser_ctx_set_intern (easyjsonparser_ctx * ctx, easyjsonparser_intern * intern);
+extern int    easyjsonparser_ctx_parse_file (easyjsonparser_ctx * ctx, const char * filename, easyjsonparser_schema * ys, void * cfg);
+extern int    easyjsonparser_ctx_parse_string (easyjsonparser_ctx * ctx, const char * input_string, easyjsonparser_schema * ys, void * cfg);
+extern int    easyjsonparser_ctx_parse_buffer (easyjsonparser_ctx * ctx, const char * buf, size_t len, easyjsonparser_schema * ys, void * cfg);
+extern easyjsonparser_parser * easyjsonparser_ctx_parser_new (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, void * cfg);
+
+extern easyjsonparser_arena * easyjsonparser_arena_new (void);
+extern void   easyjsonparser_arena_free (easyjsonparser_arena * arena);
+extern void   easyjsonparser_arena_reset (easyjsonparser_arena * arena);
+extern void * easyjsonparser_arena_alloc (easyjsonparser_arena * arena, size_t size);
+extern char * easyjsonparser_arena_strdup (easyjsonparser_arena * arena, const char * str);
+extern char * easyjsonparser_arena_strndup (easyjsonparser_arena * arena, const char * str, size_t len);
+
+extern easyjsonparser_intern * easyjsonparser_intern_new (void);
+extern void   easyjsonparser_intern_free (easyjsonparser_intern * intern);
+extern void   easyjsonparser_intern_reset (easyjsonparser_intern * intern);
+extern const char * easyjsonparser_intern_add (easyjsonparser_intern * intern, const char * str, size_t len, uint32_t * id);
+extern const char * easyjsonparser_intern_str (easyjsonparser_intern * intern, uint32_t id);
+extern size_t easyjsonparser_intern_count (easyjsonparser_intern * intern);
+extern int    easyjsonparser_cursor_init (easyjsonparser_ctx * ctx, easyjsonparser_cursor * cur, const char * buf, size_t len);
+extern int    easyjsonparser_cursor_type (const easyjsonparser_cursor * cur);
+extern int    easyjsonparser_cursor_find_key (const easyjsonparser_cursor * map, const char * key, easyjsonparser_cursor * val);
+extern int    easyjsonparser_cursor_first (const easyjsonparser_cursor * container, easyjsonparser_cursor * elem);
+extern int    easyjsonparser_cursor_next (easyjsonparser_cursor * elem);
+extern int    easyjsonparser_cursor_at (const easyjsonparser_cursor * list, size_t n, easyjsonparser_cursor * elem);
+extern int    easyjsonparser_cursor_get_key (const easyjsonparser_cursor * elem, const char ** key, size_t * len);
+extern int    easyjsonparser_cursor_get_str (const easyjsonparser_cursor * cur, const char ** val, size_t * len);
+extern int    easyjsonparser_cursor_get_int (const easyjsonparser_cursor * cur, int64_t * val);
+extern int    easyjsonparser_cursor_get_double (const easyjsonparser_cursor * cur, double * val);
+extern int    easyjsonparser_cursor_get_bool (const easyjsonparser_cursor * cur, int * val);
+extern int    easyjsonparser_scan_init (easyjsonparser_ctx * ctx, easyjsonparser_cursor * cur, const char * buf, size_t len);
+extern int    easyjsonparser_scan_finish (easyjsonparser_cursor * cur);
+extern int    easyjsonparser_scan_enter (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack);
+extern int    easyjsonparser_scan_depth (easyjsonparser_cursor * cur, size_t depth);
+extern int    easyjsonparser_scan_next (easyjsonparser_cursor * cur, int type);
+extern int    easyjsonparser_scan_key (easyjsonparser_cursor * cur, const char ** key, size_t * len);
+extern int    easyjsonparser_scan_unexpected (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, const char * key, size_t len);
+extern int    easyjsonparser_scan_mismatch (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack);
+extern int    easyjsonparser_scan_nomem (easyjsonparser_cursor * cur, size_t size);
+extern int    easyjsonparser_scan_skip (easyjsonparser_cursor * cur);
+extern int    easyjsonparser_scan_str (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, char ** val, size_t * len);
+extern int    easyjsonparser_scan_str_field (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
+extern int    easyjsonparser_scan_int (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, int64_t * val);
+extern int    easyjsonparser_scan_double (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, double * val);
+extern int    easyjsonparser_scan_bool (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, int * val);
+extern int    easyjsonparser_scan_null (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack);
+
+extern int    easyjsonparser_write (char ** out, size_t * len, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *));
+extern int    easyjsonparser_write_buffer (char * buf, size_t size, size_t * len, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *));
+extern int    easyjsonparser_write_fd (int fd, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *));
+extern int    easyjsonparser_ctx_write (easyjsonparser_ctx * ctx, char ** out, size_t * len, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *));
+extern int    easyjsonparser_ctx_write_buffer (easyjsonparser_ctx * ctx, char * buf, size_t size, size_t * len, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *));
+extern int    easyjsonparser_ctx_write_fd (easyjsonparser_ctx * ctx, int fd, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *));
 
 
 #define EASYJSONPARSER_SCHEMA(name, root_type)   easyjsonparser_schema name[] = { { 0, EASYJSONPARSER_SCHEMA_ROO | root_type, 0, 0 },
@@ -74,10 +219,29 @@ extern char * easyjsonparser_stack_path (easyjsonparser_stack * stack);
 #define EASYJSONPARSER_INT(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_INT, handler, descr }
 #define EASYJSONPARSER_MAP(name, child, descr)   { name, EASYJSONPARSER_SCHEMA_MAP, child,   descr }
 #define EASYJSONPARSER_LST(name, child, descr)   { name, EASYJSONPARSER_SCHEMA_LST, child,   descr }
+#define EASYJSONPARSER_MAP_LENIENT(name, child, descr) { name, EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN, child, descr }
 #define EASYJSONPARSER_DBL(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_DBL, handler, descr }
 #define EASYJSONPARSER_BOO(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_BOO, handler, descr }
 #define EASYJSONPARSER_NUL(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_NUL, handler, descr }
+#define EASYJSONPARSER_I64(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_I64, handler, descr }
 #define EASYJSONPARSER_END()                     { 0, 0, 0 } }
 
+#define EASYJSONPARSER_STR_VIEW(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_VEW, handler, descr }
+#define EASYJSONPARSER_STR_INTERN(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_ITN, handler, descr }
+
+#define EASYJSONPARSER_STR_FIELD(name, struct_type, member, descr) { name, EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_FLD, (void *) offsetof(struct_type, member), descr }
+#define EASYJSONPARSER_INT_FIELD(name, struct_type, member, descr) { name, EASYJSONPARSER_SCHEMA_INT | EASYJSONPARSER_SCHEMA_FLD, (void *) offsetof(struct_type, member), descr }
+#define EASYJSONPARSER_DBL_FIELD(name, struct_type, member, descr) { name, EASYJSONPARSER_SCHEMA_DBL | EASYJSONPARSER_SCHEMA_FLD, (void *) offsetof(struct_type, member), descr }
+#define EASYJSONPARSER_BOO_FIELD(name, struct_type, member, descr) { name, EASYJSONPARSER_SCHEMA_BOO | EASYJSONPARSER_SCHEMA_FLD, (void *) offsetof(struct_type, member), descr }
+#define EASYJSONPARSER_I64_FIELD(name, struct_type, member, descr) { name, EASYJSONPARSER_SCHEMA_I64 | EASYJSONPARSER_SCHEMA_FLD, (void *) offsetof(struct_type, member), descr }
+
+#define EASYJSONPARSER_INT_ARRAY(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_I64 | EASYJSONPARSER_SCHEMA_ARR, handler, descr }
+#define EASYJSONPARSER_DBL_ARRAY(name, handler, descr) { name, EASYJSONPARSER_SCHEMA_DBL | EASYJSONPARSER_SCHEMA_ARR, handler, descr }
+
+
+#ifdef __cplusplus
+}
+#endif
+
 
 #endif // EASYJSONPARSER_INCLUDED
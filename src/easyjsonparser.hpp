@@ -0,0 +1,942 @@
+/// \file
+/// \brief Header only C++17 interface to libeasyjsonparser.
+///
+/// A schema is a constexpr value whose type describes it, built from
+/// \ref ejp::str, \ref ejp::map and friends, and its handlers are lambdas,
+/// functions or pointers to the data members to store values in, called
+/// with their real types, not cast through the void pointer of a schema
+/// entry. The parse is a tree of function templates, one instance per
+/// schema entry, so every handler can be inlined and each map's keys are
+/// compared against its entry keys, constants to the compiler, in place.
+/// Underneath it is the C library's scan functions (see
+/// \ref easyjsonparser_scan_init), so the contexts, stacks and errors are
+/// those of the C interface.
+///
+///   struct config { std::string version; int port; };
+///
+///   constexpr auto schema = ejp::map(nullptr, "config",
+///     ejp::str("version", &config::version, "configuration version"),
+///     ejp::integer("port", [](easyjsonparser_stack *, int port, config & cfg) { cfg.port = port; }, "TCP port"));
+///
+///   config cfg;
+///   int result = ejp::parse_string(json, schema, cfg);
+///
+/// A handler is called as handler(stack, val, cfg), or handler(val, cfg)
+/// if it takes only two arguments (handler(stack, cfg) or handler(cfg) for
+/// nul entries), strings being passed as std::string_view, valid only
+/// while the handler runs. A data member is assigned the value, and
+/// nullptr as a handler ignores it. Keys must be string literals (or
+/// otherwise outlive the parse), nullptr for list entries and the single
+/// entry of a variable key map, as for the C schema.
+///
+/// For consumers which would rather not be called back at all there is
+/// also a pull parser (see \ref ejp::events), returning the JSON as events
+/// in the caller's own control flow, checked against a C schema.
+
+
+#ifndef EASYJSONPARSER_HPP_INCLUDED
+#define EASYJSONPARSER_HPP_INCLUDED
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <deque>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "easyjsonparser.h"
+
+
+namespace ejp {
+
+
+/// A scalar schema entry, of C schema entry type \p Type, delivering its
+/// value to \p H.
+
+template <int Type, typename H>
+struct scalar_entry {
+  const char * key;
+  std::size_t  key_len;
+  H            handler;
+  const char * descr;
+};
+
+
+/// A map or list schema entry, of C schema entry type \p Type (with
+/// \ref EASYJSONPARSER_SCHEMA_IGN for lenient maps), with child entries
+/// \p E.
+
+template <int Type, typename... E>
+struct container_entry {
+  const char *     key;
+  std::size_t      key_len;
+  const char *     descr;
+  std::tuple<E...> entries;
+};
+
+
+namespace detail {
+
+constexpr std::size_t key_length (const char * key)
+{
+  return key == nullptr ? 0 : std::char_traits<char>::length(key);
+}
+
+template <typename T>
+struct is_container : std::false_type {};
+
+template <int Type, typename... E>
+struct is_container<container_entry<Type, E...>> : std::true_type {};
+
+
+/// The C schema entry for \p e, for the scan functions to report errors
+/// with.
+
+template <int Type, typename H>
+inline easyjsonparser_schema c_entry (const scalar_entry<Type, H> & e)
+{
+  return { const_cast<char *>(e.key), Type, nullptr, const_cast<char *>(e.descr) };
+}
+
+template <int Type, typename... E>
+inline easyjsonparser_schema c_entry (const container_entry<Type, E...> & e)
+{
+  return { const_cast<char *>(e.key), Type, nullptr, const_cast<char *>(e.descr) };
+}
+
+
+/// Return true if the entry \p e takes values of C schema entry type
+/// \p type (as \ref ejp_schema_accepts).
+
+template <typename E>
+constexpr bool accepts (const E &, int type);
+
+template <int Type, typename H>
+constexpr bool accepts (const scalar_entry<Type, H> &, int type)
+{
+  return Type == type || (Type == EASYJSONPARSER_SCHEMA_I64 && type == EASYJSONPARSER_SCHEMA_INT);
+}
+
+template <int Type, typename... E>
+constexpr bool accepts (const container_entry<Type, E...> &, int type)
+{
+  return (Type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == type;
+}
+
+
+/// Return true if the list entry \p e takes the value at \p cur, of C
+/// schema entry type \p type. As in rec_parse_list, a map entry with a key
+/// only takes objects which have that key.
+
+template <typename E>
+bool takes (const easyjsonparser_cursor *, const E & e, int type)
+{
+  return accepts(e, type);
+}
+
+template <int Type, typename... E>
+bool takes (const easyjsonparser_cursor * cur, const container_entry<Type, E...> & e, int type)
+{
+  if (!accepts(e, type))
+    return false;
+  if (type != EASYJSONPARSER_SCHEMA_MAP || e.key == nullptr)
+    return true;
+
+  easyjsonparser_cursor val;
+  return easyjsonparser_cursor_find_key(cur, e.key, &val) == EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Deliver \p val to the handler or data member \p h.
+
+template <typename H, typename V, typename Cfg>
+inline void deliver (const H & h, easyjsonparser_stack * stack, V && val, Cfg & cfg)
+{
+  if constexpr (std::is_null_pointer_v<H>) {
+    (void) stack;
+  } else if constexpr (std::is_member_object_pointer_v<H>) {
+    cfg.*h = std::forward<V>(val);
+  } else if constexpr (std::is_invocable_v<const H &, easyjsonparser_stack *, V, Cfg &>) {
+    h(stack, std::forward<V>(val), cfg);
+  } else {
+    static_assert(std::is_invocable_v<const H &, V, Cfg &>,
+                  "handler must be callable as (easyjsonparser_stack *, value, cfg) or (value, cfg)");
+    h(std::forward<V>(val), cfg);
+  }
+}
+
+template <typename H, typename Cfg>
+inline void deliver_null (const H & h, easyjsonparser_stack * stack, Cfg & cfg)
+{
+  if constexpr (std::is_null_pointer_v<H>) {
+    (void) stack;
+  } else if constexpr (std::is_invocable_v<const H &, easyjsonparser_stack *, Cfg &>) {
+    h(stack, cfg);
+  } else {
+    static_assert(std::is_invocable_v<const H &, Cfg &>,
+                  "nul handler must be callable as (easyjsonparser_stack *, cfg) or (cfg)");
+    h(cfg);
+  }
+}
+
+
+template <int Type, typename H, typename Cfg>
+int scan (easyjsonparser_cursor * cur, const scalar_entry<Type, H> & e, easyjsonparser_stack * stack, Cfg & cfg);
+
+template <int Type, typename... E, typename Cfg>
+int scan (easyjsonparser_cursor * cur, const container_entry<Type, E...> & e, easyjsonparser_stack * stack, Cfg & cfg);
+
+
+/// Scan the scalar at \p cur for \p e, the value's stack being \p stack.
+
+template <int Type, typename H, typename Cfg>
+int scan (easyjsonparser_cursor * cur, const scalar_entry<Type, H> & e, easyjsonparser_stack * stack, Cfg & cfg)
+{
+  easyjsonparser_schema js = c_entry(e);
+  int retval;
+
+  if constexpr (Type == EASYJSONPARSER_SCHEMA_STR) {
+    char * val;
+    std::size_t len;
+    if ((retval = easyjsonparser_scan_str(cur, &js, stack, &val, &len)) == EASYJSONPARSER_SUCCESS)
+      deliver(e.handler, stack, std::string_view(val, len), cfg);
+  } else if constexpr (Type == EASYJSONPARSER_SCHEMA_INT) {
+    int64_t val;
+    if ((retval = easyjsonparser_scan_int(cur, &js, stack, &val)) == EASYJSONPARSER_SUCCESS)
+      deliver(e.handler, stack, val > INT_MAX ? INT_MAX : val < INT_MIN ? INT_MIN : (int) val, cfg);
+  } else if constexpr (Type == EASYJSONPARSER_SCHEMA_I64) {
+    int64_t val;
+    if ((retval = easyjsonparser_scan_int(cur, &js, stack, &val)) == EASYJSONPARSER_SUCCESS)
+      deliver(e.handler, stack, val, cfg);
+  } else if constexpr (Type == EASYJSONPARSER_SCHEMA_DBL) {
+    double val;
+    if ((retval = easyjsonparser_scan_double(cur, &js, stack, &val)) == EASYJSONPARSER_SUCCESS)
+      deliver(e.handler, stack, val, cfg);
+  } else if constexpr (Type == EASYJSONPARSER_SCHEMA_BOO) {
+    int val;
+    if ((retval = easyjsonparser_scan_bool(cur, &js, stack, &val)) == EASYJSONPARSER_SUCCESS)
+      deliver(e.handler, stack, val != 0, cfg);
+  } else {
+    static_assert(Type == EASYJSONPARSER_SCHEMA_NUL, "unknown scalar entry type");
+    if ((retval = easyjsonparser_scan_null(cur, &js, stack)) == EASYJSONPARSER_SUCCESS)
+      deliver_null(e.handler, stack, cfg);
+  }
+
+  return retval;
+}
+
+
+/// Scan the map or list at \p cur for \p e, the value's stack being
+/// \p stack. Map keys are dispatched by comparing them with each entry
+/// key in turn, lengths first, list elements by their type.
+
+template <int Type, typename... E, typename Cfg>
+int scan (easyjsonparser_cursor * cur, const container_entry<Type, E...> & e, easyjsonparser_stack * stack, Cfg & cfg)
+{
+  easyjsonparser_schema js = c_entry(e);
+  int retval = easyjsonparser_scan_enter(cur, &js, stack);
+
+  if constexpr ((Type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_MAP) {
+    easyjsonparser_stack member;
+    member.prev = stack;
+    member.ctx  = stack->ctx;
+
+    std::string keybuf;
+
+    while (retval == EASYJSONPARSER_SUCCESS) {
+      const char * key;
+      std::size_t key_len;
+      if ((retval = easyjsonparser_scan_key(cur, &key, &key_len)) != EASYJSONPARSER_SUCCESS)
+        return retval;
+
+      bool found = false;
+      if constexpr (sizeof...(E) == 1) {
+        if (std::get<0>(e.entries).key == nullptr) {
+          keybuf.assign(key, key_len);
+          member.key = keybuf.data();
+          retval = scan(cur, std::get<0>(e.entries), &member, cfg);
+          found = true;
+        }
+      }
+      if (!found) {
+        found = std::apply([&](const auto &... child) {
+            return ((child.key != nullptr && child.key_len == key_len && std::memcmp(child.key, key, key_len) == 0
+                     && (member.key = const_cast<char *>(child.key), retval = scan(cur, child, &member, cfg), true)) || ...);
+          }, e.entries);
+      }
+      if (!found && (Type & EASYJSONPARSER_SCHEMA_IGN)) {
+        retval = easyjsonparser_scan_skip(cur);
+      } else if (!found) {
+        easyjsonparser_schema table[sizeof...(E) + 1] = {};
+        std::size_t i = 0;
+        std::apply([&](const auto &... child) { ((table[i++] = c_entry(child)), ...); }, e.entries);
+        retval = easyjsonparser_scan_unexpected(cur, table, stack, key, key_len);
+      }
+
+      if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+        retval = EASYJSONPARSER_SUCCESS;
+      if (retval == EASYJSONPARSER_SUCCESS)
+        retval = easyjsonparser_scan_next(cur, EASYJSONPARSER_SCHEMA_MAP);
+    }
+  } else {
+    static_assert(sizeof...(E) > 0, "a list must have at least one entry");
+
+    while (retval == EASYJSONPARSER_SUCCESS) {
+      // A lone map entry with a key still only takes objects with it.
+      if constexpr (sizeof...(E) == 1 && !is_container<std::tuple_element_t<0, std::tuple<E...>>>::value) {
+        retval = scan(cur, std::get<0>(e.entries), stack, cfg);
+      } else {
+        int type = easyjsonparser_cursor_type(cur);
+        bool found = std::apply([&](const auto &... child) {
+            return ((takes(cur, child, type) && (retval = scan(cur, child, stack, cfg), true)) || ...);
+          }, e.entries);
+        // Anything else is reported as the first entry's mismatch.
+        if (!found) {
+          easyjsonparser_schema first = c_entry(std::get<0>(e.entries));
+          retval = easyjsonparser_scan_mismatch(cur, &first, stack);
+        }
+      }
+
+      if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+        retval = EASYJSONPARSER_SUCCESS;
+      if (retval == EASYJSONPARSER_SUCCESS)
+        retval = easyjsonparser_scan_next(cur, EASYJSONPARSER_SCHEMA_LST);
+    }
+  }
+
+  return retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND ? EASYJSONPARSER_SUCCESS : retval;
+}
+
+} // namespace detail
+
+
+/// Schema entries, as the C schema macros of the same names, with
+/// \ref ejp::integer for EASYJSONPARSER_INT.
+
+template <typename H>
+constexpr auto str (const char * key, H handler, const char * descr = nullptr)
+{
+  return scalar_entry<EASYJSONPARSER_SCHEMA_STR, H>{ key, detail::key_length(key), handler, descr };
+}
+
+template <typename H>
+constexpr auto integer (const char * key, H handler, const char * descr = nullptr)
+{
+  return scalar_entry<EASYJSONPARSER_SCHEMA_INT, H>{ key, detail::key_length(key), handler, descr };
+}
+
+template <typename H>
+constexpr auto i64 (const char * key, H handler, const char * descr = nullptr)
+{
+  return scalar_entry<EASYJSONPARSER_SCHEMA_I64, H>{ key, detail::key_length(key), handler, descr };
+}
+
+template <typename H>
+constexpr auto dbl (const char * key, H handler, const char * descr = nullptr)
+{
+  return scalar_entry<EASYJSONPARSER_SCHEMA_DBL, H>{ key, detail::key_length(key), handler, descr };
+}
+
+template <typename H>
+constexpr auto boo (const char * key, H handler, const char * descr = nullptr)
+{
+  return scalar_entry<EASYJSONPARSER_SCHEMA_BOO, H>{ key, detail::key_length(key), handler, descr };
+}
+
+template <typename H>
+constexpr auto nul (const char * key, H handler, const char * descr = nullptr)
+{
+  return scalar_entry<EASYJSONPARSER_SCHEMA_NUL, H>{ key, detail::key_length(key), handler, descr };
+}
+
+template <typename... E>
+constexpr auto map (const char * key, const char * descr, E... entries)
+{
+  return container_entry<EASYJSONPARSER_SCHEMA_MAP, E...>{ key, detail::key_length(key), descr, { entries... } };
+}
+
+template <typename... E>
+constexpr auto map_lenient (const char * key, const char * descr, E... entries)
+{
+  return container_entry<EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN, E...>{ key, detail::key_length(key), descr, { entries... } };
+}
+
+template <typename... E>
+constexpr auto lst (const char * key, const char * descr, E... entries)
+{
+  return container_entry<EASYJSONPARSER_SCHEMA_LST, E...>{ key, detail::key_length(key), descr, { entries... } };
+}
+
+
+/// Parse \p len bytes of JSON at \p buf against \p schema (a map or list
+/// entry, its key ignored) with the context \p ctx, delivering values to
+/// \p cfg.
+
+template <typename Schema, typename Cfg>
+int parse_buffer (easyjsonparser_ctx * ctx, const char * buf, std::size_t len, const Schema & schema, Cfg & cfg)
+{
+  static_assert(detail::is_container<Schema>::value, "the schema must be a map or list");
+
+  easyjsonparser_stack stack;
+  stack.key  = nullptr;
+  stack.prev = nullptr;
+  stack.ctx  = ctx;
+
+  easyjsonparser_cursor cur;
+  int retval = easyjsonparser_scan_init(ctx, &cur, buf, len);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = detail::scan(&cur, schema, &stack, cfg);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = easyjsonparser_scan_finish(&cur);
+
+  return retval;
+}
+
+template <typename Schema, typename Cfg>
+int parse_string (easyjsonparser_ctx * ctx, std::string_view input, const Schema & schema, Cfg & cfg)
+{
+  return parse_buffer(ctx, input.data(), input.size(), schema, cfg);
+}
+
+
+/// Parse as above, with a context of the process wide settings.
+
+template <typename Schema, typename Cfg>
+int parse_buffer (const char * buf, std::size_t len, const Schema & schema, Cfg & cfg)
+{
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  if (ctx == nullptr)
+    return EASYJSONPARSER_ERROR_MEMORY;
+
+  int retval = parse_buffer(ctx, buf, len, schema, cfg);
+
+  easyjsonparser_ctx_free(ctx);
+  return retval;
+}
+
+template <typename Schema, typename Cfg>
+int parse_string (std::string_view input, const Schema & schema, Cfg & cfg)
+{
+  return parse_buffer(input.data(), input.size(), schema, cfg);
+}
+
+
+/// Pull parsing.
+///
+/// Where the parse above calls handlers, a \ref ejp::pull_parser returns
+/// the JSON as a sequence of events which the caller asks for one at a
+/// time, so it can be consumed in the caller's own control flow:
+///
+///   for (auto & ev : ejp::events(json, schema)) {
+///     if (ev.type == ejp::event_type::integer && ev.key == "port")
+///       port = ev.integer;
+///   }
+///
+/// With a schema (C schema entry tables, as given to
+/// \ref easyjsonparser_parse_string, compiled or not) the input is checked
+/// against it as it is pulled, exactly as the parser would check it, with
+/// the same errors reported to the error handler, and values the error
+/// handler quashes errors for (or the keys of lenient maps not in the
+/// schema) are skipped, never seen as events. Without one every value is
+/// an event. As with the scan functions the parse stops at the first error
+/// not quashed, returned by \ref ejp::pull_parser::next (and afterwards by
+/// \ref ejp::pull_parser::result).
+
+namespace detail {
+
+/// Return true if the C schema entry \p js takes a JSON value of \p type,
+/// as ejp_schema_accepts.
+
+inline bool accepts_type (const easyjsonparser_schema * js, int type)
+{
+  if (js->type & EASYJSONPARSER_SCHEMA_ARR)
+    return type == EASYJSONPARSER_SCHEMA_LST;
+
+  int js_type = js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+
+  return js_type == type || (js_type == EASYJSONPARSER_SCHEMA_I64 && type == EASYJSONPARSER_SCHEMA_INT);
+}
+
+} // namespace detail
+
+
+enum class event_type {
+  map_begin,
+  map_end,
+  list_begin,
+  list_end,
+  str,
+  integer,
+  dbl,
+  boolean,
+  null,
+};
+
+
+/// An event, only valid until the next is pulled. The key is that of the
+/// value in the map it is in (empty for list elements and the root), and
+/// the value is in whichever of str, integer, dbl or boolean its type says.
+/// The schema entry is that the value was checked against (nullptr without
+/// a schema), and the stack is the value's, as a handler would be given.
+
+struct event {
+  event_type              type     = event_type::null;
+  std::string_view        key;
+  easyjsonparser_schema * schema   = nullptr;
+  easyjsonparser_stack *  stack    = nullptr;
+  std::string_view        str;
+  int64_t                 integer  = 0;
+  double                  dbl      = 0;
+  bool                    boolean  = false;
+};
+
+
+class pull_parser {
+ public:
+
+  /// Pull the \p len bytes of JSON at \p buf (which must outlive the
+  /// parser) with the context \p ctx, checking it against the schema
+  /// \p js if it is not nullptr.
+
+  pull_parser (easyjsonparser_ctx * ctx, const char * buf, std::size_t len, easyjsonparser_schema * js = nullptr)
+  {
+    init(ctx, buf, len, js);
+  }
+
+  /// Pull as above, with a context of the process wide settings.
+
+  pull_parser (const char * buf, std::size_t len, easyjsonparser_schema * js = nullptr)
+  {
+    own_ctx_ = easyjsonparser_ctx_new();
+    if (own_ctx_ == nullptr)
+      result_ = EASYJSONPARSER_ERROR_MEMORY;
+    else
+      init(own_ctx_, buf, len, js);
+  }
+
+  pull_parser (const pull_parser &) = delete;
+  pull_parser & operator= (const pull_parser &) = delete;
+
+  ~pull_parser ()
+  {
+    if (own_ctx_ != nullptr)
+      easyjsonparser_ctx_free(own_ctx_);
+  }
+
+  /// Pull the next event into \p ev, returning
+  /// \ref EASYJSONPARSER_SUCCESS, or
+  /// \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND if there are no more (the
+  /// input having been parsed to the end), or the error which stopped the
+  /// parse.
+
+  int next (event & ev)
+  {
+    if (result_ != EASYJSONPARSER_SUCCESS || done_)
+      return result_ != EASYJSONPARSER_SUCCESS ? result_ : EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+
+    int retval = step(ev);
+    if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND && (retval = easyjsonparser_scan_finish(&cur_)) == EASYJSONPARSER_SUCCESS)
+      retval = EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+
+    if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+      done_ = true;
+    else if (retval != EASYJSONPARSER_SUCCESS)
+      result_ = retval;
+
+    return retval;
+  }
+
+  /// Skip the contents of the map or list whose begin event was the last
+  /// pulled, so that the next event is whatever follows it (with no end
+  /// event for it). Otherwise this does nothing.
+
+  int skip ()
+  {
+    if (result_ == EASYJSONPARSER_SUCCESS && !frames_.empty() && !frames_.back().entered) {
+      if ((result_ = easyjsonparser_scan_skip(&cur_)) == EASYJSONPARSER_SUCCESS)
+        frames_.pop_back();
+    }
+
+    return result_;
+  }
+
+  /// Return the error which stopped the parse, or
+  /// \ref EASYJSONPARSER_SUCCESS if there has been none (so after
+  /// iterating over the events, whether the parse succeeded).
+
+  int result () const
+  {
+    return result_;
+  }
+
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type        = event;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = event *;
+    using reference         = event &;
+
+    iterator () = default;
+    explicit iterator (pull_parser * parser) : parser_(parser) { ++*this; }
+
+    event & operator* () { return ev_; }
+    event * operator-> () { return &ev_; }
+
+    iterator & operator++ ()
+    {
+      if (parser_ != nullptr && parser_->next(ev_) != EASYJSONPARSER_SUCCESS)
+        parser_ = nullptr;
+      return *this;
+    }
+
+    bool operator== (const iterator & other) const { return parser_ == other.parser_; }
+    bool operator!= (const iterator & other) const { return parser_ != other.parser_; }
+
+   private:
+    pull_parser * parser_ = nullptr;
+    event         ev_;
+  };
+
+  /// Iterate over the events, which ends at the end of the input or the
+  /// first error (see \ref result).
+
+  iterator begin () { return iterator(this); }
+  iterator end () { return iterator(); }
+
+ private:
+
+  /// A map or list being pulled. The stack is the value's, and the member
+  /// stack that of its current key (a copy of which is kept in keybuf,
+  /// unless it is a schema entry key).
+
+  struct frame {
+    int                     type;
+    bool                    arr      = false;
+    bool                    entered  = false;
+    bool                    started  = false;
+    bool                    varkeys  = false;
+    bool                    lenient  = false;
+    easyjsonparser_schema * js;
+    easyjsonparser_schema * entries;
+    easyjsonparser_schema   elem;
+    std::string_view        key;
+    easyjsonparser_stack *  stack;
+    easyjsonparser_stack    member;
+    std::string             keybuf;
+  };
+
+  void init (easyjsonparser_ctx * ctx, const char * buf, std::size_t len, easyjsonparser_schema * js)
+  {
+    root_stack_.key  = nullptr;
+    root_stack_.prev = nullptr;
+    root_stack_.ctx  = ctx;
+
+    if (js != nullptr) {
+      root_js_ = *js;
+      root_js_.type &= EASYJSONPARSER_SCHEMA_TYPE_BITS;
+      if (root_js_.type == EASYJSONPARSER_SCHEMA_MAP || root_js_.type == EASYJSONPARSER_SCHEMA_LST)
+        root_js_.data = js + 1;
+      lenient_ = (js->type & EASYJSONPARSER_SCHEMA_IGN) != 0;
+      schema_  = true;
+    }
+
+    result_ = easyjsonparser_scan_init(ctx, &cur_, buf, len);
+  }
+
+  /// Take steps until there is an event for \p ev, or no more.
+
+  int step (event & ev)
+  {
+    for (;;) {
+      int retval;
+
+      if (frames_.empty()) {
+        if (started_)
+          return EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+        started_ = true;
+        retval = value(ev, schema_ ? &root_js_ : nullptr, &root_stack_, std::string_view());
+        if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+          continue;
+        return retval;
+      }
+
+      frame & f = frames_.back();
+
+      if (!f.entered) {
+        easyjsonparser_schema js = { nullptr, f.type, nullptr, nullptr };
+        f.entered = true;
+        if ((retval = easyjsonparser_scan_enter(&cur_, &js, f.stack)) == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+          return close(ev);
+        if (retval != EASYJSONPARSER_SUCCESS)
+          return retval;
+      } else if (f.started) {
+        if ((retval = easyjsonparser_scan_next(&cur_, f.type)) == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+          return close(ev);
+        if (retval != EASYJSONPARSER_SUCCESS)
+          return retval;
+      }
+      f.started = true;
+
+      retval = f.type == EASYJSONPARSER_SCHEMA_MAP ? member(ev, f) : element(ev, f);
+      if (retval != EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+        return retval;
+    }
+  }
+
+  /// Pull the next member of the map of \p f, as rec_parse_obj would parse
+  /// it, returning \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND if it was
+  /// skipped.
+
+  int member (event & ev, frame & f)
+  {
+    const char * key;
+    std::size_t key_len;
+    int retval = easyjsonparser_scan_key(&cur_, &key, &key_len);
+    if (retval != EASYJSONPARSER_SUCCESS)
+      return retval;
+
+    easyjsonparser_schema * js = nullptr;
+    if (f.varkeys) {
+      js = f.entries;
+    } else if (f.entries != nullptr) {
+      for (easyjsonparser_schema * e = f.entries; e->type != EASYJSONPARSER_SCHEMA_END; e++)
+        if (e->key != nullptr && std::strncmp(e->key, key, key_len) == 0 && e->key[key_len] == '\0') {
+          js = e;
+          break;
+        }
+    }
+
+    if (js != nullptr && !f.varkeys) {
+      f.member.key = js->key;
+    } else {
+      f.keybuf.assign(key, key_len);
+      f.member.key = f.keybuf.data();
+    }
+
+    if (js == nullptr && f.entries != nullptr) {
+      retval = f.lenient
+        ? easyjsonparser_scan_skip(&cur_)
+        : easyjsonparser_scan_unexpected(&cur_, f.entries, f.stack, key, key_len);
+      return retval == EASYJSONPARSER_SUCCESS ? EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND : retval;
+    }
+
+    return value(ev, js, &f.member, std::string_view(f.member.key, key_len));
+  }
+
+  /// Pull the next element of the list of \p f, as rec_parse_list would
+  /// parse it, with the first schema entry taking it. Returns
+  /// \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND if it was skipped.
+
+  int element (event & ev, frame & f)
+  {
+    if (f.arr) {
+      // Integers are taken as doubles by double arrays, as
+      // EASYJSONPARSER_DBL_ARRAY takes them.
+      if (f.elem.type == EASYJSONPARSER_SCHEMA_DBL && easyjsonparser_cursor_type(&cur_) == EASYJSONPARSER_SCHEMA_INT) {
+        easyjsonparser_schema js = f.elem;
+        js.type = EASYJSONPARSER_SCHEMA_INT;
+        int64_t val;
+        int retval = easyjsonparser_scan_int(&cur_, &js, f.stack, &val);
+        if (retval == EASYJSONPARSER_SUCCESS) {
+          ev        = event();
+          ev.type   = event_type::dbl;
+          ev.dbl    = (double) val;
+          ev.schema = &f.elem;
+          ev.stack  = f.stack;
+        }
+        return retval;
+      }
+      return value(ev, &f.elem, f.stack, std::string_view());
+    }
+    if (f.entries == nullptr)
+      return value(ev, nullptr, f.stack, std::string_view());
+
+    int type = easyjsonparser_cursor_type(&cur_);
+    easyjsonparser_schema * js = f.entries;
+
+    for (; js->type != EASYJSONPARSER_SCHEMA_END; js++) {
+      if (!detail::accepts_type(js, type))
+        continue;
+      if (type == EASYJSONPARSER_SCHEMA_MAP && js->key != nullptr) {
+        easyjsonparser_cursor val;
+        int retval = easyjsonparser_cursor_find_key(&cur_, js->key, &val);
+        if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+          continue;
+        if (retval != EASYJSONPARSER_SUCCESS)
+          return retval;
+      }
+      break;
+    }
+
+    // No entry takes it, reported as the first entry's mismatch.
+    if (js->type == EASYJSONPARSER_SCHEMA_END) {
+      if (f.entries->type == EASYJSONPARSER_SCHEMA_END) {
+        int retval = easyjsonparser_scan_skip(&cur_);
+        return retval == EASYJSONPARSER_SUCCESS ? EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND : retval;
+      }
+      return easyjsonparser_scan_mismatch(&cur_, f.entries, f.stack);
+    }
+
+    return value(ev, js, f.stack, std::string_view());
+  }
+
+  /// Pull the value at the cursor for the schema entry \p js (any value if
+  /// nullptr), its stack being \p stack and its key \p key. Maps and lists
+  /// are pushed onto the frame stack, to be entered by the next step
+  /// unless skipped. Returns \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND if
+  /// the value is the wrong type and the error quashed.
+
+  int value (event & ev, easyjsonparser_schema * js, easyjsonparser_stack * stack, std::string_view key)
+  {
+    easyjsonparser_schema entry = { nullptr, EASYJSONPARSER_SCHEMA_END, nullptr, nullptr };
+    if (js != nullptr) {
+      entry = *js;
+      entry.type &= EASYJSONPARSER_SCHEMA_TYPE_BITS | EASYJSONPARSER_SCHEMA_ARR | EASYJSONPARSER_SCHEMA_IGN;
+    } else if ((entry.type = easyjsonparser_cursor_type(&cur_)) == EASYJSONPARSER_SCHEMA_END) {
+      // Not a value, let skipping it report the syntax error.
+      return easyjsonparser_scan_skip(&cur_);
+    }
+
+    ev        = event();
+    ev.key    = key;
+    ev.schema = js;
+    ev.stack  = stack;
+
+    int type = entry.type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+    int retval;
+
+    if (type == EASYJSONPARSER_SCHEMA_MAP || type == EASYJSONPARSER_SCHEMA_LST || (entry.type & EASYJSONPARSER_SCHEMA_ARR))
+      return open(ev, js, entry, stack, key);
+
+    if (type == EASYJSONPARSER_SCHEMA_STR) {
+      char * val;
+      std::size_t len;
+      if ((retval = easyjsonparser_scan_str(&cur_, &entry, stack, &val, &len)) == EASYJSONPARSER_SUCCESS) {
+        ev.type = event_type::str;
+        ev.str  = std::string_view(val, len);
+      }
+    } else if (type == EASYJSONPARSER_SCHEMA_INT || type == EASYJSONPARSER_SCHEMA_I64) {
+      if ((retval = easyjsonparser_scan_int(&cur_, &entry, stack, &ev.integer)) == EASYJSONPARSER_SUCCESS) {
+        ev.type = event_type::integer;
+        if (type == EASYJSONPARSER_SCHEMA_INT && js != nullptr)
+          ev.integer = ev.integer > INT_MAX ? INT_MAX : ev.integer < INT_MIN ? INT_MIN : ev.integer;
+      }
+    } else if (type == EASYJSONPARSER_SCHEMA_DBL) {
+      if ((retval = easyjsonparser_scan_double(&cur_, &entry, stack, &ev.dbl)) == EASYJSONPARSER_SUCCESS)
+        ev.type = event_type::dbl;
+    } else if (type == EASYJSONPARSER_SCHEMA_BOO) {
+      int val;
+      if ((retval = easyjsonparser_scan_bool(&cur_, &entry, stack, &val)) == EASYJSONPARSER_SUCCESS) {
+        ev.type    = event_type::boolean;
+        ev.boolean = val != 0;
+      }
+    } else {
+      if ((retval = easyjsonparser_scan_null(&cur_, &entry, stack)) == EASYJSONPARSER_SUCCESS)
+        ev.type = event_type::null;
+    }
+
+    return retval;
+  }
+
+  /// Push the map or list at the cursor for the schema entry \p js (or
+  /// any, as \p entry, the copy of \p js to report errors with) onto the
+  /// frame stack, setting \p ev to its begin event. If it is the wrong
+  /// type, entering it reports that (skipping it if the error is quashed),
+  /// and it may be no deeper than the context's nesting limit.
+
+  int open (event & ev, easyjsonparser_schema * js, easyjsonparser_schema & entry, easyjsonparser_stack * stack, std::string_view key)
+  {
+    bool arr = (entry.type & EASYJSONPARSER_SCHEMA_ARR) != 0;
+    int type = arr ? EASYJSONPARSER_SCHEMA_LST : entry.type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+
+    if (easyjsonparser_cursor_type(&cur_) != type)
+      return easyjsonparser_scan_enter(&cur_, &entry, stack);
+
+    int retval = easyjsonparser_scan_depth(&cur_, frames_.size() + 1);
+    if (retval != EASYJSONPARSER_SUCCESS)
+      return retval;
+
+    frame & f = frames_.emplace_back();
+    f.type        = type;
+    f.arr         = arr;
+    f.js          = js;
+    f.entries     = nullptr;
+    f.key         = key;
+    f.stack       = stack;
+    f.member.key  = nullptr;
+    f.member.prev = stack;
+    f.member.ctx  = root_stack_.ctx;
+
+    if (arr) {
+      f.elem = entry;
+      f.elem.type &= EASYJSONPARSER_SCHEMA_TYPE_BITS;
+    } else if (js != nullptr) {
+      f.entries = (easyjsonparser_schema *) entry.data;
+      if (type == EASYJSONPARSER_SCHEMA_MAP) {
+        f.varkeys = f.entries[0].type != EASYJSONPARSER_SCHEMA_END && f.entries[1].type == EASYJSONPARSER_SCHEMA_END && f.entries[0].key == nullptr;
+        f.lenient = lenient_ || (entry.type & EASYJSONPARSER_SCHEMA_IGN);
+      }
+    }
+
+    ev.type = type == EASYJSONPARSER_SCHEMA_MAP ? event_type::map_begin : event_type::list_begin;
+
+    return EASYJSONPARSER_SUCCESS;
+  }
+
+  /// Pop the map or list of the top frame, its end having been scanned,
+  /// setting \p ev to its end event.
+
+  int close (event & ev)
+  {
+    frame & f = frames_.back();
+
+    ev        = event();
+    ev.type   = f.type == EASYJSONPARSER_SCHEMA_MAP ? event_type::map_end : event_type::list_end;
+    ev.key    = f.key;
+    ev.schema = f.js;
+    ev.stack  = f.stack;
+
+    frames_.pop_back();
+
+    return EASYJSONPARSER_SUCCESS;
+  }
+
+  easyjsonparser_ctx *     own_ctx_ = nullptr;
+  easyjsonparser_cursor    cur_;
+  easyjsonparser_stack     root_stack_;
+  easyjsonparser_schema    root_js_;
+  std::deque<frame>        frames_;
+  bool                     schema_  = false;
+  bool                     lenient_ = false;
+  bool                     started_ = false;
+  bool                     done_    = false;
+  int                      result_  = EASYJSONPARSER_SUCCESS;
+};
+
+
+/// Return a pull parser for \p input (which must outlive it), with the
+/// context \p ctx or one of the process wide settings, checking it against
+/// the schema \p js if it is not nullptr.
+
+inline pull_parser events (easyjsonparser_ctx * ctx, std::string_view input, easyjsonparser_schema * js = nullptr)
+{
+  return pull_parser(ctx, input.data(), input.size(), js);
+}
+
+inline pull_parser events (std::string_view input, easyjsonparser_schema * js = nullptr)
+{
+  return pull_parser(input.data(), input.size(), js);
+}
+
+
+} // namespace ejp
+
+
+#endif // EASYJSONPARSER_HPP_INCLUDED
@@ -0,0 +1,211 @@
+/// \file
+/// \brief Bump pointer arena.
+///
+/// An arena is a list of chunks, allocations being carved off the front of
+/// the newest chunk until it runs out, when a chunk twice the size is added
+/// (up to a limit). Nothing is freed individually, the whole arena is reset
+/// or freed in one go.
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "easyjsonparser_internal.h"
+
+
+/// Size of the first chunk, and the largest a chunk grows to (allocations
+/// bigger than this get a chunk of their own).
+
+#define ARENA_CHUNK_MIN 4096
+#define ARENA_CHUNK_MAX (1024 * 1024)
+
+/// Alignment of the blocks returned by \ref easyjsonparser_arena_alloc.
+
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+
+/// A chunk, the usable memory following the header.
+
+typedef struct arena_chunk_st {
+  struct arena_chunk_st * prev;
+  size_t                  size;
+} arena_chunk;
+
+/// Size of the chunk header, rounded up so the memory following it is
+/// suitably aligned for anything.
+
+#define ARENA_CHUNK_HDR ((sizeof(arena_chunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/// Arena, see \ref easyjsonparser_arena_new.
+
+struct easyjsonparser_arena_st {
+  arena_chunk * head;
+  char *        p;
+  char *        end;
+  size_t        next_size;
+};
+
+
+/// Local function declarations.
+
+static void * arena_bump (easyjsonparser_arena * arena, size_t size, size_t align);
+static void * arena_bump_slow (easyjsonparser_arena * arena, size_t size);
+
+
+/// Create an arena. No memory is allocated for blocks until the first is
+/// asked for.
+
+easyjsonparser_arena * easyjsonparser_arena_new (void)
+{
+  easyjsonparser_arena * arena = (easyjsonparser_arena *) malloc(sizeof(easyjsonparser_arena));
+  if (arena == NULL)
+    return NULL;
+
+  arena->head      = NULL;
+  arena->p         = NULL;
+  arena->end       = NULL;
+  arena->next_size = ARENA_CHUNK_MIN;
+
+  return arena;
+}
+
+
+/// Free an arena and every block allocated from it.
+
+void easyjsonparser_arena_free (easyjsonparser_arena * arena)
+{
+  if (arena == NULL)
+    return;
+
+  while (arena->head != NULL) {
+    arena_chunk * prev = arena->head->prev;
+    free(arena->head);
+    arena->head = prev;
+  }
+
+  free(arena);
+}
+
+
+/// Reset an arena, invalidating every block allocated from it but keeping
+/// the newest (largest) chunk for reuse, so that an arena reset between
+/// parses of similar documents soon stops allocating at all.
+
+void easyjsonparser_arena_reset (easyjsonparser_arena * arena)
+{
+  if (arena->head == NULL)
+    return;
+
+  arena_chunk * chunk = arena->head->prev;
+  while (chunk != NULL) {
+    arena_chunk * prev = chunk->prev;
+    free(chunk);
+    chunk = prev;
+  }
+
+  arena->head->prev = NULL;
+  arena->p          = (char *) arena->head + ARENA_CHUNK_HDR;
+  arena->end        = arena->p + arena->head->size;
+}
+
+
+/// Allocate \p size bytes from the arena, aligned for anything, or return
+/// NULL if out of memory.
+
+void * easyjsonparser_arena_alloc (easyjsonparser_arena * arena, size_t size)
+{
+  return arena_bump(arena, size, ARENA_ALIGN);
+}
+
+
+/// Copy \p len bytes of \p str into the arena, adding a terminating zero
+/// byte, or return NULL if out of memory.
+
+char * easyjsonparser_arena_strndup (easyjsonparser_arena * arena, const char * str, size_t len)
+{
+  char * copy = (char *) arena_bump(arena, len + 1, 1);
+  if (copy == NULL)
+    return NULL;
+
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+
+  return copy;
+}
+
+
+/// Copy the zero byte terminated \p str into the arena, or return NULL if
+/// out of memory.
+
+char * easyjsonparser_arena_strdup (easyjsonparser_arena * arena, const char * str)
+{
+  return easyjsonparser_arena_strndup(arena, str, strlen(str));
+}
+
+
+/// Carve \p size bytes aligned to \p align (a power of two) off the newest
+/// chunk, adding a chunk if it is too small.
+
+static inline void * arena_bump (easyjsonparser_arena * arena, size_t size, size_t align)
+{
+  char * p = (char *) (((uintptr_t) arena->p + align - 1) & ~(uintptr_t) (align - 1));
+
+  if (arena->p == NULL || p > arena->end || size > (size_t) (arena->end - p))
+    return arena_bump_slow(arena, size);
+
+  arena->p = p + size;
+  return p;
+}
+
+
+/// Allocate a chunk for a \p size byte block which did not fit in the
+/// newest chunk. A block bigger than chunks grow to gets a chunk of its own,
+/// slotted in behind the newest so the space left in that is not lost.
+
+void * arena_bump_slow (easyjsonparser_arena * arena, size_t size)
+{
+  if (size > SIZE_MAX - ARENA_CHUNK_HDR - ARENA_ALIGN)
+    return NULL;
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  if (size > ARENA_CHUNK_MAX) {
+    arena_chunk * chunk = (arena_chunk *) malloc(ARENA_CHUNK_HDR + size);
+    if (chunk == NULL)
+      return NULL;
+
+    chunk->size = size;
+    if (arena->head != NULL) {
+      chunk->prev       = arena->head->prev;
+      arena->head->prev = chunk;
+    } else {
+      chunk->prev = NULL;
+      arena->head = chunk;
+      arena->p    = arena->end = (char *) chunk + ARENA_CHUNK_HDR + size;
+    }
+
+    return (char *) chunk + ARENA_CHUNK_HDR;
+  }
+
+  size_t chunk_size = arena->next_size;
+  while (chunk_size < size)
+    chunk_size *= 2;
+
+  arena_chunk * chunk = (arena_chunk *) malloc(ARENA_CHUNK_HDR + chunk_size);
+  if (chunk == NULL)
+    return NULL;
+
+  chunk->prev = arena->head;
+  chunk->size = chunk_size;
+  arena->head = chunk;
+  arena->p    = (char *) chunk + ARENA_CHUNK_HDR;
+  arena->end  = arena->p + chunk_size;
+
+  if (chunk_size < ARENA_CHUNK_MAX)
+    arena->next_size = chunk_size * 2;
+
+  char * p = arena->p;
+  arena->p += size;
+  return p;
+}
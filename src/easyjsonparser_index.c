@@ -0,0 +1,324 @@
+/// \file
+/// \brief Structural index for the native backend.
+///
+/// Before the native walker looks at a large input, the input is indexed a
+/// window at a time, 64 byte blocks being classified with SIMD compares
+/// into bitmasks of quotes, backslashes, control characters and structural
+/// characters. Escaped
+/// quotes are then removed, the quotes turned into a mask of the bytes
+/// inside strings (by a prefix XOR), and the positions of the structural
+/// characters outside strings, and of the quotes delimiting strings, are
+/// written to the index. The walker takes the end of each string from the
+/// index, so never looks at the bytes inside a string, unless they must be
+/// unescaped (or include raw control characters, which are an error).
+///
+/// The best instruction set the CPU supports is chosen at run time, AVX2
+/// where the compiler can build it (see configure.ac), SSE2 on any x86-64,
+/// or else plain C.
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+
+#if defined(HAVE_AVX2_DISPATCH) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "easyjsonparser_internal.h"
+
+
+/// Local function declarations.
+
+static void   index_window_scalar (ejp_index * ix);
+#ifdef __SSE2__
+static void   index_window_sse2 (ejp_index * ix);
+#endif
+#ifdef HAVE_AVX2_DISPATCH
+static void   index_window_avx2 (ejp_index * ix);
+#endif
+
+
+/// Set up the structural index \p ix for the \p len bytes of input at
+/// \p buf, returning 1 if the input is to be indexed, or 0 if not, because
+/// it is too small to be worth it or the index could not be allocated.
+
+int ejp_index_init (easyjsonparser_ctx * ctx, ejp_index * ix, const char * buf, size_t len)
+{
+  ix->pos = 0;
+
+  if (len < ctx->index_min)
+    return 0;
+
+  if (ctx->index_entries == NULL
+      && (ctx->index_entries = (uint32_t *) malloc(EJP_INDEX_WINDOW * sizeof(uint32_t))) == NULL)
+    return 0;
+
+  ix->end     = buf + len;
+  ix->entries = ctx->index_entries;
+  ejp_index_seek(ix, buf);
+
+  ix->scan = index_window_scalar;
+#ifdef __SSE2__
+  if (ctx->isa >= EJP_ISA_SSE2)
+    ix->scan = index_window_sse2;
+#endif
+#ifdef HAVE_AVX2_DISPATCH
+  if (ctx->isa >= EJP_ISA_AVX2 && __builtin_cpu_supports("avx2"))
+    ix->scan = index_window_avx2;
+#endif
+
+  return 1;
+}
+
+
+/// Discard the index and start it again from \p p, which must be outside
+/// any string.
+
+void ejp_index_seek (ejp_index * ix, const char * p)
+{
+  ix->base      = p;
+  ix->next      = p;
+  ix->len       = 0;
+  ix->pos       = 0;
+  ix->in_string = 0;
+  ix->bs_carry  = 0;
+  ix->seen_odd  = 0;
+}
+
+
+/// Index the next window of the input (or windows, while they have nothing
+/// in them), returning 0 if the end of the input has been reached.
+
+int ejp_index_refill (ejp_index * ix)
+{
+  while (ix->next < ix->end) {
+    ix->scan(ix);
+    if (ix->len > 0)
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/// Return \p x with each bit the XOR of itself and all the bits below it,
+/// which for a mask of quotes is a mask of the bytes inside strings
+/// (including the opening quote but not the closing one).
+
+static inline uint64_t index_prefix_xor (uint64_t x)
+{
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+
+  return x;
+}
+
+
+/// Append the index entries for one 64 byte block at \p offset in the
+/// window, given its masks of quotes, backslashes, control characters and
+/// structural characters, returning the new end of the entries.
+
+static inline uint32_t * index_block (ejp_index * ix, uint32_t * out, uint32_t offset, uint64_t quote, uint64_t bs, uint64_t ctrl, uint64_t op)
+{
+  // A backslash escapes the next byte unless it is itself escaped, which
+  // is worked through one backslash at a time as they are rare.
+  uint64_t escaped = 0;
+  if (bs != 0 || ix->bs_carry) {
+    uint64_t m = bs;
+    if (ix->bs_carry) {
+      escaped = 1;
+      m &= ~(uint64_t) 1;
+    }
+    ix->bs_carry = 0;
+    while (m != 0) {
+      int i = __builtin_ctzll(m);
+      if (i == 63) {
+        ix->bs_carry = 1;
+        break;
+      }
+      escaped |= (uint64_t) 2 << i;
+      m &= ~((uint64_t) 3 << i);
+    }
+  }
+
+  quote &= ~escaped;
+  uint64_t inside = index_prefix_xor(quote) ^ ix->in_string;
+  ix->in_string   = (uint64_t) ((int64_t) inside >> 63);
+
+  uint64_t marks = (op & ~inside) | quote | ((bs | ctrl) & inside);
+  while (marks != 0) {
+    int i = __builtin_ctzll(marks);
+    uint64_t bit = (uint64_t) 1 << i;
+    marks &= marks - 1;
+
+    if (quote & bit) {
+      if (inside & bit) {
+        ix->seen_odd = 0;
+        *out++ = offset + i;
+      } else {
+        *out++ = (offset + i) | (ix->seen_odd ? EJP_INDEX_ESCAPED : 0);
+      }
+    } else if (op & bit) {
+      *out++ = offset + i;
+    } else {
+      ix->seen_odd = 1;
+    }
+  }
+
+  return out;
+}
+
+
+/// Index the next window of the input, classifying each 64 byte block with
+/// \p classify. The last block of the input is classified from a copy
+/// padded out with spaces.
+
+__attribute__((always_inline))
+static inline void index_window (ejp_index * ix, void (*classify)(const char *, uint64_t *, uint64_t *, uint64_t *, uint64_t *))
+{
+  const char * base = ix->next;
+  size_t       n    = (size_t) (ix->end - base) < EJP_INDEX_WINDOW ? (size_t) (ix->end - base) : EJP_INDEX_WINDOW;
+  uint32_t *   out  = ix->entries;
+  uint64_t     quote, bs, ctrl, op;
+
+  size_t offset = 0;
+  for (; offset + 64 <= n; offset += 64) {
+    classify(base + offset, &quote, &bs, &ctrl, &op);
+    out = index_block(ix, out, offset, quote, bs, ctrl, op);
+  }
+  if (offset < n) {
+    char tail[64];
+    memset(tail, ' ', sizeof(tail));
+    memcpy(tail, base + offset, n - offset);
+    classify(tail, &quote, &bs, &ctrl, &op);
+    out = index_block(ix, out, offset, quote, bs, ctrl, op);
+  }
+
+  ix->base = base;
+  ix->next = base + n;
+  ix->len  = out - ix->entries;
+  ix->pos  = 0;
+}
+
+
+/// Classify 64 bytes at \p p, a byte at a time.
+
+static inline void index_classify_scalar (const char * p, uint64_t * quote, uint64_t * bs, uint64_t * ctrl, uint64_t * op)
+{
+  uint64_t q = 0, b = 0, k = 0, o = 0;
+
+  for (int i = 0; i < 64; i++) {
+    char c = p[i];
+    q |= (uint64_t) (c == '"') << i;
+    b |= (uint64_t) (c == '\\') << i;
+    k |= (uint64_t) ((unsigned char) c < 0x20) << i;
+    o |= (uint64_t) (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') << i;
+  }
+
+  *quote = q;
+  *bs    = b;
+  *ctrl  = k;
+  *op    = o;
+}
+
+void index_window_scalar (ejp_index * ix)
+{
+  index_window(ix, index_classify_scalar);
+}
+
+
+#ifdef __SSE2__
+
+/// Classify 64 bytes at \p p, 16 at a time. Setting bit 5 of each byte
+/// turns '[' and ']' into '{' and '}', and nothing else into either, and
+/// a byte is a control character if capping it at 0x1f leaves it alone.
+
+static inline void index_classify_sse2 (const char * p, uint64_t * quote, uint64_t * bs, uint64_t * ctrl, uint64_t * op)
+{
+  const __m128i c_quote = _mm_set1_epi8('"');
+  const __m128i c_bs    = _mm_set1_epi8('\\');
+  const __m128i c_open  = _mm_set1_epi8('{');
+  const __m128i c_close = _mm_set1_epi8('}');
+  const __m128i c_colon = _mm_set1_epi8(':');
+  const __m128i c_comma = _mm_set1_epi8(',');
+  const __m128i c_bit5  = _mm_set1_epi8(0x20);
+  const __m128i c_ctrl  = _mm_set1_epi8(0x1f);
+
+  uint64_t q = 0, b = 0, k = 0, o = 0;
+
+  for (int i = 0; i < 4; i++) {
+    __m128i v  = _mm_loadu_si128((const __m128i *) (p + i * 16));
+    __m128i v5 = _mm_or_si128(v, c_bit5);
+    __m128i vo = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v5, c_open), _mm_cmpeq_epi8(v5, c_close)),
+                              _mm_or_si128(_mm_cmpeq_epi8(v, c_colon), _mm_cmpeq_epi8(v, c_comma)));
+
+    q |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, c_quote)) << (i * 16);
+    b |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, c_bs)) << (i * 16);
+    k |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, c_ctrl), v)) << (i * 16);
+    o |= (uint64_t) (uint16_t) _mm_movemask_epi8(vo) << (i * 16);
+  }
+
+  *quote = q;
+  *bs    = b;
+  *ctrl  = k;
+  *op    = o;
+}
+
+void index_window_sse2 (ejp_index * ix)
+{
+  index_window(ix, index_classify_sse2);
+}
+
+#endif // __SSE2__
+
+
+#ifdef HAVE_AVX2_DISPATCH
+
+/// Classify 64 bytes at \p p, 32 at a time, as \ref index_classify_sse2.
+
+__attribute__((target("avx2")))
+static inline void index_classify_avx2 (const char * p, uint64_t * quote, uint64_t * bs, uint64_t * ctrl, uint64_t * op)
+{
+  const __m256i c_quote = _mm256_set1_epi8('"');
+  const __m256i c_bs    = _mm256_set1_epi8('\\');
+  const __m256i c_open  = _mm256_set1_epi8('{');
+  const __m256i c_close = _mm256_set1_epi8('}');
+  const __m256i c_colon = _mm256_set1_epi8(':');
+  const __m256i c_comma = _mm256_set1_epi8(',');
+  const __m256i c_bit5  = _mm256_set1_epi8(0x20);
+  const __m256i c_ctrl  = _mm256_set1_epi8(0x1f);
+
+  uint64_t q = 0, b = 0, k = 0, o = 0;
+
+  for (int i = 0; i < 2; i++) {
+    __m256i v  = _mm256_loadu_si256((const __m256i *) (p + i * 32));
+    __m256i v5 = _mm256_or_si256(v, c_bit5);
+    __m256i vo = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v5, c_open), _mm256_cmpeq_epi8(v5, c_close)),
+                                 _mm256_or_si256(_mm256_cmpeq_epi8(v, c_colon), _mm256_cmpeq_epi8(v, c_comma)));
+
+    q |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c_quote)) << (i * 32);
+    b |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c_bs)) << (i * 32);
+    k |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(v, c_ctrl), v)) << (i * 32);
+    o |= (uint64_t) (uint32_t) _mm256_movemask_epi8(vo) << (i * 32);
+  }
+
+  *quote = q;
+  *bs    = b;
+  *ctrl  = k;
+  *op    = o;
+}
+
+__attribute__((target("avx2")))
+void index_window_avx2 (ejp_index * ix)
+{
+  index_window(ix, index_classify_avx2);
+}
+
+#endif // HAVE_AVX2_DISPATCH
@@ -0,0 +1,191 @@
+/// \file
+/// \brief String interning.
+///
+/// An intern table maps each distinct string added to it to a single copy
+/// (in an arena, so the copies never move) and to a small integer id, ids
+/// being handed out from zero in the order the strings are first seen. The
+/// lookup is an open addressed hash table of ids, keeping the hash of each
+/// string alongside it so the table can be grown without rehashing.
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "easyjsonparser_internal.h"
+
+
+/// Initial number of hash slots, kept at most half full.
+
+#define INTERN_SLOTS_MIN 64
+
+
+/// An interned string.
+
+typedef struct {
+  const char * str;
+  size_t       len;
+  uint32_t     hash;
+} intern_str;
+
+/// Intern table, see \ref easyjsonparser_intern_new.
+
+struct easyjsonparser_intern_st {
+  easyjsonparser_arena * arena;
+  intern_str *           strs;
+  uint32_t               strs_len;
+  uint32_t               strs_size;
+  uint32_t *             slots;
+  uint32_t               mask;
+};
+
+
+/// Local function declarations.
+
+static int    intern_grow (easyjsonparser_intern * intern);
+
+
+/// Create an intern table, or return NULL if out of memory.
+
+easyjsonparser_intern * easyjsonparser_intern_new (void)
+{
+  easyjsonparser_intern * intern = (easyjsonparser_intern *) malloc(sizeof(easyjsonparser_intern));
+  if (intern == NULL)
+    return NULL;
+
+  intern->arena     = easyjsonparser_arena_new();
+  intern->strs      = NULL;
+  intern->strs_len  = 0;
+  intern->strs_size = 0;
+  intern->slots     = (uint32_t *) calloc(INTERN_SLOTS_MIN, sizeof(uint32_t));
+  intern->mask      = INTERN_SLOTS_MIN - 1;
+
+  if (intern->arena == NULL || intern->slots == NULL) {
+    easyjsonparser_intern_free(intern);
+    return NULL;
+  }
+
+  return intern;
+}
+
+
+/// Free an intern table, and the strings in it.
+
+void easyjsonparser_intern_free (easyjsonparser_intern * intern)
+{
+  if (intern == NULL)
+    return;
+
+  easyjsonparser_arena_free(intern->arena);
+  free(intern->strs);
+  free(intern->slots);
+  free(intern);
+}
+
+
+/// Empty an intern table, invalidating the strings in it and starting the
+/// ids from zero again, but keeping its memory for reuse.
+
+void easyjsonparser_intern_reset (easyjsonparser_intern * intern)
+{
+  if (intern->strs_len == 0)
+    return;
+
+  easyjsonparser_arena_reset(intern->arena);
+  memset(intern->slots, 0, (intern->mask + 1) * sizeof(uint32_t));
+  intern->strs_len = 0;
+}
+
+
+/// Intern \p len bytes of \p str, returning the canonical (zero byte
+/// terminated) copy and setting \p id (if not NULL) to its id, or return
+/// NULL if out of memory.
+
+const char * easyjsonparser_intern_add (easyjsonparser_intern * intern, const char * str, size_t len, uint32_t * id)
+{
+  uint32_t hash = ejp_hash(str, len, 0);
+
+  uint32_t i = hash & intern->mask;
+  for (; intern->slots[i] != 0; i = (i + 1) & intern->mask) {
+    intern_str * is = &intern->strs[intern->slots[i] - 1];
+    if (is->hash == hash && is->len == len && memcmp(is->str, str, len) == 0) {
+      if (id != NULL)
+        *id = intern->slots[i] - 1;
+      return is->str;
+    }
+  }
+
+  // Keep the table at most half full, so probe sequences stay short.
+  if ((intern->strs_len + 1) * 2 > intern->mask + 1) {
+    if (!intern_grow(intern))
+      return NULL;
+    for (i = hash & intern->mask; intern->slots[i] != 0; i = (i + 1) & intern->mask)
+      ;
+  }
+
+  if (intern->strs_len == intern->strs_size) {
+    uint32_t new_size = intern->strs_size ? intern->strs_size * 2 : INTERN_SLOTS_MIN / 2;
+    intern_str * new_strs = (intern_str *) realloc(intern->strs, new_size * sizeof(intern_str));
+    if (new_strs == NULL)
+      return NULL;
+    intern->strs      = new_strs;
+    intern->strs_size = new_size;
+  }
+
+  char * copy = easyjsonparser_arena_strndup(intern->arena, str, len);
+  if (copy == NULL)
+    return NULL;
+
+  intern_str * is = &intern->strs[intern->strs_len];
+  is->str  = copy;
+  is->len  = len;
+  is->hash = hash;
+
+  intern->slots[i] = ++intern->strs_len;
+  if (id != NULL)
+    *id = intern->strs_len - 1;
+
+  return copy;
+}
+
+
+/// Return the interned string with the given \p id, or NULL if there is no
+/// such id.
+
+const char * easyjsonparser_intern_str (easyjsonparser_intern * intern, uint32_t id)
+{
+  return id < intern->strs_len ? intern->strs[id].str : NULL;
+}
+
+
+/// Return the number of strings interned, which is also the next id.
+
+size_t easyjsonparser_intern_count (easyjsonparser_intern * intern)
+{
+  return intern->strs_len;
+}
+
+
+/// Double the number of hash slots.
+
+int intern_grow (easyjsonparser_intern * intern)
+{
+  uint32_t new_mask = intern->mask * 2 + 1;
+  uint32_t * new_slots = (uint32_t *) calloc((size_t) new_mask + 1, sizeof(uint32_t));
+  if (new_slots == NULL)
+    return 0;
+
+  for (uint32_t n = 0; n < intern->strs_len; n++) {
+    uint32_t i = intern->strs[n].hash & new_mask;
+    while (new_slots[i] != 0)
+      i = (i + 1) & new_mask;
+    new_slots[i] = n + 1;
+  }
+
+  free(intern->slots);
+  intern->slots = new_slots;
+  intern->mask  = new_mask;
+
+  return 1;
+}
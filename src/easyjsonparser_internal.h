@@ -0,0 +1,231 @@
+/// \file
+/// \brief Declarations shared between the libeasyjsonparser translation
+/// units, not installed and not exported.
+
+
+#ifndef EASYJSONPARSER_INTERNAL_INCLUDED
+#define EASYJSONPARSER_INTERNAL_INCLUDED
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "easyjsonparser.h"
+
+
+struct json_tokener;
+struct ejp_native_frame;
+
+/// Bytes of input covered by one window of the structural index, a multiple
+/// of the 64 byte block the index is built a block at a time from.
+
+#define EJP_INDEX_WINDOW 65536
+
+/// Maps and lists may be nested this deep, by default.
+
+#define EJP_MAX_DEPTH 1024
+
+/// Inputs shorter than this are not indexed, by default.
+
+#define EJP_INDEX_MIN 65536
+
+/// Flag on the index entry of a closing quote, set if the string contains
+/// backslashes or raw control characters, so must be looked at.
+
+#define EJP_INDEX_ESCAPED 0x80000000u
+
+/// Maps with more schema entries than this are not tracked when stopping
+/// once the schema is complete (see
+/// \ref EASYJSONPARSER_OPTION_STOP_WHEN_COMPLETE), one bit being kept for
+/// each entry.
+
+#define EJP_TRACK_MAX 64
+
+/// Elements of a typed array (see \ref EASYJSONPARSER_INT_ARRAY) converted
+/// into a buffer on the C stack before being handed to the handler.
+
+#define EJP_ARRAY_BATCH 512
+
+/// Size of the buffer \ref ejp_format_int64 and \ref ejp_format_double
+/// format a number into (which is not zero byte terminated).
+
+#define EJP_FORMAT_MAX 32
+
+/// Bytes of JSON buffered when writing to a file descriptor, before being
+/// flushed to it.
+
+#define EJP_WRITE_BUFFER 65536
+
+typedef union ejp_array_batch {
+  int64_t i[EJP_ARRAY_BATCH];
+  double  d[EJP_ARRAY_BATCH];
+} ejp_array_batch;
+
+/// Instruction set used to build the structural index and to validate
+/// UTF-8, the best the CPU supports by default.
+
+#define EJP_ISA_SCALAR 0
+#define EJP_ISA_SSE2   1
+#define EJP_ISA_AVX2   2
+#define EJP_ISA_BEST   3
+
+/// Structural index of the input, see easyjsonparser_index.c. Built a
+/// window at a time, as the parse consumes it.
+
+typedef struct ejp_index_st {
+  const char * base;
+  const char * next;
+  const char * end;
+  uint32_t *   entries;
+  size_t       len;
+  size_t       pos;
+  uint64_t     in_string;
+  int          bs_carry;
+  int          seen_odd;
+  void         (*scan)(struct ejp_index_st *);
+} ejp_index;
+
+/// Validation state of UTF-8 input arriving in pieces, see
+/// \ref ejp_utf8_validate_stream.
+
+typedef struct ejp_utf8_stream_st {
+  unsigned char tail[4];
+  size_t        tail_len;
+  size_t        offset;
+} ejp_utf8_stream;
+
+/// Parser context, see \ref easyjsonparser_ctx_new.
+
+struct easyjsonparser_ctx_st {
+  int                     loglevel;
+  void                    (*logger)(int, const char *);
+  int                     (*errhandler)(int, const void *, const char *, const char *);
+  int                     (*errhandler_lazy)(int, const void *, const char *, easyjsonparser_error *);
+  easyjsonparser_stack *  error_stack;
+  int                     backend;
+  struct json_tokener *   tokener;
+  char *                  scratch;
+  size_t                  scratch_size;
+  char                    stack_path[MAX_STACKPATH_LEN];
+  int                     compiled;
+  int                     lenient;
+  easyjsonparser_arena *  arena;
+  easyjsonparser_arena *  own_arena;
+  easyjsonparser_intern * intern;
+  easyjsonparser_intern * own_intern;
+  uint32_t *              index_entries;
+  size_t                  index_min;
+  int                     isa;
+  int                     options;
+  size_t                  max_depth;
+  struct ejp_native_frame * frames;
+  size_t                  frames_size;
+};
+
+
+/// Log at the trace level, evaluating the arguments and making the call
+/// only if the message would go anywhere, so that walking the document
+/// costs nothing extra when tracing is off.
+
+#define EJP_TRACE(ctx, ...)                                                         \
+  do {                                                                              \
+    if ((ctx)->logger != NULL || (ctx)->loglevel >= EASYJSONPARSER_LOG_LEVEL_TRACE) \
+      ejp_log((ctx), EASYJSONPARSER_LOG_LEVEL_TRACE, __VA_ARGS__);                  \
+  } while (0)
+
+/// The struct field of \p field_type bound by the field schema entry \p js
+/// (see \ref EASYJSONPARSER_INT_FIELD and friends) within \p cfg.
+
+#define EJP_FIELD(cfg, js, field_type) ((field_type *) ((char *) (cfg) + (uintptr_t) (js)->data))
+
+/// True if errors would be neither handled nor logged, in which case the
+/// stack path for an error need not be rendered (the message is never
+/// formatted either, see \ref ejp_error_handler).
+
+#define EJP_ERRORS_SILENT(ctx)                                                 \
+  ((ctx)->errhandler == NULL && (ctx)->errhandler_lazy == NULL &&              \
+   (ctx)->logger == NULL && (ctx)->loglevel < EASYJSONPARSER_LOG_LEVEL_ERROR)
+
+
+extern void ejp_ctx_init (easyjsonparser_ctx * ctx);
+extern void ejp_ctx_release (easyjsonparser_ctx * ctx);
+extern void ejp_log (easyjsonparser_ctx * ctx, int level, const char * fmt, ...);
+extern char * ejp_stack_path (easyjsonparser_ctx * ctx, easyjsonparser_stack * stack);
+extern char * ejp_error_path (easyjsonparser_ctx * ctx, easyjsonparser_stack * stack);
+extern int  ejp_error_handler (easyjsonparser_ctx * ctx, int err_code, const void * data, const char * reason, const char * errmsg_fmt, ...);
+extern int  ejp_store_str_field (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg, const char * val, size_t val_len);
+extern int  ejp_intern_str (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg, const char * val, size_t val_len);
+extern int  ejp_mandate_error (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, easyjsonparser_stack * stack, char * found_type_str);
+extern easyjsonparser_schema * ejp_schema_lookup (easyjsonparser_schema * js, const char * key, size_t key_len);
+extern size_t ejp_schema_key_count (easyjsonparser_schema * js);
+extern int  ejp_schema_accepts (easyjsonparser_schema * js, int type);
+extern int  ejp_utf8_validate (easyjsonparser_ctx * ctx, const char * buf, size_t len, size_t * offset);
+extern int  ejp_utf8_validate_stream (easyjsonparser_ctx * ctx, ejp_utf8_stream * s, const char * buf, size_t len, size_t * offset);
+extern int  ejp_utf8_error (easyjsonparser_ctx * ctx, size_t offset);
+extern void ejp_array_flush (easyjsonparser_schema * js, easyjsonparser_stack * stack, ejp_array_batch * batch, size_t n, size_t offset, void * cfg);
+extern int  ejp_decimal_to_double (uint64_t w, int64_t q, int neg, double * d);
+extern double ejp_strtod (char * str);
+extern size_t ejp_format_int64 (char * buf, int64_t v);
+extern size_t ejp_format_double (char * buf, double d);
+extern int  ejp_native_parse (easyjsonparser_ctx * ctx, const char * buf, size_t len, easyjsonparser_schema * js, void * cfg);
+extern int  ejp_native_check (easyjsonparser_ctx * ctx, const char * buf, size_t len);
+extern int  ejp_index_init (easyjsonparser_ctx * ctx, ejp_index * ix, const char * buf, size_t len);
+extern int  ejp_index_refill (ejp_index * ix);
+extern void ejp_index_seek (ejp_index * ix, const char * p);
+
+
+/// Hash \p len bytes of \p key with \p seed (FNV-1a, seeded), for the key
+/// index of compiled schemas and the intern table.
+
+static inline uint32_t ejp_hash (const char * key, size_t len, uint32_t seed)
+{
+  uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char) key[i];
+    h *= 16777619u;
+  }
+
+  return h ^ (h >> 15);
+}
+
+
+/// Find the schema entry for \p key (\p key_len bytes long) amongst the
+/// fixed key map schema entries \p js, by index if the schema being parsed
+/// is compiled, or NULL if there is none.
+
+static inline easyjsonparser_schema * ejp_schema_find (easyjsonparser_ctx * ctx, easyjsonparser_schema * js, const char * key, size_t key_len)
+{
+  if (ctx->compiled)
+    return ejp_schema_lookup(js, key, key_len);
+
+  for (; js->type != EASYJSONPARSER_SCHEMA_END; js++)
+    if (js->key != NULL && strcmp(js->key, key) == 0)
+      return js;
+
+  return NULL;
+}
+
+
+
+/// Return the position of the next structural character (or string quote)
+/// in the index, setting \p escaped (if not NULL) to say whether a closing
+/// quote ends a string with backslashes in it, or NULL if there are no
+/// more.
+
+static inline const char * ejp_index_next (ejp_index * ix, int * escaped)
+{
+  if (ix->pos == ix->len && !ejp_index_refill(ix))
+    return NULL;
+
+  uint32_t entry = ix->entries[ix->pos++];
+  if (escaped != NULL)
+    *escaped = (entry & EJP_INDEX_ESCAPED) != 0;
+
+  return ix->base + (entry & ~EJP_INDEX_ESCAPED);
+}
+
+
+#endif // EASYJSONPARSER_INTERNAL_INCLUDED
@@ -0,0 +1,2358 @@
+/// \file
+/// \brief Native single pass parser backend.
+///
+/// The input bytes are tokenized while the schema is walked, so the typed
+/// callbacks are invoked directly as each value is scanned and no json-c
+/// object tree is ever built. The walk mirrors the json-c backend (see
+/// rec_parse and friends in easyjsonparser.c) so that the callbacks, the
+/// stack and the errors reported are the same whichever backend is used,
+/// though maps and lists are kept on an explicit stack of frames rather
+/// than recursed into, so how deep they may be nested is bounded by the
+/// context and not by the C stack.
+///
+/// The same tokenizer also drives cursors (see
+/// \ref easyjsonparser_cursor_init), which parse only the values they are
+/// asked for, stepping over everything else by matching brackets and quotes.
+/// And it drives the scan functions (see \ref easyjsonparser_scan_init),
+/// which parse the input in order for parsers generated by ejp-codegen,
+/// the generated code doing what the walk does with the schema.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+
+#include "config.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "easyjsonparser_internal.h"
+
+
+/// Keys up to this length are held on the C stack while their value is
+/// parsed, longer keys are copied to the heap.
+
+#define NATIVE_KEYBUF_LEN 64
+
+/// Frames the frame stack starts with, doubling as it needs more.
+
+#define NATIVE_FRAMES_MIN 32
+
+/// Maps and lists skipped over are remembered on the C stack up to this
+/// many words of 64 levels, beyond that on the heap.
+
+#define NATIVE_SKIP_WORDS 16
+
+/// Numbers up to this length are converted from a copy on the C stack.
+
+#define NATIVE_NUMBUF_LEN 64
+
+/// Bytes of input validated as UTF-8 at a time, when the input is
+/// validated as it is parsed rather than up front.
+
+#define NATIVE_VALIDATE_AHEAD 65536
+
+
+/// Parse state, the input being scanned and the context, which holds the
+/// scratch buffer into which strings are unescaped and zero byte terminated
+/// for the callbacks. If the input is large enough to be indexed, \p ix is
+/// the structural index (see easyjsonparser_index.c), and \p indexed is
+/// set for as long as the walk and the index agree. The input up to
+/// \p valid_end is known to be UTF-8. When stopping once the schema is
+/// complete, \p pending counts the schema entries not yet seen, \p track
+/// is set if the value about to be parsed is one of them, and \p done is
+/// set once there are none left. The maps and lists being parsed are the
+/// bottom \p depth frames of the context's frame stack, the root value's
+/// stack being \p root.
+
+typedef struct {
+  easyjsonparser_ctx *   ctx;
+  const char *           buf;
+  const char *           p;
+  const char *           end;
+  const char *           valid_end;
+  int                    indexed;
+  ejp_index              ix;
+  size_t                 pending;
+  int                    track;
+  int                    done;
+  easyjsonparser_stack * root;
+  size_t                 depth;
+} native_state;
+
+/// What a frame is parsing.
+
+enum {
+  NATIVE_FRAME_MAP,
+  NATIVE_FRAME_LIST
+};
+
+/// A map or list being parsed, one level of the explicit stack kept in
+/// place of recursion (see \ref native_walk). Its children are the schema
+/// entries \p js, and its stack is \p stack. A map's current key is held
+/// in \p member (the stack of its value), in \p keybuf if short enough or
+/// else on the heap (\p key_heap set), its other fields being as for
+/// \ref native_open. \p started is set once the first key or element has
+/// been reached.
+
+typedef struct ejp_native_frame {
+  int                     kind;
+  int                     started;
+  easyjsonparser_schema * js;
+  easyjsonparser_stack *  stack;
+  easyjsonparser_stack    member;
+  int                     varkeys;
+  int                     lenient;
+  int                     track;
+  size_t                  keys;
+  uint64_t                seen;
+  int                     key_heap;
+  char                    keybuf[NATIVE_KEYBUF_LEN];
+} native_frame;
+
+/// The JSON types the tokenizer distinguishes between.
+
+typedef enum {
+  NATIVE_TYPE_OBJECT,
+  NATIVE_TYPE_ARRAY,
+  NATIVE_TYPE_STRING,
+  NATIVE_TYPE_INT,
+  NATIVE_TYPE_DOUBLE,
+  NATIVE_TYPE_BOOLEAN,
+  NATIVE_TYPE_NULL,
+  NATIVE_TYPE_INVALID
+} native_type;
+
+
+/// Local function declarations.
+
+static int    native_walk (native_state * st, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
+static int    native_parse_value (native_state * st, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
+static int    native_open (native_state * st, int kind, easyjsonparser_schema * js, easyjsonparser_stack * stack, int lenient, int track);
+static int    native_push (native_state * st, native_frame ** f);
+static void   native_link (native_state * st, native_frame * f, size_t depth);
+static int    native_step_map (native_state * st, native_frame * f, void * cfg);
+static int    native_step_list (native_state * st, native_frame * f, void * cfg);
+static int    native_parse_array (native_state * st, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
+static int    native_skip_value (native_state * st);
+static int    native_skip_key (native_state * st);
+static int    native_skip_string (native_state * st);
+static int    native_string_error (native_state * st, const char * q);
+static int    native_skip_number (native_state * st);
+static int    native_scan_string (native_state * st, char ** val, size_t * val_len, int * in_input);
+static int    native_scan_number (native_state * st, native_type type, int64_t * ival, double * dval);
+static int    native_scan_literal (native_state * st, const char * literal);
+static native_type native_peek_type (native_state * st);
+static char * native_type_to_str (native_type type);
+static int    native_type_to_schema (native_type type);
+static int    native_keyed_alt (native_state * st, const char * p, easyjsonparser_schema * js, easyjsonparser_schema * last, easyjsonparser_schema ** alt);
+static int    native_syntax_error (native_state * st, const char * expected);
+static int    native_validate (native_state * st, const char * p);
+
+
+/// Parse \p len bytes of JSON at \p buf. Called from
+/// \ref easyjsonparser_parse_buffer when the native backend is selected.
+/// With \ref EASYJSONPARSER_OPTION_STOP_WHEN_COMPLETE and a compiled
+/// schema, the parse stops as soon as every entry of every fixed key map
+/// in the schema has been seen, and the rest of the input is not read.
+
+int ejp_native_parse (easyjsonparser_ctx * ctx, const char * buf, size_t len, easyjsonparser_schema * js, void * cfg)
+{
+  EJP_TRACE(ctx, "JSON root processing");
+
+  ctx->compiled = (js->type & EASYJSONPARSER_SCHEMA_CMP) != 0;
+  ctx->lenient  = (js->type & EASYJSONPARSER_SCHEMA_IGN) != 0;
+
+  native_state st;
+  st.ctx = ctx;
+  st.buf = buf;
+  st.p   = buf;
+  st.end = buf + len;
+
+  st.indexed = ejp_index_init(ctx, &st.ix, buf, len);
+
+  // Stopping early, the input is validated as it is parsed, not up front.
+  int stop = (ctx->options & EASYJSONPARSER_OPTION_STOP_WHEN_COMPLETE) != 0;
+  st.valid_end = stop && !(ctx->options & EASYJSONPARSER_OPTION_TRUSTED_INPUT) ? buf : st.end;
+  st.pending   = 1;
+  st.track     = stop && ctx->compiled;
+  st.done      = 0;
+
+  easyjsonparser_stack stack;
+  stack.key  = NULL;
+  stack.prev = NULL;
+  stack.ctx  = ctx;
+
+  easyjsonparser_schema root = *js;
+  root.type &= EASYJSONPARSER_SCHEMA_TYPE_BITS;
+  root.data  = js + 1;
+
+  int retval = root.type == EASYJSONPARSER_SCHEMA_MAP || root.type == EASYJSONPARSER_SCHEMA_LST
+    ? native_walk(&st, &root, &stack, cfg)
+    : native_walk(&st, js, &stack, cfg);
+
+  if (retval == EASYJSONPARSER_SUCCESS && st.done) {
+    EJP_TRACE(ctx, "JSON schema complete at offset %zu", (size_t) (st.p - buf));
+  } else if (retval == EASYJSONPARSER_SUCCESS) {
+    while (st.p < st.end && (*st.p == ' ' || *st.p == '\t' || *st.p == '\n' || *st.p == '\r'))
+      st.p++;
+    if (st.p != st.end)
+      retval = native_syntax_error(&st, "end of input");
+  }
+
+  if (retval == EASYJSONPARSER_SUCCESS && st.p > st.valid_end)
+    retval = native_validate(&st, st.p);
+
+  return retval;
+}
+
+
+/// Check the syntax of the JSON value at the start of the \p len bytes at
+/// \p buf, as the native backend would parse it but calling nothing,
+/// returning what the error handler returns for the first error, if any.
+/// Used by the json-c backend, once json-c has accepted the input, to
+/// reject what json-c lets through but the native backend does not (raw
+/// control characters in strings, NaN and so on), so that the backends
+/// agree on what is JSON. The input must already be valid UTF-8.
+
+int ejp_native_check (easyjsonparser_ctx * ctx, const char * buf, size_t len)
+{
+  native_state st;
+  st.ctx       = ctx;
+  st.buf       = buf;
+  st.p         = buf;
+  st.end       = buf + len;
+  st.valid_end = st.end;
+  st.indexed   = ejp_index_init(ctx, &st.ix, buf, len);
+  st.pending   = 0;
+  st.track     = 0;
+  st.done      = 0;
+  st.root      = NULL;
+  st.depth     = 0;
+
+  return native_skip_value(&st);
+}
+
+
+/// Skip any whitespace at the current position.
+
+static inline void native_skip_ws (native_state * st)
+{
+  while (st->p < st->end && (*st->p == ' ' || *st->p == '\t' || *st->p == '\n' || *st->p == '\r'))
+    st->p++;
+}
+
+
+/// Step over the structural character at the current position, keeping the
+/// structural index in step (or giving up on it if it is not).
+
+static inline void native_advance (native_state * st)
+{
+  if (st->indexed && ejp_index_next(&st->ix, NULL) != st->p)
+    st->indexed = 0;
+
+  st->p++;
+}
+
+
+/// Count \p n more of the pending schema entries as seen, the value at
+/// \p stack having been parsed, and if that was the last of them, finish
+/// the parse. The end of the root value finishes the parse anyway, and the
+/// rest of the input is checked as usual.
+
+static inline void native_complete (native_state * st, easyjsonparser_stack * stack, size_t n)
+{
+  if (n > 0 && (st->pending -= n) == 0 && stack->prev != NULL)
+    st->done = 1;
+}
+
+
+/// Report a map or list nested deeper than the context allows, at the
+/// current position.
+
+static int native_depth_error (native_state * st)
+{
+  size_t offset = st->p - st->buf;
+
+  return ejp_error_handler(st->ctx, EASYJSONPARSER_ERROR_PARSE_DEPTH, &offset,
+                           "nesting too deep",
+                           "could not parse JSON (nested more than %zu deep at offset %zu)",
+                           st->ctx->max_depth, offset);
+}
+
+
+/// Parse the JSON document against the schema entry \p js, the stack of
+/// the root value being \p stack. This is the equivalent of rec_parse and
+/// friends, but rather than recursing for each map and list it keeps them
+/// on an explicit stack of frames, so that how deep the input may be
+/// nested is up to the context (see \ref easyjsonparser_ctx_set_max_depth)
+/// and not the C stack. Each turn of the loop takes the next step in the
+/// innermost map or list, parsing the next key and value, or the next
+/// element, or closing it.
+
+int native_walk (native_state * st, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+{
+  st->root  = stack;
+  st->depth = 0;
+
+  int retval = native_parse_value(st, js, stack, cfg);
+
+  while (retval == EASYJSONPARSER_SUCCESS && st->depth > 0 && !st->done) {
+    native_frame * f = &st->ctx->frames[st->depth - 1];
+    retval = f->kind == NATIVE_FRAME_MAP
+      ? native_step_map(st, f, cfg)
+      : native_step_list(st, f, cfg);
+  }
+
+  // Frames are left behind by errors, and by stopping early.
+  for (; st->depth > 0; st->depth--) {
+    native_frame * f = &st->ctx->frames[st->depth - 1];
+    if (f->key_heap)
+      free(f->member.key);
+  }
+
+  return retval;
+}
+
+
+/// Return what \ref native_parse_value dispatches on for the schema entry
+/// type \p type, the type itself except that maps ignoring unknown keys
+/// are maps, and typed arrays are all one case.
+
+static inline int native_op (int type)
+{
+  if ((type & ~EASYJSONPARSER_SCHEMA_IGN) == EASYJSONPARSER_SCHEMA_MAP)
+    return EASYJSONPARSER_SCHEMA_MAP;
+  if (type & EASYJSONPARSER_SCHEMA_ARR)
+    return EASYJSONPARSER_SCHEMA_ARR;
+  return type;
+}
+
+
+/// Return the type of value the schema entry type \p op (as returned by
+/// \ref native_op) takes, or \ref NATIVE_TYPE_INVALID if none.
+
+static inline native_type native_op_takes (int op)
+{
+  switch (op) {
+  case EASYJSONPARSER_SCHEMA_STR:
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_VEW:
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_ITN:
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_FLD:
+    return NATIVE_TYPE_STRING;
+  case EASYJSONPARSER_SCHEMA_INT:
+  case EASYJSONPARSER_SCHEMA_I64:
+  case EASYJSONPARSER_SCHEMA_INT | EASYJSONPARSER_SCHEMA_FLD:
+  case EASYJSONPARSER_SCHEMA_I64 | EASYJSONPARSER_SCHEMA_FLD:
+    return NATIVE_TYPE_INT;
+  case EASYJSONPARSER_SCHEMA_DBL:
+  case EASYJSONPARSER_SCHEMA_DBL | EASYJSONPARSER_SCHEMA_FLD:
+    return NATIVE_TYPE_DOUBLE;
+  case EASYJSONPARSER_SCHEMA_BOO:
+  case EASYJSONPARSER_SCHEMA_BOO | EASYJSONPARSER_SCHEMA_FLD:
+    return NATIVE_TYPE_BOOLEAN;
+  case EASYJSONPARSER_SCHEMA_NUL:
+    return NATIVE_TYPE_NULL;
+  case EASYJSONPARSER_SCHEMA_MAP:
+    return NATIVE_TYPE_OBJECT;
+  case EASYJSONPARSER_SCHEMA_LST:
+  case EASYJSONPARSER_SCHEMA_ARR:
+    return NATIVE_TYPE_ARRAY;
+  default:
+    return NATIVE_TYPE_INVALID;
+  }
+}
+
+
+/// Parse the value at the current position against the schema entry
+/// \p js, the value's stack being \p stack. Scalars are parsed, and their
+/// handlers called, there and then. Maps and lists are opened, and unless
+/// empty pushed onto the frame stack for \ref native_walk to parse. There
+/// is no separate instruction stream, the schema entries are executed as
+/// they are, by one switch on the entry type (or the mismatch error, if
+/// the value is not of the type the entry takes).
+
+int native_parse_value (native_state * st, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+{
+  int track = st->track;
+  st->track = 0;
+
+  native_skip_ws(st);
+
+  native_type type = native_peek_type(st);
+  if (type == NATIVE_TYPE_INVALID)
+    return native_syntax_error(st, "a value");
+
+  EJP_TRACE(st->ctx, "JSON scalar processing, found %s", native_type_to_str(type));
+
+  int op = native_op(js->type);
+  int retval = EASYJSONPARSER_SUCCESS;
+  char * str;
+  size_t str_len;
+  int in_input;
+  int64_t ival;
+  double dval;
+  int bval;
+
+  // A value of the wrong type is the default case.
+  switch (native_op_takes(op) == type ? op : EASYJSONPARSER_SCHEMA_END) {
+  case EASYJSONPARSER_SCHEMA_STR:
+    if ((retval = native_scan_string(st, &str, &str_len, NULL)) == EASYJSONPARSER_SUCCESS && js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, char *, void *)) js->data)(stack, str, cfg);
+    break;
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_VEW:
+    if ((retval = native_scan_string(st, &str, &str_len, &in_input)) == EASYJSONPARSER_SUCCESS && js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, const char *, size_t, int, void *)) js->data)(stack, str, str_len, in_input ? EASYJSONPARSER_STRVIEW_INPUT : 0, cfg);
+    break;
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_ITN:
+    if ((retval = native_scan_string(st, &str, &str_len, &in_input)) == EASYJSONPARSER_SUCCESS)
+      retval = ejp_intern_str(st->ctx, js, stack, cfg, str, str_len);
+    break;
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_FLD:
+    if ((retval = native_scan_string(st, &str, &str_len, &in_input)) == EASYJSONPARSER_SUCCESS)
+      retval = ejp_store_str_field(st->ctx, js, stack, cfg, str, str_len);
+    break;
+  case EASYJSONPARSER_SCHEMA_INT:
+    if ((retval = native_scan_number(st, type, &ival, NULL)) == EASYJSONPARSER_SUCCESS && js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, int, void *)) js->data)(stack, ival > INT_MAX ? INT_MAX : ival < INT_MIN ? INT_MIN : (int) ival, cfg);
+    break;
+  case EASYJSONPARSER_SCHEMA_I64:
+    if ((retval = native_scan_number(st, type, &ival, NULL)) == EASYJSONPARSER_SUCCESS && js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, int64_t, void *)) js->data)(stack, ival, cfg);
+    break;
+  case EASYJSONPARSER_SCHEMA_INT | EASYJSONPARSER_SCHEMA_FLD:
+    if ((retval = native_scan_number(st, type, &ival, NULL)) == EASYJSONPARSER_SUCCESS)
+      *EJP_FIELD(cfg, js, int) = ival > INT_MAX ? INT_MAX : ival < INT_MIN ? INT_MIN : (int) ival;
+    break;
+  case EASYJSONPARSER_SCHEMA_I64 | EASYJSONPARSER_SCHEMA_FLD:
+    if ((retval = native_scan_number(st, type, &ival, NULL)) == EASYJSONPARSER_SUCCESS)
+      *EJP_FIELD(cfg, js, int64_t) = ival;
+    break;
+  case EASYJSONPARSER_SCHEMA_DBL:
+    if ((retval = native_scan_number(st, type, NULL, &dval)) == EASYJSONPARSER_SUCCESS && js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, double, void *)) js->data)(stack, dval, cfg);
+    break;
+  case EASYJSONPARSER_SCHEMA_DBL | EASYJSONPARSER_SCHEMA_FLD:
+    if ((retval = native_scan_number(st, type, NULL, &dval)) == EASYJSONPARSER_SUCCESS)
+      *EJP_FIELD(cfg, js, double) = dval;
+    break;
+  case EASYJSONPARSER_SCHEMA_BOO:
+    bval = *st->p == 't';
+    if ((retval = native_scan_literal(st, bval ? "true" : "false")) == EASYJSONPARSER_SUCCESS && js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, int, void *)) js->data)(stack, bval, cfg);
+    break;
+  case EASYJSONPARSER_SCHEMA_BOO | EASYJSONPARSER_SCHEMA_FLD:
+    bval = *st->p == 't';
+    if ((retval = native_scan_literal(st, bval ? "true" : "false")) == EASYJSONPARSER_SUCCESS)
+      *EJP_FIELD(cfg, js, int) = bval;
+    break;
+  case EASYJSONPARSER_SCHEMA_NUL:
+    if ((retval = native_scan_literal(st, "null")) == EASYJSONPARSER_SUCCESS && js->data != NULL)
+      ((void (*)(easyjsonparser_stack *, void *)) js->data)(stack, cfg);
+    break;
+  case EASYJSONPARSER_SCHEMA_MAP:
+    return native_open(st, NATIVE_FRAME_MAP, js->data, stack, st->ctx->lenient || (js->type & EASYJSONPARSER_SCHEMA_IGN), track);
+  case EASYJSONPARSER_SCHEMA_LST:
+    return native_open(st, NATIVE_FRAME_LIST, js->data, stack, 0, track);
+  case EASYJSONPARSER_SCHEMA_ARR:
+    retval = native_parse_array(st, js, stack, cfg);
+    break;
+  default:
+    if ((retval = ejp_mandate_error(st->ctx, js, stack, native_type_to_str(type))) != EASYJSONPARSER_SUCCESS)
+      return retval;
+    retval = native_skip_value(st);
+    break;
+  }
+
+  if (track && retval == EASYJSONPARSER_SUCCESS)
+    native_complete(st, stack, 1);
+
+  return retval;
+}
+
+
+/// Open the map or list (as \p kind) at the current position, the opening
+/// brace or bracket, for the child schema entry array \p js, the value's
+/// stack being \p stack. For maps, if \p lenient is set the values of keys
+/// not in the schema are skipped unseen. If \p track is set the value is
+/// one of the pending schema entries, and (for a map with fixed keys, and
+/// not too many) its keys are pending in its place until seen, or until
+/// the map ends without them. Unless it is empty the map or list is pushed
+/// onto the frame stack.
+
+int native_open (native_state * st, int kind, easyjsonparser_schema * js, easyjsonparser_stack * stack, int lenient, int track)
+{
+  int varkeys = 0;
+  size_t keys = 0;
+
+  if (kind == NATIVE_FRAME_MAP) {
+    varkeys = js[0].type != EASYJSONPARSER_SCHEMA_END && js[1].type == EASYJSONPARSER_SCHEMA_END && js[0].key == NULL;
+
+    EJP_TRACE(st->ctx, "JSON object processing");
+    EJP_TRACE(st->ctx, varkeys
+              ? "JSON variable key object processing"
+              : "JSON fixed key object processing");
+
+    // Seen keys are remembered by schema entry position.
+    keys = track && !varkeys && st->ctx->compiled ? ejp_schema_key_count(js) : 0;
+  } else {
+    EJP_TRACE(st->ctx, "JSON list/array processing");
+  }
+
+  if (st->depth >= st->ctx->max_depth)
+    return native_depth_error(st);
+
+  native_advance(st);
+  native_skip_ws(st);
+  if (st->p < st->end && *st->p == (kind == NATIVE_FRAME_MAP ? '}' : ']')) {
+    native_advance(st);
+    if (track)
+      native_complete(st, stack, 1);
+    return EASYJSONPARSER_SUCCESS;
+  }
+
+  if (keys > 0)
+    st->pending += keys - 1;
+
+  native_frame * f = NULL;
+  int retval = native_push(st, &f);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  f->kind     = kind;
+  f->started  = 0;
+  f->js       = js;
+  f->varkeys  = varkeys;
+  f->lenient  = lenient;
+  f->track    = track;
+  f->keys     = keys;
+  f->seen     = 0;
+  f->key_heap = 0;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Push a frame onto the frame stack, setting \p f to it, its stack (and
+/// that of its current key) linked to those of the frames below. The
+/// frames are kept by the context for the next parse, and when they are
+/// reallocated to make room for more, the stacks are linked up again.
+
+int native_push (native_state * st, native_frame ** f)
+{
+  easyjsonparser_ctx * ctx = st->ctx;
+
+  if (st->depth == ctx->frames_size) {
+    size_t size = ctx->frames_size > 0 ? ctx->frames_size * 2 : NATIVE_FRAMES_MIN;
+    native_frame * frames = (native_frame *) realloc(ctx->frames, size * sizeof(native_frame));
+    if (frames == NULL)
+      return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                               "out of memory",
+                               "could not allocate %zu parse frames", size);
+    ctx->frames      = frames;
+    ctx->frames_size = size;
+
+    for (size_t i = 0; i < st->depth; i++)
+      native_link(st, &frames[i], i);
+  }
+
+  *f = &ctx->frames[st->depth];
+  (*f)->key_heap = 0;
+  native_link(st, *f, st->depth);
+  st->depth++;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Link the stack of the frame \p f, at \p depth on the frame stack, to the
+/// stack of the value it was opened for, which is that of the current key
+/// of the map below, or that of the list below, or the root.
+
+void native_link (native_state * st, native_frame * f, size_t depth)
+{
+  if (depth == 0)
+    f->stack = st->root;
+  else if (f[-1].kind == NATIVE_FRAME_MAP)
+    f->stack = &f[-1].member;
+  else
+    f->stack = f[-1].stack;
+
+  f->member.prev = f->stack;
+  f->member.ctx  = st->ctx;
+  if (!f->key_heap)
+    f->member.key = f->keybuf;
+}
+
+
+/// Pop the map or list frame \p f from the frame stack, its closing brace
+/// or bracket having been stepped over.
+
+static inline int native_close (native_state * st, native_frame * f)
+{
+  if (f->track)
+    native_complete(st, f->stack, f->keys > 0 ? f->keys - __builtin_popcountll(f->seen) : 1);
+  st->depth--;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Take the next step in the map of the frame \p f, the equivalent of an
+/// iteration of rec_parse_obj. Variable keys apply the single schema entry
+/// to every value, fixed keys look each key up in the schema.
+
+int native_step_map (native_state * st, native_frame * f, void * cfg)
+{
+  if (f->started) {
+    if (f->key_heap) {
+      free(f->member.key);
+      f->key_heap = 0;
+    }
+
+    native_skip_ws(st);
+    if (st->p < st->end && *st->p == ',') {
+      native_advance(st);
+      native_skip_ws(st);
+    } else if (st->p < st->end && *st->p == '}') {
+      native_advance(st);
+      return native_close(st, f);
+    } else {
+      return native_syntax_error(st, "',' or '}'");
+    }
+  }
+  f->started = 1;
+
+  if (st->p >= st->end || *st->p != '"')
+    return native_syntax_error(st, "an object key");
+
+  char * scanned_key;
+  size_t key_len;
+  int in_input;
+  int retval = native_scan_string(st, &scanned_key, &key_len, &in_input);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  // The scratch buffer is reused by the value so the key needs a copy of
+  // its own (and a terminating zero byte) for as long as it is on the
+  // stack.
+  char * key = f->keybuf;
+  if (key_len >= NATIVE_KEYBUF_LEN) {
+    if ((key = (char *) malloc(key_len + 1)) == NULL)
+      return ejp_error_handler(st->ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                               "out of memory",
+                               "could not allocate %zu bytes while parsing key", key_len + 1);
+    f->key_heap = 1;
+  }
+  memcpy(key, scanned_key, key_len);
+  key[key_len] = '\0';
+  f->member.key = key;
+
+  native_skip_ws(st);
+  if (st->p >= st->end || *st->p != ':')
+    return native_syntax_error(st, "':'");
+  native_advance(st);
+
+  easyjsonparser_schema * js2 = f->varkeys ? f->js : ejp_schema_find(st->ctx, f->js, key, key_len);
+
+  if (js2 != NULL) {
+    if (f->keys > 0 && !(f->seen & (uint64_t) 1 << (js2 - f->js))) {
+      f->seen |= (uint64_t) 1 << (js2 - f->js);
+      st->track = 1;
+    }
+    return native_parse_value(st, js2, &f->member, cfg);
+  }
+
+  if (f->lenient)
+    return native_skip_value(st);
+
+  char * stack_path = ejp_error_path(st->ctx, f->stack);
+  void * data[3] = {f->js, stack_path, key};
+  retval = ejp_error_handler(st->ctx, EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY, data,
+                             "unexpected key",
+                             "key %s unexpected while parsing map at %s",
+                             key, stack_path);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = native_skip_value(st);
+
+  return retval;
+}
+
+
+/// Find the first of the list schema entries \p js which takes the element
+/// of schema entry type \p type at the current position, setting \p alt
+/// to it, or NULL if there are none. The keys of map entries are all looked
+/// for in one scan of the object.
+
+static int native_find_alt (native_state * st, easyjsonparser_schema * js, int type, easyjsonparser_schema ** alt)
+{
+  easyjsonparser_schema * keyed = NULL;
+
+  for (; js->type != EASYJSONPARSER_SCHEMA_END; js++) {
+    if (!ejp_schema_accepts(js, type))
+      continue;
+    if (type != EASYJSONPARSER_SCHEMA_MAP || js->key == NULL)
+      break;
+    if (keyed == NULL)
+      keyed = js;
+  }
+
+  *alt = js->type != EASYJSONPARSER_SCHEMA_END ? js : NULL;
+  if (keyed == NULL)
+    return EASYJSONPARSER_SUCCESS;
+
+  return native_keyed_alt(st, st->p, keyed, js, alt);
+}
+
+
+/// Take the next step in the list of the frame \p f, the equivalent of an
+/// iteration of rec_parse_list. The schema entries are alternatives, each
+/// element being classified once and parsed by the first entry for its
+/// type.
+
+int native_step_list (native_state * st, native_frame * f, void * cfg)
+{
+  easyjsonparser_schema * alt = NULL;
+  int retval;
+
+  if (f->started) {
+    native_skip_ws(st);
+    if (st->p < st->end && *st->p == ',') {
+      native_advance(st);
+      native_skip_ws(st);
+    } else if (st->p < st->end && *st->p == ']') {
+      native_advance(st);
+      return native_close(st, f);
+    } else {
+      return native_syntax_error(st, "',' or ']'");
+    }
+  }
+  f->started = 1;
+
+  native_type type = native_peek_type(st);
+  if (type == NATIVE_TYPE_INVALID)
+    return native_syntax_error(st, "a value");
+
+  if ((retval = native_find_alt(st, f->js, native_type_to_schema(type), &alt)) != EASYJSONPARSER_SUCCESS)
+    return retval;
+  if (alt != NULL)
+    return native_parse_value(st, alt, f->stack, cfg);
+
+  retval = f->js->type == EASYJSONPARSER_SCHEMA_END
+    ? EASYJSONPARSER_SUCCESS
+    : ejp_mandate_error(st->ctx, f->js, f->stack, native_type_to_str(type));
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = native_skip_value(st);
+
+  return retval;
+}
+
+
+/// Parse a JSON list of numbers for the typed array schema entry \p js, the
+/// native equivalent of rec_parse_array, the current position being the
+/// opening bracket. The numbers are converted straight into the batch, so
+/// nothing is called per element.
+
+int native_parse_array (native_state * st, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+{
+  EJP_TRACE(st->ctx, "JSON typed array processing");
+
+  int dbl = (js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_DBL;
+  ejp_array_batch batch;
+  size_t n = 0, offset = 0;
+
+  native_advance(st);
+  native_skip_ws(st);
+  if (st->p < st->end && *st->p == ']') {
+    native_advance(st);
+    ejp_array_flush(js, stack, &batch, 0, 0, cfg);
+    return EASYJSONPARSER_SUCCESS;
+  }
+
+  for (;;) {
+    native_type type = native_peek_type(st);
+    int retval;
+
+    if (type == NATIVE_TYPE_INT && !dbl) {
+      retval = native_scan_number(st, type, &batch.i[n++], NULL);
+    } else if ((type == NATIVE_TYPE_INT || type == NATIVE_TYPE_DOUBLE) && dbl) {
+      retval = native_scan_number(st, NATIVE_TYPE_DOUBLE, NULL, &batch.d[n++]);
+    } else if (type == NATIVE_TYPE_INVALID) {
+      retval = native_syntax_error(st, "a value");
+    } else {
+      easyjsonparser_schema elem_js = *js;
+      elem_js.type &= ~EASYJSONPARSER_SCHEMA_ARR;
+      if ((retval = ejp_mandate_error(st->ctx, &elem_js, stack, native_type_to_str(type))) == EASYJSONPARSER_SUCCESS)
+        retval = native_skip_value(st);
+    }
+    if (retval != EASYJSONPARSER_SUCCESS)
+      return retval;
+
+    if (n == EJP_ARRAY_BATCH) {
+      ejp_array_flush(js, stack, &batch, n, offset, cfg);
+      offset += n;
+      n = 0;
+    }
+
+    native_skip_ws(st);
+    if (st->p < st->end && *st->p == ',') {
+      native_advance(st);
+      native_skip_ws(st);
+    } else if (st->p < st->end && *st->p == ']') {
+      native_advance(st);
+      break;
+    } else {
+      return native_syntax_error(st, "',' or ']'");
+    }
+  }
+
+  if (n > 0)
+    ejp_array_flush(js, stack, &batch, n, offset, cfg);
+  ejp_array_flush(js, stack, &batch, 0, offset + n, cfg);
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Skip over a complete value of any type, checking its syntax but calling
+/// nothing, converting no numbers and unescaping no strings. Used for
+/// values the schema has no entry for (once the error handler has quashed
+/// the resulting error), the values of keys a lenient map ignores, and by
+/// the cursors. Maps and lists being skipped are counted towards the
+/// nesting depth limit, and which of the two each is remembered a bit at a
+/// time, so a closer must match its opener.
+
+int native_skip_value (native_state * st)
+{
+  uint64_t   local[NATIVE_SKIP_WORDS];
+  uint64_t * maps  = local;
+  size_t     size  = NATIVE_SKIP_WORDS * 64;
+  size_t     depth = 0;
+  int        value = 1;
+  int        retval = EASYJSONPARSER_SUCCESS;
+
+  while (retval == EASYJSONPARSER_SUCCESS) {
+    if (value) {
+      native_skip_ws(st);
+
+      native_type type = native_peek_type(st);
+
+      if (type == NATIVE_TYPE_OBJECT || type == NATIVE_TYPE_ARRAY) {
+        if (st->depth + depth >= st->ctx->max_depth) {
+          retval = native_depth_error(st);
+          break;
+        }
+        if (depth == size) {
+          uint64_t * grown = (uint64_t *) malloc(size / 64 * 2 * sizeof(uint64_t));
+          if (grown == NULL) {
+            retval = ejp_error_handler(st->ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                                       "out of memory",
+                                       "could not allocate %zu bytes while skipping value", size / 64 * 2 * sizeof(uint64_t));
+            break;
+          }
+          memcpy(grown, maps, size / 64 * sizeof(uint64_t));
+          if (maps != local)
+            free(maps);
+          maps  = grown;
+          size *= 2;
+        }
+
+        if (type == NATIVE_TYPE_OBJECT)
+          maps[depth / 64] |= (uint64_t) 1 << (depth % 64);
+        else
+          maps[depth / 64] &= ~((uint64_t) 1 << (depth % 64));
+        depth++;
+
+        native_advance(st);
+        native_skip_ws(st);
+        if (st->p < st->end && *st->p == (type == NATIVE_TYPE_OBJECT ? '}' : ']')) {
+          native_advance(st);
+          depth--;
+          value = 0;
+        } else if (type == NATIVE_TYPE_OBJECT) {
+          retval = native_skip_key(st);
+        }
+      } else if (type == NATIVE_TYPE_STRING) {
+        retval = native_skip_string(st);
+        value  = 0;
+      } else if (type == NATIVE_TYPE_INT || type == NATIVE_TYPE_DOUBLE) {
+        retval = native_skip_number(st);
+        value  = 0;
+      } else if (type == NATIVE_TYPE_BOOLEAN) {
+        retval = native_scan_literal(st, *st->p == 't' ? "true" : "false");
+        value  = 0;
+      } else if (type == NATIVE_TYPE_NULL) {
+        retval = native_scan_literal(st, "null");
+        value  = 0;
+      } else {
+        retval = native_syntax_error(st, "a value");
+      }
+    } else {
+      if (depth == 0)
+        break;
+
+      int map = (maps[(depth - 1) / 64] >> ((depth - 1) % 64)) & 1;
+
+      native_skip_ws(st);
+      if (st->p < st->end && *st->p == ',') {
+        native_advance(st);
+        native_skip_ws(st);
+        value = 1;
+        if (map)
+          retval = native_skip_key(st);
+      } else if (st->p < st->end && *st->p == (map ? '}' : ']')) {
+        native_advance(st);
+        depth--;
+      } else {
+        retval = native_syntax_error(st, map ? "',' or '}'" : "',' or ']'");
+      }
+    }
+  }
+
+  if (maps != local)
+    free(maps);
+
+  return retval;
+}
+
+
+/// Step over the key at the current position, checking it as any string,
+/// and the colon after it.
+
+int native_skip_key (native_state * st)
+{
+  if (st->p >= st->end || *st->p != '"')
+    return native_syntax_error(st, "an object key");
+
+  int retval = native_skip_string(st);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  native_skip_ws(st);
+  if (st->p >= st->end || *st->p != ':')
+    return native_syntax_error(st, "':'");
+  native_advance(st);
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Make sure the scratch buffer can hold at least \p size bytes.
+
+static int native_reserve_scratch (native_state * st, size_t size)
+{
+  if (size <= st->ctx->scratch_size)
+    return 1;
+
+  size_t new_size = st->ctx->scratch_size ? st->ctx->scratch_size : 256;
+  while (new_size < size)
+    new_size *= 2;
+
+  char * new_scratch = (char *) realloc(st->ctx->scratch, new_size);
+  if (new_scratch == NULL)
+    return 0;
+
+  st->ctx->scratch      = new_scratch;
+  st->ctx->scratch_size = new_size;
+
+  return 1;
+}
+
+
+/// Return the value of hex digit \p c, or -1 if it isn't one.
+
+static inline int native_hex_val (char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+
+/// Return the first quote, backslash or control character from \p p (but
+/// not beyond \p end), or \p end if there is none, looking at sixteen
+/// bytes at a time where SSE2 is available.
+
+static inline const char * native_find_quote_or_bs (const char * p, const char * end)
+{
+#ifdef __SSE2__
+  const __m128i c_quote = _mm_set1_epi8('"');
+  const __m128i c_bs    = _mm_set1_epi8('\\');
+  const __m128i c_ctrl  = _mm_set1_epi8(0x1f);
+
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    int m = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, c_quote), _mm_cmpeq_epi8(v, c_bs)),
+                                           _mm_cmpeq_epi8(_mm_min_epu8(v, c_ctrl), v)));
+    if (m != 0)
+      return p + __builtin_ctz(m);
+  }
+#endif
+
+  while (p < end && *p != '"' && *p != '\\' && (unsigned char) *p >= 0x20)
+    p++;
+
+  return p;
+}
+
+
+/// Return the closing quote of the string whose body starts at \p p, or
+/// the first raw control character in it, or \p end if it has neither.
+
+static inline const char * native_skip_string_body (const char * p, const char * end)
+{
+  while ((p = native_find_quote_or_bs(p, end)) < end && *p == '\\')
+    if ((p += 2) > end)
+      p = end;
+
+  return p;
+}
+
+
+/// Read the four hex digits of a \\u escape at \p p.
+
+static inline long native_hex4 (const char * p)
+{
+  long cp = 0;
+  for (int i = 0; i < 4; i++) {
+    int v = native_hex_val(p[i]);
+    if (v < 0)
+      return -1;
+    cp = (cp << 4) | v;
+  }
+  return cp;
+}
+
+
+/// Report the string whose body \ref native_skip_string_body found to end
+/// at \p q as unterminated, or as having a raw control character at \p q.
+
+int native_string_error (native_state * st, const char * q)
+{
+  st->p = q;
+
+  return native_syntax_error(st, q >= st->end ? "closing '\"'" : "an escaped control character");
+}
+
+
+/// Step over the string at the current position (which must be the
+/// opening quote), checking its escapes but not unescaping it. With the
+/// structural index the closing quote comes from the index, and the body
+/// of a string without escapes or control characters is not looked at.
+
+int native_skip_string (native_state * st)
+{
+  const char * start = st->p + 1;
+  const char * q = NULL;
+  int escaped = 1;
+
+  if (st->indexed) {
+    if (ejp_index_next(&st->ix, NULL) == st->p)
+      q = ejp_index_next(&st->ix, &escaped);
+    if (q == NULL)
+      st->indexed = 0;
+  }
+
+  if (q == NULL || escaped)
+    q = native_skip_string_body(start, st->end);
+  if (q >= st->end || *q != '"')
+    return native_string_error(st, q);
+
+  for (const char * p = start; escaped && (p = (const char *) memchr(p, '\\', q - p)) != NULL; p += 2) {
+    switch (p[1]) {
+    case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+      break;
+    case 'u':
+      if (q - p > 5 && native_hex4(p + 2) >= 0) {
+        p += 4;
+        break;
+      }
+      st->p = p + 1;
+      return native_syntax_error(st, "four hex digits");
+    default:
+      st->p = p + 1;
+      return native_syntax_error(st, "a valid escape");
+    }
+  }
+
+  int retval;
+  if (q > st->valid_end && (retval = native_validate(st, q)) != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  st->p = q + 1;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Scan the string at the current position (which must be the opening
+/// quote), leaving it unescaped and zero byte terminated in the scratch
+/// buffer, and set \p val and \p val_len to it. If \p in_input is not NULL
+/// a string without escapes is not copied, \p val pointing into the input
+/// instead (so not zero byte terminated), and \p in_input is set to say
+/// which happened.
+
+int native_scan_string (native_state * st, char ** val, size_t * val_len, int * in_input)
+{
+  const char * start = st->p + 1;
+  const char * q = NULL;
+  int escaped = 0;
+
+  // The closing quote comes straight from the index, if the index agrees
+  // about where the string starts.
+  if (st->indexed) {
+    if (ejp_index_next(&st->ix, NULL) == st->p)
+      q = ejp_index_next(&st->ix, &escaped);
+    if (q == NULL)
+      st->indexed = 0;
+  }
+  st->p = start;
+
+  if (q == NULL) {
+    escaped = 0;
+    q = native_find_quote_or_bs(start, st->end);
+    if (q < st->end && *q == '\\') {
+      escaped = 1;
+      q = native_skip_string_body(q, st->end);
+    }
+  } else if (escaped) {
+    // The index flags control characters as it does escapes, so which
+    // this string has is found by looking.
+    q = native_skip_string_body(start, st->end);
+  }
+  if (q >= st->end || *q != '"')
+    return native_string_error(st, q);
+
+  int retval;
+  if (q > st->valid_end && (retval = native_validate(st, q)) != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  if (in_input != NULL)
+    *in_input = !escaped;
+  if (in_input != NULL && !escaped) {
+    *val     = (char *) start;
+    *val_len = q - start;
+    st->p    = q + 1;
+    return EASYJSONPARSER_SUCCESS;
+  }
+
+  // Unescaping never lengthens a string, so the raw length is enough.
+  if (!native_reserve_scratch(st, (q - start) + 1)) {
+    return ejp_error_handler(st->ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                             "out of memory",
+                             "could not allocate %zu bytes while parsing string", (size_t) (q - start) + 1);
+  }
+
+  if (!escaped) {
+    memcpy(st->ctx->scratch, start, q - start);
+    *val_len = q - start;
+  } else {
+    // The runs between escapes are copied in bulk.
+    char * out = st->ctx->scratch;
+    for (const char * p = start; p < q; p++) {
+      const char * bs = (const char *) memchr(p, '\\', q - p);
+      if (bs == NULL)
+        bs = q;
+      memcpy(out, p, bs - p);
+      out += bs - p;
+      if ((p = bs) == q)
+        break;
+
+      switch (*++p) {
+      case '"':  *out++ = '"';  break;
+      case '\\': *out++ = '\\'; break;
+      case '/':  *out++ = '/';  break;
+      case 'b':  *out++ = '\b'; break;
+      case 'f':  *out++ = '\f'; break;
+      case 'n':  *out++ = '\n'; break;
+      case 'r':  *out++ = '\r'; break;
+      case 't':  *out++ = '\t'; break;
+
+      case 'u': {
+        long cp = q - p > 4 ? native_hex4(p + 1) : -1;
+        if (cp < 0) {
+          st->p = p;
+          return native_syntax_error(st, "four hex digits");
+        }
+        p += 4;
+        if (cp >= 0xd800 && cp <= 0xdbff && q - p > 6 && p[1] == '\\' && p[2] == 'u') {
+          long lo = native_hex4(p + 3);
+          if (lo >= 0xdc00 && lo <= 0xdfff) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+            p += 6;
+          }
+        }
+        // A surrogate without its other half becomes U+FFFD, as json-c
+        // makes it, rather than a sequence that isn't UTF-8.
+        if (cp >= 0xd800 && cp <= 0xdfff)
+          cp = 0xfffd;
+        if (cp < 0x80) {
+          *out++ = (char) cp;
+        } else if (cp < 0x800) {
+          *out++ = (char) (0xc0 | (cp >> 6));
+          *out++ = (char) (0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+          *out++ = (char) (0xe0 | (cp >> 12));
+          *out++ = (char) (0x80 | ((cp >> 6) & 0x3f));
+          *out++ = (char) (0x80 | (cp & 0x3f));
+        } else {
+          *out++ = (char) (0xf0 | (cp >> 18));
+          *out++ = (char) (0x80 | ((cp >> 12) & 0x3f));
+          *out++ = (char) (0x80 | ((cp >> 6) & 0x3f));
+          *out++ = (char) (0x80 | (cp & 0x3f));
+        }
+        break;
+      }
+
+      default:
+        st->p = p;
+        return native_syntax_error(st, "a valid escape");
+      }
+    }
+    *val_len = out - st->ctx->scratch;
+  }
+
+  st->ctx->scratch[*val_len] = '\0';
+  *val = st->ctx->scratch;
+  st->p = q + 1;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Accumulate the decimal digits from \p p (but not beyond \p end) onto
+/// \p mag, eight at a time where the byte order allows, wrapping if they
+/// overflow, and return the end of the digits.
+
+static inline const char * native_scan_digits (const char * p, const char * end, uint64_t * mag)
+{
+  uint64_t m = *mag;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // Eight bytes are all digits if each high nibble is 3 and adding 6 to
+  // the low nibble doesn't carry, and are then combined in three
+  // multiplies, pairs of digits, then fours, then all eight.
+  for (; end - p >= 8; p += 8) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    if (((w & 0xf0f0f0f0f0f0f0f0ull) | (((w + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) >> 4)) != 0x3333333333333333ull)
+      break;
+    w = ((w & 0x0f0f0f0f0f0f0f0full) * 2561) >> 8;
+    w = ((w & 0x00ff00ff00ff00ffull) * 6553601) >> 16;
+    w = ((w & 0x0000ffff0000ffffull) * 42949672960001ull) >> 32;
+    m = m * 100000000 + w;
+  }
+#endif
+
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+    m = m * 10 + (*p - '0');
+
+  *mag = m;
+  return p;
+}
+
+
+/// Step over the number at the current position, checking its syntax but
+/// not converting it.
+
+int native_skip_number (native_state * st)
+{
+  const char * p = st->p;
+  if (*p == '-')
+    p++;
+
+  const char * digits = p;
+  while (p < st->end && *p >= '0' && *p <= '9')
+    p++;
+  if (p == digits) {
+    st->p = p;
+    return native_syntax_error(st, "a digit");
+  }
+  if (*digits == '0' && p - digits > 1) {
+    st->p = digits + 1;
+    return native_syntax_error(st, "no more digits after a leading zero");
+  }
+
+  if (p < st->end && *p == '.') {
+    digits = ++p;
+    while (p < st->end && *p >= '0' && *p <= '9')
+      p++;
+    if (p == digits) {
+      st->p = p;
+      return native_syntax_error(st, "a digit");
+    }
+  }
+
+  if (p < st->end && (*p == 'e' || *p == 'E')) {
+    if (++p < st->end && (*p == '+' || *p == '-'))
+      p++;
+    digits = p;
+    while (p < st->end && *p >= '0' && *p <= '9')
+      p++;
+    if (p == digits) {
+      st->p = p;
+      return native_syntax_error(st, "a digit");
+    }
+  }
+
+  st->p = p;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Scan the number at the current position, already classified by
+/// \ref native_peek_type as \p type (an integer or a double). Doubles are
+/// converted by \ref ejp_decimal_to_double, or if that can't, strtod.
+
+int native_scan_number (native_state * st, native_type type, int64_t * ival, double * dval)
+{
+  const char * p = st->p;
+
+  int neg = *p == '-';
+  if (neg)
+    p++;
+
+  const char * digits = p;
+  uint64_t mag = 0;
+  p = native_scan_digits(p, st->end, &mag);
+  if (*digits == '0' && p - digits > 1) {
+    st->p = digits + 1;
+    return native_syntax_error(st, "no more digits after a leading zero");
+  }
+
+  if (type == NATIVE_TYPE_INT) {
+    // Up to 19 digits can't overflow, more are done again carefully.
+    int overflow = 0;
+    if (p - digits > 19) {
+      mag = 0;
+      for (const char * q = digits; q < p; q++) {
+        if (mag > (UINT64_MAX - (*q - '0')) / 10)
+          overflow = 1;
+        else
+          mag = mag * 10 + (*q - '0');
+      }
+    }
+
+    // Out of range integers are clamped, as json-c does.
+    if (neg)
+      *ival = overflow || mag > (uint64_t) INT64_MAX + 1 ? INT64_MIN : (int64_t) (0 - mag);
+    else
+      *ival = overflow || mag > INT64_MAX ? INT64_MAX : (int64_t) mag;
+
+    st->p = p;
+    return EASYJSONPARSER_SUCCESS;
+  }
+
+  size_t  ndigits = p - digits;
+  int64_t exp10   = 0;
+
+  if (p < st->end && *p == '.') {
+    const char * frac = ++p;
+    p = native_scan_digits(p, st->end, &mag);
+    if (p == frac) {
+      st->p = p;
+      return native_syntax_error(st, "a digit");
+    }
+    ndigits += p - frac;
+    exp10    = -(int64_t) (p - frac);
+  }
+  if (p < st->end && (*p == 'e' || *p == 'E')) {
+    p++;
+    int exp_neg = 0;
+    if (p < st->end && (*p == '+' || *p == '-'))
+      exp_neg = *p++ == '-';
+    if (p >= st->end || *p < '0' || *p > '9') {
+      st->p = p;
+      return native_syntax_error(st, "a digit");
+    }
+    int64_t exp = 0;
+    for (; p < st->end && *p >= '0' && *p <= '9'; p++)
+      if (exp < 1000000000000)
+        exp = exp * 10 + (*p - '0');
+    exp10 += exp_neg ? -exp : exp;
+  }
+
+  // Leading zeros aren't significant, so don't count against the 19
+  // digits which fit in the significand.
+  if (ndigits > 19)
+    for (const char * z = digits; z < p && (*z == '0' || *z == '.'); z++)
+      if (*z == '0')
+        ndigits--;
+
+  if (ndigits <= 19 && ejp_decimal_to_double(mag, exp10, neg, dval)) {
+    st->p = p;
+    return EASYJSONPARSER_SUCCESS;
+  }
+
+  // The input need not be zero byte terminated, so strtod works on a copy.
+  size_t len = p - st->p;
+  char numbuf[NATIVE_NUMBUF_LEN];
+  char * num = numbuf;
+  if (len >= NATIVE_NUMBUF_LEN) {
+    if (!native_reserve_scratch(st, len + 1))
+      return ejp_error_handler(st->ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                               "out of memory",
+                               "could not allocate %zu bytes while parsing number", len + 1);
+    num = st->ctx->scratch;
+  }
+  memcpy(num, st->p, len);
+  num[len] = '\0';
+
+  *dval = ejp_strtod(num);
+
+  st->p = p;
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Scan the literal (true, false or null) at the current position.
+
+int native_scan_literal (native_state * st, const char * literal)
+{
+  size_t len = strlen(literal);
+
+  if ((size_t) (st->end - st->p) < len || memcmp(st->p, literal, len) != 0)
+    return native_syntax_error(st, literal);
+
+  st->p += len;
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Classify the value at the current position by its first byte, looking
+/// further ahead only to tell integers from doubles.
+
+native_type native_peek_type (native_state * st)
+{
+  if (st->p >= st->end)
+    return NATIVE_TYPE_INVALID;
+
+  switch (*st->p) {
+  case '{':
+    return NATIVE_TYPE_OBJECT;
+
+  case '[':
+    return NATIVE_TYPE_ARRAY;
+
+  case '"':
+    return NATIVE_TYPE_STRING;
+
+  case 't':
+  case 'f':
+    return NATIVE_TYPE_BOOLEAN;
+
+  case 'n':
+    return NATIVE_TYPE_NULL;
+
+  case '-':
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9': {
+    const char * q = st->p + (*st->p == '-');
+    if (q >= st->end || *q < '0' || *q > '9')
+      return NATIVE_TYPE_INVALID;
+    while (q < st->end && *q >= '0' && *q <= '9')
+      q++;
+    return q < st->end && (*q == '.' || *q == 'e' || *q == 'E')
+      ? NATIVE_TYPE_DOUBLE
+      : NATIVE_TYPE_INT;
+  }
+
+  default:
+    return NATIVE_TYPE_INVALID;
+  }
+}
+
+
+/// Return a string representing the given native token type, these being
+/// the same strings the json-c backend uses.
+
+char * native_type_to_str (native_type type)
+{
+  switch (type) {
+  case NATIVE_TYPE_OBJECT:
+    return "object";
+
+  case NATIVE_TYPE_ARRAY:
+    return "array";
+
+  case NATIVE_TYPE_NULL:
+    return "null";
+
+  case NATIVE_TYPE_BOOLEAN:
+    return "boolean";
+
+  case NATIVE_TYPE_DOUBLE:
+    return "double";
+
+  case NATIVE_TYPE_INT:
+    return "int";
+
+  case NATIVE_TYPE_STRING:
+    return "string";
+
+  default:
+    return "unknown";
+  }
+}
+
+
+/// Return the schema entry type for \p type (\ref EASYJSONPARSER_SCHEMA_MAP,
+/// \ref EASYJSONPARSER_SCHEMA_STR and so on), or
+/// \ref EASYJSONPARSER_SCHEMA_END if it is not a value at all.
+
+int native_type_to_schema (native_type type)
+{
+  switch (type) {
+  case NATIVE_TYPE_OBJECT:  return EASYJSONPARSER_SCHEMA_MAP;
+  case NATIVE_TYPE_ARRAY:   return EASYJSONPARSER_SCHEMA_LST;
+  case NATIVE_TYPE_STRING:  return EASYJSONPARSER_SCHEMA_STR;
+  case NATIVE_TYPE_INT:     return EASYJSONPARSER_SCHEMA_INT;
+  case NATIVE_TYPE_DOUBLE:  return EASYJSONPARSER_SCHEMA_DBL;
+  case NATIVE_TYPE_BOOLEAN: return EASYJSONPARSER_SCHEMA_BOO;
+  case NATIVE_TYPE_NULL:    return EASYJSONPARSER_SCHEMA_NUL;
+  default:                  return EASYJSONPARSER_SCHEMA_END;
+  }
+}
+
+
+/// Report a syntax error at the current position.
+
+int native_syntax_error (native_state * st, const char * expected)
+{
+  size_t offset = st->p - st->buf;
+
+  return ejp_error_handler(st->ctx, EASYJSONPARSER_ERROR_PARSE_UNEXPECTED, &offset,
+                           "unexpected input",
+                           "could not parse JSON (expected %s at offset %zu)",
+                           expected, offset);
+}
+
+
+/// Validate the input as UTF-8 up to \p p at least, where it was not
+/// validated up front. The input is validated \ref NATIVE_VALIDATE_AHEAD
+/// bytes at a time, each piece ending at the start of a character (unless
+/// that is more than three bytes back, in which case the input is not
+/// UTF-8 anyway).
+
+int native_validate (native_state * st, const char * p)
+{
+  const char * to = st->end;
+  if (st->end - p > NATIVE_VALIDATE_AHEAD) {
+    to = p + NATIVE_VALIDATE_AHEAD;
+    for (int i = 0; i < 3 && (*to & 0xc0) == 0x80; i++)
+      to--;
+  }
+
+  size_t offset;
+  if (!ejp_utf8_validate(st->ctx, st->valid_end, to - st->valid_end, &offset))
+    return ejp_utf8_error(st->ctx, (st->valid_end - st->buf) + offset);
+
+  st->valid_end = to;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Set up the parse state for a cursor operation at \p p, unindexed, and
+/// with the input taken as valid UTF-8 (the cursor validates the strings it
+/// returns itself).
+
+static inline void cursor_state (native_state * st, const easyjsonparser_cursor * cur, const char * p)
+{
+  st->ctx       = cur->ctx;
+  st->buf       = cur->buf;
+  st->p         = p;
+  st->end       = cur->end;
+  st->valid_end = cur->end;
+  st->indexed   = 0;
+  st->track     = 0;
+  st->done      = 0;
+  st->root      = NULL;
+  st->depth     = 0;
+}
+
+
+/// Report the value at \p cur as not of the type wanted, returning
+/// \p err_code whatever the error handler returns, as there is no value of
+/// that type to give the caller even if the error is quashed.
+
+static int cursor_mandate_error (const easyjsonparser_cursor * cur, int err_code, const char * wanted)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  size_t offset = cur->p - cur->buf;
+  char * found  = native_type_to_str(native_peek_type(&st));
+
+  ejp_error_handler(cur->ctx, err_code, &offset,
+                    "unexpected type",
+                    "value at offset %zu must be %s but is %s",
+                    offset, wanted, found);
+
+  return err_code;
+}
+
+
+/// Scan the string at the current position, as \ref native_scan_string,
+/// into the scratch buffer, validating it as UTF-8 unless the context has
+/// the \ref EASYJSONPARSER_OPTION_TRUSTED_INPUT option.
+
+static int cursor_scan_string (native_state * st, const char ** val, size_t * len)
+{
+  const char * raw = st->p + 1;
+  char *       str;
+  size_t       str_len;
+
+  int retval = native_scan_string(st, &str, &str_len, NULL);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  size_t offset;
+  if (!(st->ctx->options & EASYJSONPARSER_OPTION_TRUSTED_INPUT) && !ejp_utf8_validate(st->ctx, raw, (st->p - 1) - raw, &offset))
+    return ejp_utf8_error(st->ctx, (raw - st->buf) + offset);
+
+  *val = str;
+  if (len != NULL)
+    *len = str_len;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Step over the key at the current position and the colon after it,
+/// leaving the position at the value.
+
+static int cursor_skip_key (native_state * st)
+{
+  if (st->p >= st->end || *st->p != '"')
+    return native_syntax_error(st, "an object key");
+
+  const char * q = native_skip_string_body(st->p + 1, st->end);
+  if (q >= st->end || *q != '"')
+    return native_string_error(st, q);
+  st->p = q + 1;
+
+  native_skip_ws(st);
+  if (st->p >= st->end || *st->p != ':')
+    return native_syntax_error(st, "':'");
+  st->p++;
+  native_skip_ws(st);
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Point \p cur at the JSON value in the \p len bytes at \p buf, which must
+/// stay put for as long as the cursor, and any cursors derived from it, are
+/// used. Nothing is parsed until asked for, so errors in the input are
+/// only found if they are in the way of what is asked for.
+
+int easyjsonparser_cursor_init (easyjsonparser_ctx * ctx, easyjsonparser_cursor * cur, const char * buf, size_t len)
+{
+  cur->ctx = ctx;
+  cur->buf = buf;
+  cur->end = buf + len;
+  cur->key = NULL;
+
+  native_state st;
+  cursor_state(&st, cur, buf);
+  native_skip_ws(&st);
+  cur->p = st.p;
+
+  if (native_peek_type(&st) == NATIVE_TYPE_INVALID)
+    return native_syntax_error(&st, "a value");
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Return the type of the value at \p cur, as the schema entry type for it
+/// (\ref EASYJSONPARSER_SCHEMA_MAP, \ref EASYJSONPARSER_SCHEMA_STR and so
+/// on), or \ref EASYJSONPARSER_SCHEMA_END if it is not a value at all.
+
+int easyjsonparser_cursor_type (const easyjsonparser_cursor * cur)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  return native_type_to_schema(native_peek_type(&st));
+}
+
+
+/// Point \p val at the value of \p key in the map at \p map, stepping over
+/// the values of the keys before it unparsed. If the key is not there
+/// \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND is returned, without calling
+/// the error handler.
+
+int easyjsonparser_cursor_find_key (const easyjsonparser_cursor * map, const char * key, easyjsonparser_cursor * val)
+{
+  if (easyjsonparser_cursor_type(map) != EASYJSONPARSER_SCHEMA_MAP)
+    return cursor_mandate_error(map, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP, "a map/object");
+
+  size_t key_len = strlen(key);
+
+  native_state st;
+  cursor_state(&st, map, map->p + 1);
+  native_skip_ws(&st);
+  if (st.p < st.end && *st.p == '}')
+    return EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+
+  for (;;) {
+    const char * key_at = st.p;
+    if (st.p >= st.end || *st.p != '"')
+      return native_syntax_error(&st, "an object key");
+
+    // Keys without escapes are compared in place, the rest unescaped.
+    const char * q = native_find_quote_or_bs(st.p + 1, st.end);
+    int match;
+    if (q < st.end && *q == '"') {
+      match = (size_t) (q - (st.p + 1)) == key_len && memcmp(st.p + 1, key, key_len) == 0;
+    } else {
+      char * scanned;
+      size_t scanned_len;
+      int retval = native_scan_string(&st, &scanned, &scanned_len, NULL);
+      if (retval != EASYJSONPARSER_SUCCESS)
+        return retval;
+      match = scanned_len == key_len && memcmp(scanned, key, key_len) == 0;
+      st.p = key_at;
+    }
+
+    int retval = cursor_skip_key(&st);
+    if (retval != EASYJSONPARSER_SUCCESS)
+      return retval;
+
+    if (match) {
+      *val     = *map;
+      val->p   = st.p;
+      val->key = key_at;
+      return EASYJSONPARSER_SUCCESS;
+    }
+
+    if ((retval = native_skip_value(&st)) != EASYJSONPARSER_SUCCESS)
+      return retval;
+
+    native_skip_ws(&st);
+    if (st.p < st.end && *st.p == ',') {
+      st.p++;
+      native_skip_ws(&st);
+    } else if (st.p < st.end && *st.p == '}') {
+      return EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+    } else {
+      return native_syntax_error(&st, "',' or '}'");
+    }
+  }
+}
+
+
+/// Point \p elem at the first element of the list, or the first value of
+/// the map, at \p container, returning
+/// \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND if it is empty.
+
+int easyjsonparser_cursor_first (const easyjsonparser_cursor * container, easyjsonparser_cursor * elem)
+{
+  int type = easyjsonparser_cursor_type(container);
+  if (type != EASYJSONPARSER_SCHEMA_MAP && type != EASYJSONPARSER_SCHEMA_LST)
+    return cursor_mandate_error(container, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST, "a list/array or map/object");
+
+  native_state st;
+  cursor_state(&st, container, container->p + 1);
+  native_skip_ws(&st);
+  if (st.p < st.end && *st.p == (type == EASYJSONPARSER_SCHEMA_MAP ? '}' : ']'))
+    return EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+
+  const char * key_at = NULL;
+  if (type == EASYJSONPARSER_SCHEMA_MAP) {
+    key_at = st.p;
+    int retval = cursor_skip_key(&st);
+    if (retval != EASYJSONPARSER_SUCCESS)
+      return retval;
+  }
+
+  *elem     = *container;
+  elem->p   = st.p;
+  elem->key = key_at;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Move \p elem on to the next element of its list, or the next value of
+/// its map, stepping over the current one unparsed, returning
+/// \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND (and leaving \p elem alone)
+/// if there are no more.
+
+int easyjsonparser_cursor_next (easyjsonparser_cursor * elem)
+{
+  native_state st;
+  cursor_state(&st, elem, elem->p);
+
+  int retval = native_skip_value(&st);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  char close = elem->key != NULL ? '}' : ']';
+
+  native_skip_ws(&st);
+  if (st.p < st.end && *st.p == close)
+    return EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+  if (st.p >= st.end || *st.p != ',')
+    return native_syntax_error(&st, close == '}' ? "',' or '}'" : "',' or ']'");
+  st.p++;
+  native_skip_ws(&st);
+
+  const char * key_at = NULL;
+  if (elem->key != NULL) {
+    key_at = st.p;
+    if ((retval = cursor_skip_key(&st)) != EASYJSONPARSER_SUCCESS)
+      return retval;
+  }
+
+  elem->p   = st.p;
+  elem->key = key_at;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Point \p elem at element \p n (from zero) of the list at \p list,
+/// returning \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND if there are not
+/// that many.
+
+int easyjsonparser_cursor_at (const easyjsonparser_cursor * list, size_t n, easyjsonparser_cursor * elem)
+{
+  if (easyjsonparser_cursor_type(list) != EASYJSONPARSER_SCHEMA_LST)
+    return cursor_mandate_error(list, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST, "a list/array");
+
+  easyjsonparser_cursor e;
+  int retval = easyjsonparser_cursor_first(list, &e);
+  for (size_t i = 0; i < n && retval == EASYJSONPARSER_SUCCESS; i++)
+    retval = easyjsonparser_cursor_next(&e);
+
+  if (retval == EASYJSONPARSER_SUCCESS)
+    *elem = e;
+
+  return retval;
+}
+
+
+/// Set \p key to the key of the map value at \p elem, and \p len (unless
+/// it is NULL) to its length. The key is zero byte terminated, in a buffer
+/// belonging to the context which is reused by the next cursor or parse
+/// call. \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND is returned if \p elem
+/// is not a map value.
+
+int easyjsonparser_cursor_get_key (const easyjsonparser_cursor * elem, const char ** key, size_t * len)
+{
+  if (elem->key == NULL)
+    return EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+
+  native_state st;
+  cursor_state(&st, elem, elem->key);
+
+  return cursor_scan_string(&st, key, len);
+}
+
+
+/// Set \p val to the string at \p cur, and \p len (unless it is NULL) to
+/// its length, unescaped and zero byte terminated, in a buffer belonging to
+/// the context which is reused by the next cursor or parse call.
+
+int easyjsonparser_cursor_get_str (const easyjsonparser_cursor * cur, const char ** val, size_t * len)
+{
+  if (easyjsonparser_cursor_type(cur) != EASYJSONPARSER_SCHEMA_STR)
+    return cursor_mandate_error(cur, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING, "a string");
+
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  return cursor_scan_string(&st, val, len);
+}
+
+
+/// Set \p val to the integer at \p cur (clamped to the range of int64_t,
+/// as for \ref EASYJSONPARSER_I64).
+
+int easyjsonparser_cursor_get_int (const easyjsonparser_cursor * cur, int64_t * val)
+{
+  if (easyjsonparser_cursor_type(cur) != EASYJSONPARSER_SCHEMA_INT)
+    return cursor_mandate_error(cur, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT, "an integer");
+
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  return native_scan_number(&st, NATIVE_TYPE_INT, val, NULL);
+}
+
+
+/// Set \p val to the number at \p cur, which may be a double or an
+/// integer.
+
+int easyjsonparser_cursor_get_double (const easyjsonparser_cursor * cur, double * val)
+{
+  int type = easyjsonparser_cursor_type(cur);
+  if (type != EASYJSONPARSER_SCHEMA_DBL && type != EASYJSONPARSER_SCHEMA_INT)
+    return cursor_mandate_error(cur, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_DOUBLE, "a double/float");
+
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  // An integer is converted as if it were written as a double.
+  return native_scan_number(&st, NATIVE_TYPE_DOUBLE, NULL, val);
+}
+
+
+/// Set \p val to 1 or 0 for the boolean true or false at \p cur.
+
+int easyjsonparser_cursor_get_bool (const easyjsonparser_cursor * cur, int * val)
+{
+  if (easyjsonparser_cursor_type(cur) != EASYJSONPARSER_SCHEMA_BOO)
+    return cursor_mandate_error(cur, EASYJSONPARSER_ERROR_SCHEMA_MANDATES_BOOL, "a boolean");
+
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  int truth = *cur->p == 't';
+  int retval = native_scan_literal(&st, truth ? "true" : "false");
+  if (retval == EASYJSONPARSER_SUCCESS)
+    *val = truth;
+
+  return retval;
+}
+
+
+/// Report the value at the current position as not of the type the schema
+/// entry \p js mandates, as the parser would. If the error handler quashes
+/// the error the value is skipped, \p cur moved past it and
+/// \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND returned, as there is no
+/// value to use.
+
+static int scan_mismatch (native_state * st, easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack)
+{
+  native_type type = native_peek_type(st);
+  if (type == NATIVE_TYPE_INVALID)
+    return native_syntax_error(st, "a value");
+
+  int retval = ejp_mandate_error(st->ctx, js, stack, native_type_to_str(type));
+  if (retval == EASYJSONPARSER_SUCCESS && (retval = native_skip_value(st)) == EASYJSONPARSER_SUCCESS) {
+    cur->p = st->p;
+    retval = EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+  }
+
+  return retval;
+}
+
+
+/// Start scanning the \p len bytes of JSON at \p buf, pointing \p cur at
+/// its value. The scan functions parse the input in order, each moving
+/// \p cur past what it parses, for parsers with the schema compiled into
+/// them (see ejp-codegen) rather than interpreted. The input is validated
+/// as UTF-8 here, unless the context has the
+/// \ref EASYJSONPARSER_OPTION_TRUSTED_INPUT option.
+
+int easyjsonparser_scan_init (easyjsonparser_ctx * ctx, easyjsonparser_cursor * cur, const char * buf, size_t len)
+{
+  if (ctx->own_arena != NULL)
+    easyjsonparser_arena_reset(ctx->own_arena);
+  if (ctx->own_intern != NULL)
+    easyjsonparser_intern_reset(ctx->own_intern);
+
+  size_t offset;
+  if (!(ctx->options & EASYJSONPARSER_OPTION_TRUSTED_INPUT) && !ejp_utf8_validate(ctx, buf, len, &offset))
+    return ejp_utf8_error(ctx, offset);
+
+  return easyjsonparser_cursor_init(ctx, cur, buf, len);
+}
+
+
+/// Finish scanning, there being nothing but whitespace allowed after the
+/// value.
+
+int easyjsonparser_scan_finish (easyjsonparser_cursor * cur)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+  native_skip_ws(&st);
+
+  if (st.p != st.end)
+    return native_syntax_error(&st, "end of input");
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Enter the map or list (as the schema entry \p js mandates) at \p cur,
+/// the value's stack being \p stack, moving \p cur to its first key or
+/// element. If it is empty, or the wrong type and the error quashed,
+/// \p cur is moved past it and \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND
+/// returned.
+
+int easyjsonparser_scan_enter (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  char open = (js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_MAP ? '{' : '[';
+  if (st.p >= st.end || *st.p != open)
+    return scan_mismatch(&st, cur, js, stack);
+
+  st.p++;
+  native_skip_ws(&st);
+
+  if (st.p < st.end && *st.p == (open == '{' ? '}' : ']')) {
+    cur->p = st.p + 1;
+    return EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+  }
+
+  cur->p = st.p;
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Check that the map or list at \p cur, \p depth deep (the root being 1
+/// deep), is not nested deeper than the context allows, reporting
+/// \ref EASYJSONPARSER_ERROR_PARSE_DEPTH as the parser would if it is. For
+/// callers of the scan functions keeping a stack of their own.
+
+int easyjsonparser_scan_depth (easyjsonparser_cursor * cur, size_t depth)
+{
+  if (depth <= cur->ctx->max_depth)
+    return EASYJSONPARSER_SUCCESS;
+
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  return native_depth_error(&st);
+}
+
+
+/// Move \p cur on to the next key or element of the map or list (as
+/// \p type, \ref EASYJSONPARSER_SCHEMA_MAP or \ref EASYJSONPARSER_SCHEMA_LST)
+/// it is in, having scanned the current value, or past the end of it,
+/// returning \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND, if there are no
+/// more.
+
+int easyjsonparser_scan_next (easyjsonparser_cursor * cur, int type)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+  native_skip_ws(&st);
+
+  char close = type == EASYJSONPARSER_SCHEMA_MAP ? '}' : ']';
+
+  if (st.p < st.end && *st.p == ',') {
+    st.p++;
+    native_skip_ws(&st);
+    cur->p = st.p;
+    return EASYJSONPARSER_SUCCESS;
+  }
+  if (st.p < st.end && *st.p == close) {
+    cur->p = st.p + 1;
+    return EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND;
+  }
+
+  return native_syntax_error(&st, close == '}' ? "',' or '}'" : "',' or ']'");
+}
+
+
+/// Scan the map key at \p cur and the colon after it, setting \p key and
+/// \p len to it, and moving \p cur to its value. The key is not zero byte
+/// terminated, and is either in the input or (if it has escapes) unescaped
+/// in a buffer belonging to the context, reused by the next scan.
+
+int easyjsonparser_scan_key (easyjsonparser_cursor * cur, const char ** key, size_t * len)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  if (st.p >= st.end || *st.p != '"')
+    return native_syntax_error(&st, "an object key");
+
+  const char * q = native_find_quote_or_bs(st.p + 1, st.end);
+  if (q < st.end && *q == '"') {
+    *key  = st.p + 1;
+    *len  = q - (st.p + 1);
+    st.p  = q + 1;
+  } else {
+    char * scanned;
+    int retval = native_scan_string(&st, &scanned, len, NULL);
+    if (retval != EASYJSONPARSER_SUCCESS)
+      return retval;
+    *key = scanned;
+  }
+
+  native_skip_ws(&st);
+  if (st.p >= st.end || *st.p != ':')
+    return native_syntax_error(&st, "':'");
+  st.p++;
+  native_skip_ws(&st);
+
+  cur->p = st.p;
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Report the key \p key (\p len bytes long) as unexpected in the map
+/// whose child schema entry array is \p js, the map's stack being
+/// \p stack, as the parser would, skipping its value if the error handler
+/// quashes the error.
+
+int easyjsonparser_scan_unexpected (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, const char * key, size_t len)
+{
+  char * copy = (char *) malloc(len + 1);
+  if (copy == NULL)
+    return ejp_error_handler(cur->ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                             "out of memory",
+                             "could not allocate %zu bytes while parsing key", len + 1);
+  memcpy(copy, key, len);
+  copy[len] = '\0';
+
+  char * stack_path = ejp_error_path(cur->ctx, stack);
+  void * data[3] = {js, stack_path, copy};
+  int retval = ejp_error_handler(cur->ctx, EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY, data,
+                                 "unexpected key",
+                                 "key %s unexpected while parsing map at %s",
+                                 copy, stack_path);
+  free(copy);
+
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = easyjsonparser_scan_skip(cur);
+
+  return retval;
+}
+
+
+/// Report the value at \p cur as not of the type the schema entry \p js
+/// mandates, its stack being \p stack, as the parser would report a list
+/// element none of the entries take. If the error is quashed the value is
+/// skipped and \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND returned.
+
+int easyjsonparser_scan_mismatch (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  return scan_mismatch(&st, cur, js, stack);
+}
+
+
+/// Report a failure to allocate \p size bytes while scanning at \p cur,
+/// as the parser would, for scanners which allocate memory of their own.
+
+int easyjsonparser_scan_nomem (easyjsonparser_cursor * cur, size_t size)
+{
+  return ejp_error_handler(cur->ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                           "out of memory",
+                           "could not allocate %zu bytes while parsing", size);
+}
+
+
+/// Skip the value at \p cur unparsed.
+
+int easyjsonparser_scan_skip (easyjsonparser_cursor * cur)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  int retval = native_skip_value(&st);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    cur->p = st.p;
+
+  return retval;
+}
+
+
+/// Scan the string at \p cur for the schema entry \p js, the value's stack
+/// being \p stack, setting \p val to it and \p len (unless it is NULL) to
+/// its length, unescaped and zero byte terminated, in a buffer belonging to
+/// the context which is reused by the next scan. If the value is not a
+/// string this and the other value scan functions report it as the parser
+/// would, returning \ref EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND (having
+/// skipped the value) if the error handler quashes the error.
+
+int easyjsonparser_scan_str (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, char ** val, size_t * len)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  if (st.p >= st.end || *st.p != '"')
+    return scan_mismatch(&st, cur, js, stack);
+
+  size_t str_len;
+  int retval = native_scan_string(&st, val, &str_len, NULL);
+  if (retval == EASYJSONPARSER_SUCCESS) {
+    cur->p = st.p;
+    if (len != NULL)
+      *len = str_len;
+  }
+
+  return retval;
+}
+
+
+/// Scan the string at \p cur into the struct field bound by the field
+/// schema entry \p js, as \ref EASYJSONPARSER_STR_FIELD.
+
+int easyjsonparser_scan_str_field (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+{
+  char * val = NULL;
+  size_t len = 0;
+  int retval = easyjsonparser_scan_str(cur, js, stack, &val, &len);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = ejp_store_str_field(cur->ctx, js, stack, cfg, val, len);
+
+  return retval;
+}
+
+
+/// Scan the integer at \p cur for the schema entry \p js (clamped to the
+/// range of int64_t, as for \ref EASYJSONPARSER_I64).
+
+int easyjsonparser_scan_int (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, int64_t * val)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  if (native_peek_type(&st) != NATIVE_TYPE_INT)
+    return scan_mismatch(&st, cur, js, stack);
+
+  int retval = native_scan_number(&st, NATIVE_TYPE_INT, val, NULL);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    cur->p = st.p;
+
+  return retval;
+}
+
+
+/// Scan the double at \p cur for the schema entry \p js.
+
+int easyjsonparser_scan_double (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, double * val)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  if (native_peek_type(&st) != NATIVE_TYPE_DOUBLE)
+    return scan_mismatch(&st, cur, js, stack);
+
+  int retval = native_scan_number(&st, NATIVE_TYPE_DOUBLE, NULL, val);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    cur->p = st.p;
+
+  return retval;
+}
+
+
+/// Scan the boolean at \p cur for the schema entry \p js, setting \p val
+/// to 1 or 0 for true or false.
+
+int easyjsonparser_scan_bool (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, int * val)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  if (native_peek_type(&st) != NATIVE_TYPE_BOOLEAN)
+    return scan_mismatch(&st, cur, js, stack);
+
+  int truth = *st.p == 't';
+  int retval = native_scan_literal(&st, truth ? "true" : "false");
+  if (retval == EASYJSONPARSER_SUCCESS) {
+    cur->p = st.p;
+    *val   = truth;
+  }
+
+  return retval;
+}
+
+
+/// Scan the null at \p cur for the schema entry \p js.
+
+int easyjsonparser_scan_null (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack)
+{
+  native_state st;
+  cursor_state(&st, cur, cur->p);
+
+  if (native_peek_type(&st) != NATIVE_TYPE_NULL)
+    return scan_mismatch(&st, cur, js, stack);
+
+  int retval = native_scan_literal(&st, "null");
+  if (retval == EASYJSONPARSER_SUCCESS)
+    cur->p = st.p;
+
+  return retval;
+}
+
+
+/// Look ahead in the object at \p p for the keys of the map entries among
+/// the list schema entries from \p js up to \p last, setting \p alt to
+/// the first of them whose key the object has (and leaving it alone if
+/// there is none), in one scan of the object whatever the number of
+/// entries. The current position (and the structural index) are left
+/// alone.
+
+int native_keyed_alt (native_state * st, const char * p, easyjsonparser_schema * js, easyjsonparser_schema * last, easyjsonparser_schema ** alt)
+{
+  easyjsonparser_cursor map;
+  map.ctx = st->ctx;
+  map.buf = st->buf;
+  map.end = st->end;
+
+  native_state ks;
+  cursor_state(&ks, &map, p + 1);
+  native_skip_ws(&ks);
+  if (ks.p < ks.end && *ks.p == '}')
+    return EASYJSONPARSER_SUCCESS;
+
+  for (;;) {
+    const char * key_at = ks.p;
+    if (ks.p >= ks.end || *ks.p != '"')
+      return native_syntax_error(&ks, "an object key");
+
+    // Keys without escapes are compared in place, the rest unescaped.
+    const char * key = ks.p + 1;
+    const char * q   = native_find_quote_or_bs(key, ks.end);
+    size_t key_len;
+    int retval;
+    if (q < ks.end && *q == '"') {
+      key_len = q - key;
+    } else {
+      char * scanned;
+      if ((retval = native_scan_string(&ks, &scanned, &key_len, NULL)) != EASYJSONPARSER_SUCCESS)
+        return retval;
+      key  = scanned;
+      ks.p = key_at;
+    }
+
+    // Only entries before the best match so far are of any more interest.
+    for (easyjsonparser_schema * e = js; e < last; e++) {
+      if (e->key != NULL && ejp_schema_accepts(e, EASYJSONPARSER_SCHEMA_MAP)
+          && strlen(e->key) == key_len && memcmp(e->key, key, key_len) == 0) {
+        *alt = last = e;
+        break;
+      }
+    }
+    if (last == js)
+      return EASYJSONPARSER_SUCCESS;
+
+    if ((retval = cursor_skip_key(&ks)) != EASYJSONPARSER_SUCCESS
+        || (retval = native_skip_value(&ks)) != EASYJSONPARSER_SUCCESS)
+      return retval;
+
+    native_skip_ws(&ks);
+    if (ks.p < ks.end && *ks.p == ',') {
+      ks.p++;
+      native_skip_ws(&ks);
+    } else if (ks.p < ks.end && *ks.p == '}') {
+      return EASYJSONPARSER_SUCCESS;
+    } else {
+      return native_syntax_error(&ks, "',' or '}'");
+    }
+  }
+}
@@ -0,0 +1,436 @@
+/// \file
+/// \brief Schema compilation.
+///
+/// A compiled schema is a copy of the source schema arrays, validated once
+/// up front, in which every array of schema entries is preceded by a hidden
+/// entry whose data points to an index of the keys of the array. The index
+/// is a perfect hash table of length prefixed keys, so finding the schema
+/// entry for a key costs one hash and at most one comparison however many
+/// keys the map allows. For the root array the root entry itself doubles
+/// as the hidden entry.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "easyjsonparser_internal.h"
+
+
+/// Seeds tried for a perfect hash at a given table size, before the table
+/// size is doubled.
+
+#define SCHEMA_HASH_SEED_TRIES 64
+
+/// Schema type of the hidden entry which precedes every array of schema
+/// entries in a compiled schema (never seen by the walkers).
+
+#define SCHEMA_IDX 0x00ff
+
+
+/// One slot of a map key index, empty if \p entry is NULL.
+
+typedef struct {
+  size_t                  len;
+  const char *            key;
+  easyjsonparser_schema * entry;
+} schema_key_slot;
+
+/// Map key index, see \ref ejp_schema_lookup.
+
+typedef struct {
+  uint32_t        mask;
+  uint32_t        seed;
+  uint32_t        count;
+  schema_key_slot slots[];
+} schema_key_index;
+
+/// The allocation behind a compiled schema, the root array is returned to
+/// the caller and everything else allocated is listed so it can be freed.
+
+typedef struct {
+  void **                 allocs;
+  size_t                  allocs_len;
+  size_t                  allocs_size;
+  easyjsonparser_schema * (*seen)[2];
+  size_t                  seen_len;
+  size_t                  seen_size;
+  easyjsonparser_schema   root[];
+} schema_compiled;
+
+
+/// Local function declarations.
+
+static int    schema_compile_entries (easyjsonparser_ctx * ctx, schema_compiled * sc, easyjsonparser_schema * src, easyjsonparser_schema * idx_entry, easyjsonparser_schema * dst, easyjsonparser_stack * stack);
+static int    schema_compile_child (easyjsonparser_ctx * ctx, schema_compiled * sc, easyjsonparser_schema * src, easyjsonparser_schema ** dst, easyjsonparser_stack * stack);
+static int    schema_index_keys (easyjsonparser_ctx * ctx, schema_compiled * sc, easyjsonparser_schema * idx_entry, easyjsonparser_schema * entries, size_t n);
+static int    schema_track (easyjsonparser_ctx * ctx, schema_compiled * sc, void * alloc);
+static void   schema_compiled_free (schema_compiled * sc);
+static size_t schema_entries_len (easyjsonparser_schema * js);
+static int    schema_type_valid (int type);
+
+
+/// Compile the schema \p js, returning a compiled copy which may be used
+/// in place of the original with any of the parse functions, or NULL if the
+/// schema is invalid (the error handler is called with the problem). The
+/// keys, descriptions and callbacks of the original are referred to, not
+/// copied, so they must outlive the compiled schema.
+
+easyjsonparser_schema * easyjsonparser_schema_compile (easyjsonparser_schema * js)
+{
+  easyjsonparser_ctx ctx;
+  ejp_ctx_init(&ctx);
+
+  easyjsonparser_stack stack;
+  stack.key  = NULL;
+  stack.prev = NULL;
+  stack.ctx  = &ctx;
+
+  int root_type = js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+  int nested    = root_type == EASYJSONPARSER_SCHEMA_MAP || root_type == EASYJSONPARSER_SCHEMA_LST;
+  size_t n      = nested ? schema_entries_len(js + 1) : 0;
+
+  schema_compiled * sc = (schema_compiled *) calloc(1, sizeof(schema_compiled) + (n + 2) * sizeof(easyjsonparser_schema));
+  if (sc == NULL) {
+    ejp_error_handler(&ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                      "out of memory",
+                      "could not allocate compiled schema");
+    ejp_ctx_release(&ctx);
+    return NULL;
+  }
+
+  int retval;
+  if (!(js->type & EASYJSONPARSER_SCHEMA_ROO) || !schema_type_valid(root_type)) {
+    void * data[3] = {js, "/", NULL};
+    ejp_error_handler(&ctx, EASYJSONPARSER_ERROR_SCHEMA_INVALID, data,
+                      "schema invalid",
+                      "schema has invalid/corrupt type %d at %s",
+                      js->type, "/");
+    retval = EASYJSONPARSER_ERROR_SCHEMA_INVALID;
+  } else if (nested) {
+    retval = schema_compile_entries(&ctx, sc, js + 1, sc->root, sc->root + 1, &stack);
+  } else {
+    retval = EASYJSONPARSER_SUCCESS;
+  }
+
+  free(sc->seen);
+  sc->seen = NULL;
+
+  if (retval != EASYJSONPARSER_SUCCESS) {
+    schema_compiled_free(sc);
+    ejp_ctx_release(&ctx);
+    return NULL;
+  }
+
+  sc->root[0].key   = js->key;
+  sc->root[0].type  = js->type | EASYJSONPARSER_SCHEMA_CMP;
+  sc->root[0].descr = js->descr;
+  if (!nested)
+    sc->root[0].data = js->data;
+
+  ejp_ctx_release(&ctx);
+
+  return sc->root;
+}
+
+
+/// Free a schema returned by \ref easyjsonparser_schema_compile.
+
+void easyjsonparser_schema_free (easyjsonparser_schema * js)
+{
+  if (js == NULL)
+    return;
+
+  schema_compiled_free((schema_compiled *) ((char *) js - offsetof(schema_compiled, root)));
+}
+
+
+/// Find the schema entry for \p key (\p key_len bytes long) in the schema
+/// entry array \p js, which must be part of a compiled schema. NULL is
+/// returned if the key is not in the schema.
+
+easyjsonparser_schema * ejp_schema_lookup (easyjsonparser_schema * js, const char * key, size_t key_len)
+{
+  schema_key_index * idx = (schema_key_index *) js[-1].data;
+  if (idx == NULL)
+    return NULL;
+
+  schema_key_slot * slot = &idx->slots[ejp_hash(key, key_len, idx->seed) & idx->mask];
+
+  return slot->entry != NULL && slot->len == key_len && memcmp(slot->key, key, key_len) == 0
+    ? slot->entry
+    : NULL;
+}
+
+
+/// Return the number of different keys in the fixed key map schema entry
+/// array \p js, which must be part of a compiled schema, or 0 if it has
+/// none, or more than \ref EJP_TRACK_MAX entries.
+
+size_t ejp_schema_key_count (easyjsonparser_schema * js)
+{
+  schema_key_index * idx = (schema_key_index *) js[-1].data;
+
+  return idx != NULL ? idx->count : 0;
+}
+
+
+/// Return 1 if the schema entry \p js takes a JSON value of \p type, given
+/// as the schema entry type for it (\ref EASYJSONPARSER_SCHEMA_MAP,
+/// \ref EASYJSONPARSER_SCHEMA_STR and so on, integers being
+/// \ref EASYJSONPARSER_SCHEMA_INT), or 0 if not. Used to route each element
+/// of a list to the entries for its type.
+
+int ejp_schema_accepts (easyjsonparser_schema * js, int type)
+{
+  if (js->type & EASYJSONPARSER_SCHEMA_ARR)
+    return type == EASYJSONPARSER_SCHEMA_LST;
+
+  int js_type = js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+
+  return js_type == type || (js_type == EASYJSONPARSER_SCHEMA_I64 && type == EASYJSONPARSER_SCHEMA_INT);
+}
+
+
+/// Validate and copy the \p src schema entry array into \p dst, which has
+/// room for it, compiling any children and indexing the keys in
+/// \p idx_entry (the hidden entry before \p dst).
+
+int schema_compile_entries (easyjsonparser_ctx * ctx, schema_compiled * sc, easyjsonparser_schema * src, easyjsonparser_schema * idx_entry, easyjsonparser_schema * dst, easyjsonparser_stack * stack)
+{
+  size_t n = 0;
+
+  for (; src[n].type != EASYJSONPARSER_SCHEMA_END; n++) {
+    easyjsonparser_schema * js = &src[n];
+    dst[n] = *js;
+
+    easyjsonparser_stack stack2;
+    stack2.key  = js->key != NULL ? js->key : "*";
+    stack2.prev = stack;
+    stack2.ctx  = ctx;
+
+    if (!schema_type_valid(js->type)) {
+      char * stack_path = ejp_error_path(ctx, &stack2);
+      void * data[3] = {js, stack_path, NULL};
+      ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_INVALID, data,
+                        "schema invalid",
+                        "schema has invalid/corrupt type %d at %s",
+                        js->type, stack_path);
+      return EASYJSONPARSER_ERROR_SCHEMA_INVALID;
+    }
+
+    if ((js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_MAP || js->type == EASYJSONPARSER_SCHEMA_LST) {
+      easyjsonparser_schema * child = NULL;
+      int retval = schema_compile_child(ctx, sc, js, &child, &stack2);
+      if (retval != EASYJSONPARSER_SUCCESS)
+        return retval;
+      dst[n].data = child;
+    }
+  }
+
+  idx_entry->type = SCHEMA_IDX;
+
+  // A map of a single NULL key entry is a variable key map, and lists have
+  // no keys, neither need an index.
+  if (n == 0 || (n == 1 && dst[0].key == NULL))
+    return EASYJSONPARSER_SUCCESS;
+
+  return schema_index_keys(ctx, sc, idx_entry, dst, n);
+}
+
+
+/// Compile the child schema entry array of the map or list schema entry
+/// \p src, setting \p dst to the compiled copy. A child array shared by
+/// several entries (or by itself, recursively) is only compiled once.
+
+int schema_compile_child (easyjsonparser_ctx * ctx, schema_compiled * sc, easyjsonparser_schema * src, easyjsonparser_schema ** dst, easyjsonparser_stack * stack)
+{
+  easyjsonparser_schema * children = (easyjsonparser_schema *) src->data;
+
+  if (children == NULL) {
+    char * stack_path = ejp_error_path(ctx, stack);
+    void * data[3] = {src, stack_path, NULL};
+    ejp_error_handler(ctx, EASYJSONPARSER_ERROR_SCHEMA_NOCHILDREN, data,
+                      "schema has no children",
+                      "%s (%s) has no child schema at %s",
+                      src->key, src->descr, stack_path);
+    return EASYJSONPARSER_ERROR_SCHEMA_NOCHILDREN;
+  }
+
+  for (size_t i = 0; i < sc->seen_len; i++)
+    if (sc->seen[i][0] == children) {
+      *dst = sc->seen[i][1];
+      return EASYJSONPARSER_SUCCESS;
+    }
+
+  size_t n = schema_entries_len(children);
+  easyjsonparser_schema * block = (easyjsonparser_schema *) calloc(n + 2, sizeof(easyjsonparser_schema));
+  if (block == NULL)
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                             "out of memory",
+                             "could not allocate compiled schema");
+
+  int retval = schema_track(ctx, sc, block);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  if (sc->seen_len == sc->seen_size) {
+    size_t new_size = sc->seen_size ? sc->seen_size * 2 : 16;
+    easyjsonparser_schema * (*new_seen)[2] = realloc(sc->seen, new_size * sizeof(*sc->seen));
+    if (new_seen == NULL)
+      return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                               "out of memory",
+                               "could not allocate compiled schema");
+    sc->seen      = new_seen;
+    sc->seen_size = new_size;
+  }
+  sc->seen[sc->seen_len][0] = children;
+  sc->seen[sc->seen_len][1] = block + 1;
+  sc->seen_len++;
+
+  *dst = block + 1;
+
+  return schema_compile_entries(ctx, sc, children, block, block + 1, stack);
+}
+
+
+/// Build the perfect hash index of the keys of the \p n schema entries at
+/// \p entries and hang it off \p idx_entry. The smallest power of two table
+/// at least twice the number of keys for which one of a few seeds hashes
+/// every key to a different slot is used.
+
+int schema_index_keys (easyjsonparser_ctx * ctx, schema_compiled * sc, easyjsonparser_schema * idx_entry, easyjsonparser_schema * entries, size_t n)
+{
+  uint32_t size = 4;
+  while (size < n * 2)
+    size *= 2;
+
+  for (;;) {
+    schema_key_index * idx = (schema_key_index *) malloc(sizeof(schema_key_index) + size * sizeof(schema_key_slot));
+    if (idx == NULL)
+      return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                               "out of memory",
+                               "could not allocate compiled schema");
+
+    idx->mask = size - 1;
+
+    for (uint32_t seed = 0; seed < SCHEMA_HASH_SEED_TRIES; seed++) {
+      idx->seed  = seed;
+      idx->count = 0;
+      memset(idx->slots, 0, size * sizeof(schema_key_slot));
+
+      size_t i;
+      for (i = 0; i < n; i++) {
+        if (entries[i].key == NULL)
+          continue;
+
+        size_t len = strlen(entries[i].key);
+        schema_key_slot * slot = &idx->slots[ejp_hash(entries[i].key, len, seed) & idx->mask];
+
+        // Only the first of duplicate keys is ever matched, as before.
+        if (slot->entry != NULL && slot->len == len && memcmp(slot->key, entries[i].key, len) == 0)
+          continue;
+        if (slot->entry != NULL)
+          break;
+
+        slot->len   = len;
+        slot->key   = entries[i].key;
+        slot->entry = &entries[i];
+        idx->count++;
+      }
+
+      if (i == n) {
+        if (n > EJP_TRACK_MAX)
+          idx->count = 0;
+        int retval = schema_track(ctx, sc, idx);
+        if (retval == EASYJSONPARSER_SUCCESS)
+          idx_entry->data = idx;
+        return retval;
+      }
+    }
+
+    free(idx);
+    size *= 2;
+  }
+}
+
+
+/// Record an allocation belonging to the compiled schema.
+
+int schema_track (easyjsonparser_ctx * ctx, schema_compiled * sc, void * alloc)
+{
+  if (sc->allocs_len == sc->allocs_size) {
+    size_t new_size = sc->allocs_size ? sc->allocs_size * 2 : 16;
+    void ** new_allocs = (void **) realloc(sc->allocs, new_size * sizeof(void *));
+    if (new_allocs == NULL) {
+      free(alloc);
+      return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                               "out of memory",
+                               "could not allocate compiled schema");
+    }
+    sc->allocs      = new_allocs;
+    sc->allocs_size = new_size;
+  }
+
+  sc->allocs[sc->allocs_len++] = alloc;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Free a compiled schema and everything allocated for it.
+
+void schema_compiled_free (schema_compiled * sc)
+{
+  for (size_t i = 0; i < sc->allocs_len; i++)
+    free(sc->allocs[i]);
+
+  free(sc->allocs);
+  free(sc->seen);
+  free(sc);
+}
+
+
+/// Count the entries of a schema entry array, not including the end.
+
+size_t schema_entries_len (easyjsonparser_schema * js)
+{
+  size_t n = 0;
+  while (js[n].type != EASYJSONPARSER_SCHEMA_END)
+    n++;
+
+  return n;
+}
+
+
+/// True if \p type is a valid schema entry type.
+
+int schema_type_valid (int type)
+{
+  switch (type) {
+  case EASYJSONPARSER_SCHEMA_STR:
+  case EASYJSONPARSER_SCHEMA_INT:
+  case EASYJSONPARSER_SCHEMA_DBL:
+  case EASYJSONPARSER_SCHEMA_BOO:
+  case EASYJSONPARSER_SCHEMA_I64:
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_VEW:
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_ITN:
+  case EASYJSONPARSER_SCHEMA_STR | EASYJSONPARSER_SCHEMA_FLD:
+  case EASYJSONPARSER_SCHEMA_INT | EASYJSONPARSER_SCHEMA_FLD:
+  case EASYJSONPARSER_SCHEMA_DBL | EASYJSONPARSER_SCHEMA_FLD:
+  case EASYJSONPARSER_SCHEMA_BOO | EASYJSONPARSER_SCHEMA_FLD:
+  case EASYJSONPARSER_SCHEMA_I64 | EASYJSONPARSER_SCHEMA_FLD:
+  case EASYJSONPARSER_SCHEMA_I64 | EASYJSONPARSER_SCHEMA_ARR:
+  case EASYJSONPARSER_SCHEMA_DBL | EASYJSONPARSER_SCHEMA_ARR:
+  case EASYJSONPARSER_SCHEMA_MAP:
+  case EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN:
+  case EASYJSONPARSER_SCHEMA_LST:
+  case EASYJSONPARSER_SCHEMA_NUL:
+    return 1;
+
+  default:
+    return 0;
+  }
+}
@@ -0,0 +1,269 @@
+/// \file
+/// \brief UTF-8 validation.
+///
+/// JSON text must be UTF-8, so unless the context is told the input can be
+/// trusted (see \ref easyjsonparser_ctx_set_options) it is validated before
+/// it is parsed. Almost all JSON is almost all ASCII, so runs of ASCII are
+/// stepped over a vector at a time, and only the bytes of multibyte
+/// sequences are looked at one by one, each sequence being checked against
+/// the table of well formed sequences in the Unicode standard (so overlong
+/// forms, surrogates and anything beyond U+10FFFF are rejected).
+///
+/// The instruction set is chosen at run time as for the structural index
+/// (see easyjsonparser_index.c), AVX2, SSE2 or else eight bytes at a time
+/// in a plain 64 bit word.
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+
+#if defined(HAVE_AVX2_DISPATCH) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "easyjsonparser_internal.h"
+
+
+/// Local function declarations.
+
+static int    utf8_validate_scalar (const unsigned char * buf, const unsigned char * end, size_t * offset);
+#ifdef __SSE2__
+static int    utf8_validate_sse2 (const unsigned char * buf, const unsigned char * end, size_t * offset);
+#endif
+#ifdef HAVE_AVX2_DISPATCH
+static int    utf8_validate_avx2 (const unsigned char * buf, const unsigned char * end, size_t * offset);
+#endif
+
+
+/// Validate the \p len bytes at \p buf as UTF-8, returning 1 if they are,
+/// or 0 if not, setting \p offset to that of the first byte of the first
+/// sequence which is not well formed.
+
+int ejp_utf8_validate (easyjsonparser_ctx * ctx, const char * buf, size_t len, size_t * offset)
+{
+  const unsigned char * p   = (const unsigned char *) buf;
+  const unsigned char * end = p + len;
+
+#ifdef HAVE_AVX2_DISPATCH
+  if (ctx->isa >= EJP_ISA_AVX2 && __builtin_cpu_supports("avx2"))
+    return utf8_validate_avx2(p, end, offset);
+#endif
+#ifdef __SSE2__
+  if (ctx->isa >= EJP_ISA_SSE2)
+    return utf8_validate_sse2(p, end, offset);
+#endif
+
+  return utf8_validate_scalar(p, end, offset);
+}
+
+
+/// Report the input as not UTF-8 at \p offset, returning what the error
+/// handler returns.
+
+int ejp_utf8_error (easyjsonparser_ctx * ctx, size_t offset)
+{
+  return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_PARSE_UTF8, &offset,
+                           "invalid UTF-8",
+                           "could not parse JSON (invalid UTF-8 at offset %zu)",
+                           offset);
+}
+
+
+/// Return the length of the multibyte sequence \p c leads, or 0 if it
+/// can't lead one.
+
+static inline size_t utf8_sequence_len (unsigned char c)
+{
+  if (c >= 0xc2 && c <= 0xdf)
+    return 2;
+  if (c >= 0xe0 && c <= 0xef)
+    return 3;
+  if (c >= 0xf0 && c <= 0xf4)
+    return 4;
+  return 0;
+}
+
+
+/// Return the length of the well formed multibyte sequence at \p p, or 0
+/// if it is not one (including if it is cut short by \p end).
+
+static inline int utf8_sequence (const unsigned char * p, const unsigned char * end)
+{
+  unsigned char c  = p[0];
+  unsigned char lo = 0x80;
+  unsigned char hi = 0xbf;
+  int n;
+
+  if (c >= 0xc2 && c <= 0xdf) {
+    n = 2;
+  } else if (c >= 0xe0 && c <= 0xef) {
+    n = 3;
+    if (c == 0xe0)
+      lo = 0xa0;
+    else if (c == 0xed)
+      hi = 0x9f;
+  } else if (c >= 0xf0 && c <= 0xf4) {
+    n = 4;
+    if (c == 0xf0)
+      lo = 0x90;
+    else if (c == 0xf4)
+      hi = 0x8f;
+  } else {
+    return 0;
+  }
+
+  if (end - p < n || p[1] < lo || p[1] > hi)
+    return 0;
+  for (int i = 2; i < n; i++)
+    if ((p[i] & 0xc0) != 0x80)
+      return 0;
+
+  return n;
+}
+
+
+/// Validate the \p len bytes at \p buf as the next piece of the input
+/// \p s is validating, returning as \ref ejp_utf8_validate, but with
+/// \p offset counted from the start of the input. A sequence cut short by
+/// the end of the piece is kept back, to be checked once the next piece
+/// completes it.
+
+int ejp_utf8_validate_stream (easyjsonparser_ctx * ctx, ejp_utf8_stream * s, const char * buf, size_t len, size_t * offset)
+{
+  size_t used = 0;
+
+  if (s->tail_len > 0) {
+    size_t n = utf8_sequence_len(s->tail[0]);
+    while (s->tail_len < n && used < len)
+      s->tail[s->tail_len++] = (unsigned char) buf[used++];
+    if (s->tail_len < n)
+      return 1;
+    if (utf8_sequence(s->tail, s->tail + n) == 0) {
+      *offset = s->offset;
+      return 0;
+    }
+    s->offset  += n;
+    s->tail_len = 0;
+  }
+
+  if (ejp_utf8_validate(ctx, buf + used, len - used, offset)) {
+    s->offset += len - used;
+    return 1;
+  }
+
+  const unsigned char * bad  = (const unsigned char *) buf + used + *offset;
+  size_t                rest = len - used - *offset;
+  if (rest < utf8_sequence_len(*bad)) {
+    memcpy(s->tail, bad, rest);
+    s->tail_len = rest;
+    s->offset  += *offset;
+    return 1;
+  }
+
+  *offset += s->offset;
+  return 0;
+}
+
+
+/// Validate from \p p to \p end, stepping over runs of ASCII with
+/// \p skip_ascii, which returns the first byte at or after its first
+/// argument with the top bit set (or the end).
+
+__attribute__((always_inline))
+static inline int utf8_validate (const unsigned char * p, const unsigned char * end, size_t * offset, const unsigned char * (*skip_ascii)(const unsigned char *, const unsigned char *))
+{
+  const unsigned char * buf = p;
+
+  while ((p = skip_ascii(p, end)) < end) {
+    do {
+      int n = utf8_sequence(p, end);
+      if (n == 0) {
+        *offset = p - buf;
+        return 0;
+      }
+      p += n;
+    } while (p < end && *p >= 0x80);
+  }
+
+  return 1;
+}
+
+
+/// Skip ASCII eight bytes at a time.
+
+static inline const unsigned char * utf8_skip_ascii_scalar (const unsigned char * p, const unsigned char * end)
+{
+  for (; end - p >= 8; p += 8) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    if (w & 0x8080808080808080ull)
+      break;
+  }
+  while (p < end && *p < 0x80)
+    p++;
+
+  return p;
+}
+
+int utf8_validate_scalar (const unsigned char * buf, const unsigned char * end, size_t * offset)
+{
+  return utf8_validate(buf, end, offset, utf8_skip_ascii_scalar);
+}
+
+
+#ifdef __SSE2__
+
+/// Skip ASCII sixteen bytes at a time.
+
+static inline const unsigned char * utf8_skip_ascii_sse2 (const unsigned char * p, const unsigned char * end)
+{
+  for (; end - p >= 16; p += 16) {
+    int m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) p));
+    if (m != 0)
+      return p + __builtin_ctz(m);
+  }
+
+  return utf8_skip_ascii_scalar(p, end);
+}
+
+int utf8_validate_sse2 (const unsigned char * buf, const unsigned char * end, size_t * offset)
+{
+  return utf8_validate(buf, end, offset, utf8_skip_ascii_sse2);
+}
+
+#endif // __SSE2__
+
+
+#ifdef HAVE_AVX2_DISPATCH
+
+/// Skip ASCII sixty four bytes at a time (two vectors tested together),
+/// then thirty two.
+
+__attribute__((target("avx2")))
+static inline const unsigned char * utf8_skip_ascii_avx2 (const unsigned char * p, const unsigned char * end)
+{
+  for (; end - p >= 64; p += 64) {
+    __m256i a = _mm256_loadu_si256((const __m256i *) p);
+    __m256i b = _mm256_loadu_si256((const __m256i *) (p + 32));
+    if (_mm256_movemask_epi8(_mm256_or_si256(a, b)) != 0)
+      break;
+  }
+  for (; end - p >= 32; p += 32) {
+    uint32_t m = (uint32_t) _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *) p));
+    if (m != 0)
+      return p + __builtin_ctz(m);
+  }
+
+  return utf8_skip_ascii_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+int utf8_validate_avx2 (const unsigned char * buf, const unsigned char * end, size_t * offset)
+{
+  return utf8_validate(buf, end, offset, utf8_skip_ascii_avx2);
+}
+
+#endif // HAVE_AVX2_DISPATCH
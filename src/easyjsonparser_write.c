@@ -0,0 +1,711 @@
+/// \file
+/// \brief JSON writer, driven by the same schemas as the parsers.
+///
+/// The schema is walked just as a parse would walk it, but values are taken
+/// rather than given: field entries are read from the struct the config
+/// pointer points to (as the parse would store them), and every other entry
+/// is asked of a getter callback. Lists, typed arrays and variable key maps
+/// have no fixed length in the schema, so the getter is asked for element
+/// after element until it says there are no more.
+///
+/// Output goes to a buffer which is grown as needed, or to one of fixed
+/// size provided by the caller, or to a buffer which is flushed to a file
+/// descriptor whenever it fills. Strings are copied a run at a time between
+/// the bytes which must be escaped, found a vector at a time (with the
+/// instruction set chosen at run time as for the structural index, see
+/// easyjsonparser_index.c), and numbers are formatted as in
+/// easyjsonparser_number.c.
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "config.h"
+
+#if defined(HAVE_AVX2_DISPATCH) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "easyjsonparser_internal.h"
+
+
+#define WRITE_GROW  0
+#define WRITE_FIXED 1
+#define WRITE_FD    2
+
+
+/// Writer state, for one document.
+
+typedef struct write_state {
+  easyjsonparser_ctx *  ctx;
+  int                   (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *);
+  char *                buf;
+  size_t                len;
+  size_t                size;
+  int                   kind;
+  int                   fd;
+  size_t                depth;
+  const unsigned char * (*find_special)(const unsigned char *, const unsigned char *);
+} write_state;
+
+
+/// Local function declarations.
+
+static void   write_init (write_state * ws, easyjsonparser_ctx * ctx, int kind, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *));
+static int    write_document (write_state * ws, easyjsonparser_schema * js, void * cfg);
+static int    write_get (write_state * ws, easyjsonparser_schema * js, easyjsonparser_stack * stack, size_t n, easyjsonparser_value * val, void * cfg, int * type);
+static int    write_value (write_state * ws, int type, easyjsonparser_stack * stack, easyjsonparser_value * val);
+static int    write_map (write_state * ws, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
+static int    write_list (write_state * ws, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);
+static int    write_str (write_state * ws, const char * str, size_t len);
+static int    write_spill (write_state * ws, const char * data, size_t len);
+static int    write_flush (write_state * ws, const char * data, size_t len);
+static int    write_enter (write_state * ws, easyjsonparser_stack * stack);
+static int    write_unwritable (write_state * ws, easyjsonparser_schema * js, easyjsonparser_stack * stack, const char * why);
+static const unsigned char * write_find_special_scalar (const unsigned char * p, const unsigned char * end);
+#ifdef __SSE2__
+static const unsigned char * write_find_special_sse2 (const unsigned char * p, const unsigned char * end);
+#endif
+#ifdef HAVE_AVX2_DISPATCH
+static const unsigned char * write_find_special_avx2 (const unsigned char * p, const unsigned char * end);
+#endif
+
+
+/// Write the JSON for \p cfg as described by the schema \p js (with a
+/// context private to this call), see \ref easyjsonparser_ctx_write.
+
+int easyjsonparser_write (char ** out, size_t * len, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *))
+{
+  easyjsonparser_ctx ctx;
+  ejp_ctx_init(&ctx);
+
+  int retval = easyjsonparser_ctx_write(&ctx, out, len, js, cfg, getter);
+
+  ejp_ctx_release(&ctx);
+  return retval;
+}
+
+
+/// Write the JSON for \p cfg into \p buf (with a context private to this
+/// call), see \ref easyjsonparser_ctx_write_buffer.
+
+int easyjsonparser_write_buffer (char * buf, size_t size, size_t * len, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *))
+{
+  easyjsonparser_ctx ctx;
+  ejp_ctx_init(&ctx);
+
+  int retval = easyjsonparser_ctx_write_buffer(&ctx, buf, size, len, js, cfg, getter);
+
+  ejp_ctx_release(&ctx);
+  return retval;
+}
+
+
+/// Write the JSON for \p cfg to the file descriptor \p fd (with a context
+/// private to this call), see \ref easyjsonparser_ctx_write_fd.
+
+int easyjsonparser_write_fd (int fd, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *))
+{
+  easyjsonparser_ctx ctx;
+  ejp_ctx_init(&ctx);
+
+  int retval = easyjsonparser_ctx_write_fd(&ctx, fd, js, cfg, getter);
+
+  ejp_ctx_release(&ctx);
+  return retval;
+}
+
+
+/// Write the JSON for \p cfg as described by the schema \p js into a zero
+/// byte terminated buffer allocated with malloc, setting \p out to it (the
+/// caller frees it) and \p len (if not NULL) to its length, not counting
+/// the zero byte. On error \p out is set to NULL.
+
+int easyjsonparser_ctx_write (easyjsonparser_ctx * ctx, char ** out, size_t * len, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *))
+{
+  write_state ws;
+  write_init(&ws, ctx, WRITE_GROW, getter);
+
+  int retval = write_document(&ws, js, cfg);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = write_spill(&ws, "", 1);
+
+  if (retval != EASYJSONPARSER_SUCCESS) {
+    free(ws.buf);
+    *out = NULL;
+    return retval;
+  }
+
+  *out = ws.buf;
+  if (len != NULL)
+    *len = ws.len - 1;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Write the JSON for \p cfg as described by the schema \p js into the
+/// \p size bytes at \p buf, zero byte terminated, setting \p len (if not
+/// NULL) to its length, not counting the zero byte. If it does not fit
+/// (with the zero byte) the error is EASYJSONPARSER_ERROR_WRITE_OVERFLOW,
+/// and what is in \p buf is undefined.
+
+int easyjsonparser_ctx_write_buffer (easyjsonparser_ctx * ctx, char * buf, size_t size, size_t * len, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *))
+{
+  write_state ws;
+  write_init(&ws, ctx, WRITE_FIXED, getter);
+  ws.buf  = buf;
+  ws.size = size;
+
+  int retval = write_document(&ws, js, cfg);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = write_spill(&ws, "", 1);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  if (len != NULL)
+    *len = ws.len - 1;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Write the JSON for \p cfg as described by the schema \p js to the file
+/// descriptor \p fd, buffering it and flushing the buffer each time it
+/// fills. On error some of the JSON may have been written already.
+
+int easyjsonparser_ctx_write_fd (easyjsonparser_ctx * ctx, int fd, easyjsonparser_schema * js, void * cfg, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *))
+{
+  write_state ws;
+  write_init(&ws, ctx, WRITE_FD, getter);
+  ws.fd   = fd;
+  ws.size = EJP_WRITE_BUFFER;
+
+  if ((ws.buf = (char *) malloc(ws.size)) == NULL)
+    return ejp_error_handler(ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                             "out of memory",
+                             "could not allocate %zu bytes to write JSON", ws.size);
+
+  int retval = write_document(&ws, js, cfg);
+  if (retval == EASYJSONPARSER_SUCCESS)
+    retval = write_flush(&ws, ws.buf, ws.len);
+
+  free(ws.buf);
+  return retval;
+}
+
+
+void write_init (write_state * ws, easyjsonparser_ctx * ctx, int kind, int (*getter)(easyjsonparser_stack *, easyjsonparser_schema *, size_t, easyjsonparser_value *, void *))
+{
+  ws->ctx    = ctx;
+  ws->getter = getter;
+  ws->buf    = NULL;
+  ws->len    = 0;
+  ws->size   = 0;
+  ws->kind   = kind;
+  ws->fd     = -1;
+  ws->depth  = 0;
+
+  ws->find_special = write_find_special_scalar;
+#ifdef __SSE2__
+  if (ctx->isa >= EJP_ISA_SSE2)
+    ws->find_special = write_find_special_sse2;
+#endif
+#ifdef HAVE_AVX2_DISPATCH
+  if (ctx->isa >= EJP_ISA_AVX2 && __builtin_cpu_supports("avx2"))
+    ws->find_special = write_find_special_avx2;
+#endif
+}
+
+
+/// Write the document, its root being a map or list written from \p cfg
+/// itself, or a scalar (asked of the getter).
+
+int write_document (write_state * ws, easyjsonparser_schema * js, void * cfg)
+{
+  EJP_TRACE(ws->ctx, "JSON root writing");
+
+  easyjsonparser_stack stack;
+  stack.key  = NULL;
+  stack.prev = NULL;
+  stack.ctx  = ws->ctx;
+
+  easyjsonparser_schema root = *js;
+  root.type &= EASYJSONPARSER_SCHEMA_TYPE_BITS;
+  root.data  = js + 1;
+
+  if (root.type == EASYJSONPARSER_SCHEMA_MAP)
+    return write_map(ws, &root, &stack, cfg);
+  if (root.type == EASYJSONPARSER_SCHEMA_LST)
+    return write_list(ws, &root, &stack, cfg);
+
+  easyjsonparser_value val;
+  int type;
+  int retval = write_get(ws, js, &stack, 0, &val, cfg, &type);
+  if (retval == EASYJSONPARSER_WRITE_NONE)
+    return write_unwritable(ws, js, &stack, "no value");
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  return write_value(ws, type, &stack, &val);
+}
+
+
+/// Append \p len bytes at \p data to the output.
+
+static inline int write_out (write_state * ws, const char * data, size_t len)
+{
+  if (len > ws->size - ws->len)
+    return write_spill(ws, data, len);
+
+  memcpy(ws->buf + ws->len, data, len);
+  ws->len += len;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Append the one byte \p c to the output.
+
+static inline int write_byte (write_state * ws, char c)
+{
+  if (ws->len == ws->size)
+    return write_spill(ws, &c, 1);
+
+  ws->buf[ws->len++] = c;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Append \p len bytes at \p data to the output when they do not fit in the
+/// buffer as it is, growing it, or flushing it, or failing if it is the
+/// caller's.
+
+int write_spill (write_state * ws, const char * data, size_t len)
+{
+  if (ws->kind == WRITE_FIXED) {
+    if (len <= ws->size - ws->len) {
+      memcpy(ws->buf + ws->len, data, len);
+      ws->len += len;
+      return EASYJSONPARSER_SUCCESS;
+    }
+    return ejp_error_handler(ws->ctx, EASYJSONPARSER_ERROR_WRITE_OVERFLOW, &ws->size,
+                             "buffer too small",
+                             "could not write JSON (buffer of %zu bytes too small)", ws->size);
+  }
+
+  if (ws->kind == WRITE_FD) {
+    int retval = write_flush(ws, ws->buf, ws->len);
+    if (retval != EASYJSONPARSER_SUCCESS)
+      return retval;
+    ws->len = 0;
+    if (len > ws->size)
+      return write_flush(ws, data, len);
+    memcpy(ws->buf, data, len);
+    ws->len = len;
+    return EASYJSONPARSER_SUCCESS;
+  }
+
+  if (len > ws->size - ws->len) {
+    size_t size = ws->size == 0 ? 4096 : ws->size * 2;
+    while (size - ws->len < len)
+      size *= 2;
+    char * buf = (char *) realloc(ws->buf, size);
+    if (buf == NULL)
+      return ejp_error_handler(ws->ctx, EASYJSONPARSER_ERROR_MEMORY, NULL,
+                               "out of memory",
+                               "could not allocate %zu bytes to write JSON", size);
+    ws->buf  = buf;
+    ws->size = size;
+  }
+
+  memcpy(ws->buf + ws->len, data, len);
+  ws->len += len;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Write \p len bytes at \p data to the file descriptor, however many
+/// calls it takes.
+
+int write_flush (write_state * ws, const char * data, size_t len)
+{
+  while (len > 0) {
+    ssize_t n = write(ws->fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      int write_errno = errno;
+      return ejp_error_handler(ws->ctx, EASYJSONPARSER_ERROR_FILEWRITE, &ws->fd, strerror(write_errno),
+                               "error writing JSON (%s)", strerror(write_errno));
+    }
+    data += n;
+    len  -= n;
+  }
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Get the value of the entry \p js (if \p n is zero) or element n-1 of
+/// the list, typed array or variable key map \p js into \p val, setting
+/// \p type to the type to write it as. Returns EASYJSONPARSER_WRITE_NONE
+/// if there is no such value (or it is to be left out).
+
+int write_get (write_state * ws, easyjsonparser_schema * js, easyjsonparser_stack * stack, size_t n, easyjsonparser_value * val, void * cfg, int * type)
+{
+  int element = n > 0;
+  int array   = element && (js->type & EASYJSONPARSER_SCHEMA_ARR);
+
+  memset(val, 0, sizeof(*val));
+  val->len = EASYJSONPARSER_VALUE_STRLEN;
+  val->cfg = cfg;
+  if (!element || array)
+    val->js = js;
+  else if (((easyjsonparser_schema *) js->data)->type != EASYJSONPARSER_SCHEMA_END)
+    val->js = (easyjsonparser_schema *) js->data;
+
+  // Fields are read from the config, and without a getter maps and lists
+  // are written from the same config as their parent, while elements and
+  // other values are left out.
+  if (element || !(js->type & EASYJSONPARSER_SCHEMA_FLD)) {
+    int js_type = js->type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+    int container = (js->type & EASYJSONPARSER_SCHEMA_ARR) || js_type == EASYJSONPARSER_SCHEMA_MAP || js_type == EASYJSONPARSER_SCHEMA_LST;
+    if (ws->getter != NULL) {
+      int retval = ws->getter(stack, js, n, val, cfg);
+      if (retval != EASYJSONPARSER_SUCCESS)
+        return retval;
+    } else if (element || !container) {
+      return EASYJSONPARSER_WRITE_NONE;
+    }
+  }
+
+  easyjsonparser_schema * vjs = val->js;
+  if (vjs == NULL)
+    return write_unwritable(ws, js, stack, "no schema entry for list element");
+
+  *type = vjs->type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+  if ((vjs->type & EASYJSONPARSER_SCHEMA_ARR) && !array)
+    *type = EASYJSONPARSER_SCHEMA_LST;
+
+  if (vjs->type & EASYJSONPARSER_SCHEMA_FLD) {
+    switch (*type) {
+    case EASYJSONPARSER_SCHEMA_STR:
+      val->str = *EJP_FIELD(val->cfg, vjs, char *);
+      val->len = EASYJSONPARSER_VALUE_STRLEN;
+      break;
+    case EASYJSONPARSER_SCHEMA_INT: val->i   = *EJP_FIELD(val->cfg, vjs, int);     break;
+    case EASYJSONPARSER_SCHEMA_BOO: val->i   = *EJP_FIELD(val->cfg, vjs, int);     break;
+    case EASYJSONPARSER_SCHEMA_I64: val->i   = *EJP_FIELD(val->cfg, vjs, int64_t); break;
+    case EASYJSONPARSER_SCHEMA_DBL: val->d   = *EJP_FIELD(val->cfg, vjs, double);  break;
+    }
+  }
+
+  if (*type == EASYJSONPARSER_SCHEMA_STR) {
+    if (val->str == NULL)
+      return EASYJSONPARSER_WRITE_NONE;
+    if (val->len == EASYJSONPARSER_VALUE_STRLEN)
+      val->len = strlen(val->str);
+  } else if (*type == EASYJSONPARSER_SCHEMA_DBL && !isfinite(val->d)) {
+    int retval = write_unwritable(ws, vjs, stack, "not a finite number");
+    return retval == EASYJSONPARSER_SUCCESS ? EASYJSONPARSER_WRITE_NONE : retval;
+  }
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+/// Write the value \p val of type \p type.
+
+int write_value (write_state * ws, int type, easyjsonparser_stack * stack, easyjsonparser_value * val)
+{
+  char num[EJP_FORMAT_MAX];
+
+  switch (type) {
+  case EASYJSONPARSER_SCHEMA_MAP:
+    return write_map(ws, val->js, stack, val->cfg);
+
+  case EASYJSONPARSER_SCHEMA_LST:
+    return write_list(ws, val->js, stack, val->cfg);
+
+  case EASYJSONPARSER_SCHEMA_STR:
+    return write_str(ws, val->str, val->len);
+
+  case EASYJSONPARSER_SCHEMA_INT:
+  case EASYJSONPARSER_SCHEMA_I64:
+    return write_out(ws, num, ejp_format_int64(num, val->i));
+
+  case EASYJSONPARSER_SCHEMA_DBL:
+    return write_out(ws, num, ejp_format_double(num, val->d));
+
+  case EASYJSONPARSER_SCHEMA_BOO:
+    return val->i ? write_out(ws, "true", 4) : write_out(ws, "false", 5);
+
+  case EASYJSONPARSER_SCHEMA_NUL:
+    return write_out(ws, "null", 4);
+  }
+
+  return ejp_error_handler(ws->ctx, EASYJSONPARSER_ERROR_SCHEMA_INVALID, val->js,
+                           "invalid schema",
+                           "invalid schema type %d at %s", type, ejp_error_path(ws->ctx, stack));
+}
+
+
+/// Write the map \p js, its values taken from \p cfg or asked of the
+/// getter, leaving out those which there are none of.
+
+int write_map (write_state * ws, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+{
+  int retval = write_enter(ws, stack);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  easyjsonparser_schema * entries = (easyjsonparser_schema *) js->data;
+  int varkeys = entries[0].type != EASYJSONPARSER_SCHEMA_END && entries[1].type == EASYJSONPARSER_SCHEMA_END && entries[0].key == NULL;
+
+  easyjsonparser_stack member;
+  member.prev = stack;
+  member.ctx  = ws->ctx;
+
+  easyjsonparser_value val;
+  int type;
+  char sep = '{';
+
+  for (size_t n = 0; ; n++) {
+    easyjsonparser_schema * entry;
+    if (varkeys) {
+      retval = write_get(ws, js, stack, n + 1, &val, cfg, &type);
+      if (retval == EASYJSONPARSER_WRITE_NONE)
+        break;
+      if (retval == EASYJSONPARSER_SUCCESS && val.key == NULL) {
+        if ((retval = write_unwritable(ws, js, stack, "no key for map member")) == EASYJSONPARSER_SUCCESS)
+          continue;
+      }
+      member.key = (char *) val.key;
+    } else {
+      if ((entry = &entries[n])->type == EASYJSONPARSER_SCHEMA_END)
+        break;
+      member.key = entry->key;
+      retval = write_get(ws, entry, &member, 0, &val, cfg, &type);
+      if (retval == EASYJSONPARSER_WRITE_NONE)
+        continue;
+    }
+    if (retval != EASYJSONPARSER_SUCCESS)
+      return retval;
+
+    if ((retval = write_byte(ws, sep)) != EASYJSONPARSER_SUCCESS
+        || (retval = write_str(ws, member.key, strlen(member.key))) != EASYJSONPARSER_SUCCESS
+        || (retval = write_byte(ws, ':')) != EASYJSONPARSER_SUCCESS
+        || (retval = write_value(ws, type, &member, &val)) != EASYJSONPARSER_SUCCESS)
+      return retval;
+    sep = ',';
+  }
+
+  ws->depth--;
+
+  return sep == '{' ? write_out(ws, "{}", 2) : write_byte(ws, '}');
+}
+
+
+/// Write the list or typed array \p js, its elements asked of the getter
+/// until there are no more.
+
+int write_list (write_state * ws, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)
+{
+  int retval = write_enter(ws, stack);
+  if (retval != EASYJSONPARSER_SUCCESS)
+    return retval;
+
+  easyjsonparser_value val;
+  int type;
+  char sep = '[';
+
+  for (size_t n = 1; ; n++) {
+    retval = write_get(ws, js, stack, n, &val, cfg, &type);
+    if (retval == EASYJSONPARSER_WRITE_NONE)
+      break;
+    if (retval != EASYJSONPARSER_SUCCESS
+        || (retval = write_byte(ws, sep)) != EASYJSONPARSER_SUCCESS
+        || (retval = write_value(ws, type, stack, &val)) != EASYJSONPARSER_SUCCESS)
+      return retval;
+    sep = ',';
+  }
+
+  ws->depth--;
+
+  return sep == '[' ? write_out(ws, "[]", 2) : write_byte(ws, ']');
+}
+
+
+/// Count a map or list being opened at \p stack, failing if it is nested
+/// too deeply.
+
+int write_enter (write_state * ws, easyjsonparser_stack * stack)
+{
+  if (++ws->depth <= ws->ctx->max_depth)
+    return EASYJSONPARSER_SUCCESS;
+
+  char * stack_path = ejp_error_path(ws->ctx, stack);
+
+  return ejp_error_handler(ws->ctx, EASYJSONPARSER_ERROR_PARSE_DEPTH, stack_path,
+                           "nesting too deep",
+                           "could not write JSON (nested more than %zu deep at %s)",
+                           ws->ctx->max_depth, stack_path);
+}
+
+
+/// Report that the value for \p js at \p stack cannot be written, for the
+/// reason \p why, returning what the error handler returns (the value is
+/// left out if the error is quashed).
+
+int write_unwritable (write_state * ws, easyjsonparser_schema * js, easyjsonparser_stack * stack, const char * why)
+{
+  char * stack_path = ejp_error_path(ws->ctx, stack);
+  void * data[3] = {js, stack_path, (void *) why};
+
+  return ejp_error_handler(ws->ctx, EASYJSONPARSER_ERROR_SCHEMA_UNWRITABLE, data,
+                           "value cannot be written",
+                           "%s (%s) cannot be written at %s (%s)",
+                           js->key != NULL ? js->key : ws->depth == 0 ? "<root>" : "<element>",
+                           js->descr != NULL ? js->descr : "no description", stack_path, why);
+}
+
+
+/// Return the escape sequence for the byte \p c, which must be escaped,
+/// in \p esc (six bytes), and its length.
+
+static inline size_t write_escape (unsigned char c, char * esc)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  esc[0] = '\\';
+  switch (c) {
+  case '"':  esc[1] = '"';  return 2;
+  case '\\': esc[1] = '\\'; return 2;
+  case '\b': esc[1] = 'b';  return 2;
+  case '\f': esc[1] = 'f';  return 2;
+  case '\n': esc[1] = 'n';  return 2;
+  case '\r': esc[1] = 'r';  return 2;
+  case '\t': esc[1] = 't';  return 2;
+  }
+
+  memcpy(esc + 1, "u00", 3);
+  esc[4] = hex[c >> 4];
+  esc[5] = hex[c & 0xf];
+
+  return 6;
+}
+
+
+/// Write the \p len bytes at \p str as a JSON string, copying the runs
+/// between bytes which must be escaped as they are.
+
+int write_str (write_state * ws, const char * str, size_t len)
+{
+  const unsigned char * p   = (const unsigned char *) str;
+  const unsigned char * end = p + len;
+
+  int retval = write_byte(ws, '"');
+
+  while (retval == EASYJSONPARSER_SUCCESS) {
+    const unsigned char * special = ws->find_special(p, end);
+    if (special > p && (retval = write_out(ws, (const char *) p, special - p)) != EASYJSONPARSER_SUCCESS)
+      return retval;
+    if (special == end)
+      return write_byte(ws, '"');
+
+    char esc[6];
+    retval = write_out(ws, esc, write_escape(*special, esc));
+    p = special + 1;
+  }
+
+  return retval;
+}
+
+
+/// True if the byte \p c must be escaped in a JSON string.
+
+static inline int write_special (unsigned char c)
+{
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+
+/// Find the first byte which must be escaped, eight bytes at a time.
+
+const unsigned char * write_find_special_scalar (const unsigned char * p, const unsigned char * end)
+{
+  const uint64_t ones = 0x0101010101010101ull;
+  const uint64_t high = 0x8080808080808080ull;
+
+  for (; end - p >= 8; p += 8) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    uint64_t q = w ^ (ones * '"');
+    uint64_t b = w ^ (ones * '\\');
+    uint64_t m = ((w - ones * 0x20) & ~w) | ((q - ones) & ~q) | ((b - ones) & ~b);
+    if (m & high)
+      break;
+  }
+  while (p < end && !write_special(*p))
+    p++;
+
+  return p;
+}
+
+
+#ifdef __SSE2__
+
+/// Find the first byte which must be escaped, sixteen bytes at a time.
+
+const unsigned char * write_find_special_sse2 (const unsigned char * p, const unsigned char * end)
+{
+  const __m128i ctl   = _mm_set1_epi8(0x1f);
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bs    = _mm_set1_epi8('\\');
+
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bs)));
+    int mask = _mm_movemask_epi8(m);
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+
+  return write_find_special_scalar(p, end);
+}
+
+#endif // __SSE2__
+
+
+#ifdef HAVE_AVX2_DISPATCH
+
+/// Find the first byte which must be escaped, thirty two bytes at a time.
+
+__attribute__((target("avx2")))
+const unsigned char * write_find_special_avx2 (const unsigned char * p, const unsigned char * end)
+{
+  const __m256i ctl   = _mm256_set1_epi8(0x1f);
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i bs    = _mm256_set1_epi8('\\');
+
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) p);
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, ctl), ctl),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, bs)));
+    uint32_t mask = (uint32_t) _mm256_movemask_epi8(m);
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+
+  return write_find_special_scalar(p, end);
+}
+
+#endif // HAVE_AVX2_DISPATCH
@@ -0,0 +1,827 @@
+/// \file
+/// \brief ejp-codegen, a parser generator for libeasyjsonparser.
+///
+/// Reads a JSON description of a schema and writes a C parser dedicated to
+/// it. Where the library walks the schema entry tables for each value, the
+/// generated parser has the schema compiled into it, each map a function
+/// which dispatches its keys with a switch on their length and a memcmp,
+/// storing fields and calling handlers inline, using the scan functions
+/// (see \ref easyjsonparser_scan_init) to tokenize. The handlers, errors
+/// and stacks are as for the library's own parser, and the schema is
+/// written out as well, as the tables the library would be given.
+///
+/// Usage: ejp-codegen DESCRIPTION OUTPUT.c OUTPUT.h
+///
+/// The description is a map like this:
+///
+/// {
+///   "name": "hello",
+///   "include": "hello.h",
+///   "struct": "struct hello_config",
+///   "root": "map",
+///   "entries": [
+///     {"key": "version", "type": "str", "handler": "hello_version", "descr": "Configuration version"},
+///     {"key": "restapi", "type": "map", "descr": "RESTful API", "entries": [
+///       {"key": "port", "type": "int", "field": "svr_port", "descr": "TCP port"}
+///     ]}
+///   ]
+/// }
+///
+/// The parser's entry points are named after "name", hello_parse_buffer
+/// and so on. Header files to include, for the handler declarations and
+/// the struct, are given by "include", a string or a list of strings.
+/// Each entry has a "type" (str, int, i64, dbl, boo, nul, map or lst), a
+/// "key" (except in lists and variable key maps), a "descr", and either a
+/// "handler" naming the function to call, or (for scalars other than nul)
+/// a "field" naming the member of "struct" to store the value in. Maps
+/// and lists have "entries", and maps may be "lenient".
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "easyjsonparser.h"
+
+
+/// A schema entry from the description.
+
+typedef struct cg_node_st {
+  char *              key;
+  int                 type;
+  char *              handler;
+  char *              field;
+  char *              descr;
+  int                 lenient;
+  struct cg_node_st * entries;
+  size_t              n_entries;
+  int                 id;
+} cg_node;
+
+
+/// The description, and where the generated code is going.
+
+typedef struct cg_st {
+  const char *         filename;
+  easyjsonparser_ctx * ctx;
+  char *               name;
+  char **              includes;
+  size_t               n_includes;
+  char *               struct_type;
+  cg_node              root;
+  int                  next_id;
+  FILE *               out;
+} cg;
+
+
+/// Local function declarations.
+
+static void   cg_fail (cg * g, const char * fmt, ...);
+static char * cg_get_str (cg * g, const easyjsonparser_cursor * map, const char * key, int required);
+static int    cg_get_bool (cg * g, const easyjsonparser_cursor * map, const char * key);
+static void   cg_read_entries (cg * g, const easyjsonparser_cursor * map, cg_node * node, const char * path);
+static void   cg_read_entry (cg * g, const easyjsonparser_cursor * map, cg_node * node, const char * path);
+static void   cg_emit_tables (cg * g, cg_node * node);
+static void   cg_emit_prototypes (cg * g, cg_node * node);
+static void   cg_emit_functions (cg * g, cg_node * node);
+static void   cg_emit_value (cg * g, cg_node * node, const char * js, const char * stack, int indent);
+
+
+static const struct { const char * name; int type; const char * macro; } cg_types[] = {
+  { "str", EASYJSONPARSER_SCHEMA_STR, "STR" },
+  { "int", EASYJSONPARSER_SCHEMA_INT, "INT" },
+  { "i64", EASYJSONPARSER_SCHEMA_I64, "I64" },
+  { "dbl", EASYJSONPARSER_SCHEMA_DBL, "DBL" },
+  { "boo", EASYJSONPARSER_SCHEMA_BOO, "BOO" },
+  { "nul", EASYJSONPARSER_SCHEMA_NUL, "NUL" },
+  { "map", EASYJSONPARSER_SCHEMA_MAP, "MAP" },
+  { "lst", EASYJSONPARSER_SCHEMA_LST, "LST" },
+};
+
+
+/// Report a problem with the description and give up.
+
+void cg_fail (cg * g, const char * fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "ejp-codegen: %s: ", g->filename);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+
+  exit(EXIT_FAILURE);
+}
+
+
+/// Return a copy of the string value of \p key in \p map, or NULL if it is
+/// not there and not \p required.
+
+char * cg_get_str (cg * g, const easyjsonparser_cursor * map, const char * key, int required)
+{
+  easyjsonparser_cursor val;
+  int retval = easyjsonparser_cursor_find_key(map, key, &val);
+  if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND && !required)
+    return NULL;
+  if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+    cg_fail(g, "\"%s\" missing", key);
+
+  const char * str;
+  if (retval != EASYJSONPARSER_SUCCESS || easyjsonparser_cursor_get_str(&val, &str, NULL) != EASYJSONPARSER_SUCCESS)
+    cg_fail(g, "\"%s\" must be a string", key);
+
+  return strdup(str);
+}
+
+
+/// Return the boolean value of \p key in \p map, false if it is not there.
+
+int cg_get_bool (cg * g, const easyjsonparser_cursor * map, const char * key)
+{
+  easyjsonparser_cursor val;
+  int retval = easyjsonparser_cursor_find_key(map, key, &val);
+  if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+    return 0;
+
+  int truth;
+  if (retval != EASYJSONPARSER_SUCCESS || easyjsonparser_cursor_get_bool(&val, &truth) != EASYJSONPARSER_SUCCESS)
+    cg_fail(g, "\"%s\" must be a boolean", key);
+
+  return truth;
+}
+
+
+/// Read the "entries" list of the map or list description \p map into
+/// \p node, checking they are entries the generated parser can dispatch,
+/// \p path naming \p node in errors.
+
+void cg_read_entries (cg * g, const easyjsonparser_cursor * map, cg_node * node, const char * path)
+{
+  easyjsonparser_cursor list, elem;
+  if (easyjsonparser_cursor_find_key(map, "entries", &list) != EASYJSONPARSER_SUCCESS)
+    cg_fail(g, "%s has no \"entries\"", path);
+
+  size_t n = 0;
+  int retval = easyjsonparser_cursor_first(&list, &elem);
+  for (; retval == EASYJSONPARSER_SUCCESS; retval = easyjsonparser_cursor_next(&elem))
+    n++;
+  if (retval != EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)
+    cg_fail(g, "\"entries\" of %s must be a list", path);
+
+  node->entries   = (cg_node *) calloc(n + 1, sizeof(cg_node));
+  if (node->entries == NULL)
+    cg_fail(g, "out of memory reading the entries of %s", path);
+  node->n_entries = n;
+  node->id        = g->next_id++;
+
+  retval = easyjsonparser_cursor_first(&list, &elem);
+  for (size_t i = 0; retval == EASYJSONPARSER_SUCCESS; retval = easyjsonparser_cursor_next(&elem), i++) {
+    char elem_path[1024];
+    snprintf(elem_path, sizeof(elem_path), "%s entry %zu", path, i);
+    if (easyjsonparser_cursor_type(&elem) != EASYJSONPARSER_SCHEMA_MAP)
+      cg_fail(g, "%s must be a map", elem_path);
+    cg_read_entry(g, &elem, &node->entries[i], elem_path);
+  }
+
+  if ((node->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_LST) {
+    if (n == 0)
+      cg_fail(g, "%s has no entries", path);
+    for (size_t i = 0; i < n; i++) {
+      if (node->entries[i].key != NULL)
+        cg_fail(g, "entries of list %s must not have keys", path);
+      int type = node->entries[i].type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+      type = type == EASYJSONPARSER_SCHEMA_I64 ? EASYJSONPARSER_SCHEMA_INT : type;
+      for (size_t j = 0; j < i; j++) {
+        int type2 = node->entries[j].type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+        if (type == (type2 == EASYJSONPARSER_SCHEMA_I64 ? EASYJSONPARSER_SCHEMA_INT : type2))
+          cg_fail(g, "list %s has more than one entry for the same type", path);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < n; i++)
+      if (node->entries[i].key == NULL && n > 1)
+        cg_fail(g, "entries of map %s must all have keys, or be a single entry without one", path);
+  }
+}
+
+
+/// Read the entry description \p map into \p node.
+
+void cg_read_entry (cg * g, const easyjsonparser_cursor * map, cg_node * node, const char * path)
+{
+  char * type = cg_get_str(g, map, "type", 1);
+  for (size_t i = 0; i < sizeof(cg_types) / sizeof(cg_types[0]); i++)
+    if (strcmp(type, cg_types[i].name) == 0)
+      node->type = cg_types[i].type;
+  if (node->type == EASYJSONPARSER_SCHEMA_END)
+    cg_fail(g, "%s has unknown type \"%s\"", path, type);
+  free(type);
+
+  node->key     = cg_get_str(g, map, "key", 0);
+  node->handler = cg_get_str(g, map, "handler", 0);
+  node->field   = cg_get_str(g, map, "field", 0);
+  node->descr   = cg_get_str(g, map, "descr", 0);
+  node->lenient = cg_get_bool(g, map, "lenient");
+
+  if (node->type == EASYJSONPARSER_SCHEMA_MAP || node->type == EASYJSONPARSER_SCHEMA_LST) {
+    if (node->handler != NULL || node->field != NULL)
+      cg_fail(g, "%s is a map or list, so can have no handler or field", path);
+    cg_read_entries(g, map, node, path);
+  } else if (node->field != NULL) {
+    if (node->handler != NULL)
+      cg_fail(g, "%s has both a handler and a field", path);
+    if (node->type == EASYJSONPARSER_SCHEMA_NUL)
+      cg_fail(g, "%s is a nul, so can have no field", path);
+    if (g->struct_type == NULL)
+      cg_fail(g, "%s has a field but there is no \"struct\"", path);
+    node->type |= EASYJSONPARSER_SCHEMA_FLD;
+  }
+
+  if (node->lenient && node->type != EASYJSONPARSER_SCHEMA_MAP)
+    cg_fail(g, "%s is not a map, so can not be lenient", path);
+}
+
+
+/// Write \p len bytes at \p s as a C string literal.
+
+static void cg_emit_cstr (cg * g, const char * s, size_t len)
+{
+  fputc('"', g->out);
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char) s[i];
+    if (c == '"' || c == '\\')
+      fprintf(g->out, "\\%c", c);
+    else if (c < 0x20 || c >= 0x7f || c == '?')
+      fprintf(g->out, "\\%03o", c);
+    else
+      fputc(c, g->out);
+  }
+  fputc('"', g->out);
+}
+
+static void cg_emit_str_or_null (cg * g, const char * s)
+{
+  if (s == NULL)
+    fputs("NULL", g->out);
+  else
+    cg_emit_cstr(g, s, strlen(s));
+}
+
+
+/// Write the name of the child schema entry array of the map or list
+/// \p node, and that of the schema entry \p i in it.
+
+static void cg_table_name (cg * g, cg_node * node, char * buf, size_t buf_len)
+{
+  if (node == &g->root)
+    snprintf(buf, buf_len, "%s_schema + 1", g->name);
+  else
+    snprintf(buf, buf_len, "%s_schema_%d", g->name, node->id);
+}
+
+static void cg_entry_ref (cg * g, cg_node * node, size_t i, char * buf, size_t buf_len)
+{
+  if (node == &g->root)
+    snprintf(buf, buf_len, "&%s_schema[%zu]", g->name, i + 1);
+  else
+    snprintf(buf, buf_len, "&%s_schema_%d[%zu]", g->name, node->id, i);
+}
+
+
+/// Write the schema entry tables of \p node and those below it, children
+/// first.
+
+void cg_emit_tables (cg * g, cg_node * node)
+{
+  for (size_t i = 0; i < node->n_entries; i++)
+    if (node->entries[i].entries != NULL)
+      cg_emit_tables(g, &node->entries[i]);
+
+  if (node == &g->root)
+    fprintf(g->out, "EASYJSONPARSER_SCHEMA(%s_schema, EASYJSONPARSER_SCHEMA_%s)\n",
+            g->name, node->type == EASYJSONPARSER_SCHEMA_MAP ? "MAP" : "LST");
+  else
+    fprintf(g->out, "static EASYJSONPARSER_SUBSCHEMA(%s_schema_%d)\n", g->name, node->id);
+
+  for (size_t i = 0; i < node->n_entries; i++) {
+    cg_node * e = &node->entries[i];
+
+    const char * macro = NULL;
+    for (size_t t = 0; t < sizeof(cg_types) / sizeof(cg_types[0]); t++)
+      if ((e->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == cg_types[t].type)
+        macro = cg_types[t].macro;
+
+    fprintf(g->out, "  EASYJSONPARSER_%s%s(", macro,
+            e->type & EASYJSONPARSER_SCHEMA_FLD ? "_FIELD" : e->lenient ? "_LENIENT" : "");
+    cg_emit_str_or_null(g, e->key);
+    if (e->type & EASYJSONPARSER_SCHEMA_FLD)
+      fprintf(g->out, ", %s, %s, ", g->struct_type, e->field);
+    else if (e->entries != NULL)
+      fprintf(g->out, ", %s_schema_%d, ", g->name, e->id);
+    else
+      fprintf(g->out, ", %s, ", e->handler != NULL ? e->handler : "NULL");
+    cg_emit_str_or_null(g, e->descr);
+    fprintf(g->out, "),\n");
+  }
+
+  fprintf(g->out, "  EASYJSONPARSER_END();\n\n");
+}
+
+
+/// Write the prototypes of the functions parsing \p node and the maps and
+/// lists below it.
+
+void cg_emit_prototypes (cg * g, cg_node * node)
+{
+  fprintf(g->out, "static int    %s_parse_%d (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg);\n",
+          g->name, node->id);
+
+  for (size_t i = 0; i < node->n_entries; i++)
+    if (node->entries[i].entries != NULL)
+      cg_emit_prototypes(g, &node->entries[i]);
+}
+
+
+/// Write the code scanning the value for the scalar, map or list entry
+/// \p node, whose schema entry is \p js and stack \p stack, setting
+/// retval.
+
+void cg_emit_value (cg * g, cg_node * node, const char * js, const char * stack, int indent)
+{
+  static const char * clamp = "val > INT_MAX ? INT_MAX : val < INT_MIN ? INT_MIN : (int) val";
+
+  const char * scan = NULL;
+  const char * decl = NULL;
+  const char * val  = "val";
+
+  switch (node->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) {
+  case EASYJSONPARSER_SCHEMA_MAP:
+  case EASYJSONPARSER_SCHEMA_LST:
+    fprintf(g->out, "%*sretval = %s_parse_%d(cur, %s, %s, cfg);\n", indent, "", g->name, node->id, js, stack);
+    return;
+
+  case EASYJSONPARSER_SCHEMA_STR:
+    if (node->type & EASYJSONPARSER_SCHEMA_FLD) {
+      fprintf(g->out, "%*sretval = easyjsonparser_scan_str_field(cur, %s, %s, cfg);\n", indent, "", js, stack);
+      return;
+    }
+    decl = "char * val;";
+    scan = "easyjsonparser_scan_str(cur, %s, %s, &val, NULL)";
+    break;
+
+  case EASYJSONPARSER_SCHEMA_INT:
+    decl = "int64_t val;";
+    scan = "easyjsonparser_scan_int(cur, %s, %s, &val)";
+    val  = clamp;
+    break;
+
+  case EASYJSONPARSER_SCHEMA_I64:
+    decl = "int64_t val;";
+    scan = "easyjsonparser_scan_int(cur, %s, %s, &val)";
+    break;
+
+  case EASYJSONPARSER_SCHEMA_DBL:
+    decl = "double val;";
+    scan = "easyjsonparser_scan_double(cur, %s, %s, &val)";
+    break;
+
+  case EASYJSONPARSER_SCHEMA_BOO:
+    decl = "int val;";
+    scan = "easyjsonparser_scan_bool(cur, %s, %s, &val)";
+    break;
+
+  case EASYJSONPARSER_SCHEMA_NUL:
+    fprintf(g->out, "%*sretval = easyjsonparser_scan_null(cur, %s, %s);\n", indent, "", js, stack);
+    if (node->handler != NULL)
+      fprintf(g->out, "%*sif (retval == EASYJSONPARSER_SUCCESS)\n%*s  %s(%s, cfg);\n",
+              indent, "", indent, "", node->handler, stack);
+    return;
+  }
+
+  fprintf(g->out, "%*s{\n%*s  %s\n%*s  retval = ", indent, "", indent, "", decl, indent, "");
+  fprintf(g->out, scan, js, stack);
+  fprintf(g->out, ";\n");
+  if (node->type & EASYJSONPARSER_SCHEMA_FLD)
+    fprintf(g->out, "%*s  if (retval == EASYJSONPARSER_SUCCESS)\n%*s    ((%s *) cfg)->%s = %s;\n",
+            indent, "", indent, "", g->struct_type, node->field, val);
+  else if (node->handler != NULL)
+    fprintf(g->out, "%*s  if (retval == EASYJSONPARSER_SUCCESS)\n%*s    %s(%s, %s, cfg);\n",
+            indent, "", indent, "", node->handler, stack, val);
+  fprintf(g->out, "%*s}\n", indent, "");
+}
+
+
+/// Write the function parsing the map \p node, its keys dispatched on
+/// their length and then compared.
+
+static void cg_emit_map (cg * g, cg_node * node)
+{
+  char table[256], js[256];
+  cg_table_name(g, node, table, sizeof(table));
+
+  int varkeys = node->n_entries == 1 && node->entries[0].key == NULL;
+
+  fprintf(g->out,
+          "  easyjsonparser_stack member;\n"
+          "  member.prev = stack;\n"
+          "  member.ctx  = stack->ctx;\n"
+          "\n"
+          "  const char * key;\n"
+          "  size_t key_len;\n");
+  if (varkeys)
+    fprintf(g->out, "  char keybuf[64];\n");
+  fprintf(g->out,
+          "\n"
+          "  int retval = easyjsonparser_scan_enter(cur, js, stack);\n"
+          "  while (retval == EASYJSONPARSER_SUCCESS) {\n"
+          "    if ((retval = easyjsonparser_scan_key(cur, &key, &key_len)) != EASYJSONPARSER_SUCCESS)\n"
+          "      return retval;\n"
+          "\n");
+
+  if (varkeys) {
+    cg_entry_ref(g, node, 0, js, sizeof(js));
+    fprintf(g->out,
+            "    member.key = key_len < sizeof(keybuf) ? keybuf : (char *) malloc(key_len + 1);\n"
+            "    if (member.key == NULL)\n"
+            "      return easyjsonparser_scan_nomem(cur, key_len + 1);\n"
+            "    memcpy(member.key, key, key_len);\n"
+            "    member.key[key_len] = '\\0';\n"
+            "\n");
+    cg_emit_value(g, &node->entries[0], js, "&member", 4);
+    fprintf(g->out,
+            "\n"
+            "    if (member.key != keybuf)\n"
+            "      free(member.key);\n");
+  } else {
+    // One case per key length, the keys of that length compared in turn.
+    fprintf(g->out, "    switch (key_len) {\n");
+    int any = 0;
+    for (size_t i = 0; i < node->n_entries; i++) {
+      size_t len = strlen(node->entries[i].key);
+      size_t j = 0;
+      while (j < i && strlen(node->entries[j].key) != len)
+        j++;
+      if (j < i)
+        continue;
+
+      fprintf(g->out, "    case %zu:\n", len);
+      for (j = i; j < node->n_entries; j++) {
+        cg_node * e = &node->entries[j];
+        if (strlen(e->key) != len)
+          continue;
+        fprintf(g->out, "      if (memcmp(key, ");
+        cg_emit_cstr(g, e->key, len);
+        fprintf(g->out, ", %zu) == 0) {\n        member.key = (char *) ", len);
+        cg_emit_cstr(g, e->key, len);
+        fprintf(g->out, ";\n");
+        cg_entry_ref(g, node, j, js, sizeof(js));
+        cg_emit_value(g, e, js, "&member", 8);
+        fprintf(g->out, "        break;\n      }\n");
+      }
+      fprintf(g->out, "      goto unexpected;\n\n");
+      any = 1;
+    }
+    fprintf(g->out, "    default:\n");
+    if (any)
+      fprintf(g->out, "    unexpected:\n");
+    if (node->lenient)
+      fprintf(g->out, "      retval = easyjsonparser_scan_skip(cur);\n");
+    else
+      fprintf(g->out, "      retval = easyjsonparser_scan_unexpected(cur, %s, stack, key, key_len);\n", table);
+    fprintf(g->out, "    }\n");
+  }
+
+  fprintf(g->out,
+          "\n"
+          "    if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)\n"
+          "      retval = EASYJSONPARSER_SUCCESS;\n"
+          "    if (retval == EASYJSONPARSER_SUCCESS)\n"
+          "      retval = easyjsonparser_scan_next(cur, EASYJSONPARSER_SCHEMA_MAP);\n"
+          "  }\n");
+}
+
+
+/// Write the function parsing the list \p node, its elements dispatched
+/// on their type if it has more than one entry.
+
+static void cg_emit_list (cg * g, cg_node * node)
+{
+  static const struct { int type; const char * name; } cases[] = {
+    { EASYJSONPARSER_SCHEMA_STR, "STR" },
+    { EASYJSONPARSER_SCHEMA_INT, "INT" },
+    { EASYJSONPARSER_SCHEMA_DBL, "DBL" },
+    { EASYJSONPARSER_SCHEMA_BOO, "BOO" },
+    { EASYJSONPARSER_SCHEMA_NUL, "NUL" },
+    { EASYJSONPARSER_SCHEMA_MAP, "MAP" },
+    { EASYJSONPARSER_SCHEMA_LST, "LST" },
+  };
+
+  char js[256];
+
+  fprintf(g->out,
+          "  int retval = easyjsonparser_scan_enter(cur, js, stack);\n"
+          "  while (retval == EASYJSONPARSER_SUCCESS) {\n");
+
+  if (node->n_entries == 1) {
+    cg_entry_ref(g, node, 0, js, sizeof(js));
+    cg_emit_value(g, &node->entries[0], js, "stack", 4);
+  } else {
+    fprintf(g->out, "    switch (easyjsonparser_cursor_type(cur)) {\n");
+    for (size_t i = 0; i < node->n_entries; i++) {
+      int type = node->entries[i].type & EASYJSONPARSER_SCHEMA_TYPE_BITS;
+      type = type == EASYJSONPARSER_SCHEMA_I64 ? EASYJSONPARSER_SCHEMA_INT : type;
+      for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+        if (cases[c].type == type)
+          fprintf(g->out, "    case EASYJSONPARSER_SCHEMA_%s:\n", cases[c].name);
+      cg_entry_ref(g, node, i, js, sizeof(js));
+      cg_emit_value(g, &node->entries[i], js, "stack", 6);
+      fprintf(g->out, "      break;\n\n");
+    }
+    // Anything else is reported as the first entry's mismatch.
+    fprintf(g->out, "    default:\n");
+    cg_entry_ref(g, node, 0, js, sizeof(js));
+    cg_emit_value(g, &node->entries[0], js, "stack", 6);
+    fprintf(g->out, "    }\n");
+  }
+
+  fprintf(g->out,
+          "\n"
+          "    if (retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND)\n"
+          "      retval = EASYJSONPARSER_SUCCESS;\n"
+          "    if (retval == EASYJSONPARSER_SUCCESS)\n"
+          "      retval = easyjsonparser_scan_next(cur, EASYJSONPARSER_SCHEMA_LST);\n"
+          "  }\n");
+}
+
+
+/// Write the functions parsing \p node and the maps and lists below it.
+
+void cg_emit_functions (cg * g, cg_node * node)
+{
+  fprintf(g->out,
+          "int %s_parse_%d (easyjsonparser_cursor * cur, easyjsonparser_schema * js, easyjsonparser_stack * stack, void * cfg)\n"
+          "{\n",
+          g->name, node->id);
+
+  if ((node->type & EASYJSONPARSER_SCHEMA_TYPE_BITS) == EASYJSONPARSER_SCHEMA_MAP)
+    cg_emit_map(g, node);
+  else
+    cg_emit_list(g, node);
+
+  fprintf(g->out,
+          "\n"
+          "  return retval == EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND ? EASYJSONPARSER_SUCCESS : retval;\n"
+          "}\n\n\n");
+
+  for (size_t i = 0; i < node->n_entries; i++)
+    if (node->entries[i].entries != NULL)
+      cg_emit_functions(g, &node->entries[i]);
+}
+
+
+/// Write the header declaring the entry points.
+
+static void cg_emit_header (cg * g, const char * src, const char * guard)
+{
+  fprintf(g->out,
+          "/// \\file\n"
+          "/// \\brief Parser for %s, generated by ejp-codegen from %s.\n"
+          "///\n"
+          "/// Generated code, do not edit.\n"
+          "\n\n"
+          "#ifndef %s\n"
+          "#define %s\n"
+          "\n\n"
+          "#include \"easyjsonparser.h\"\n"
+          "\n\n"
+          "extern easyjsonparser_schema %s_schema[];\n"
+          "\n"
+          "extern int    %s_parse_string (const char * input_string, void * cfg);\n"
+          "extern int    %s_parse_buffer (const char * buf, size_t len, void * cfg);\n"
+          "extern int    %s_ctx_parse_string (easyjsonparser_ctx * ctx, const char * input_string, void * cfg);\n"
+          "extern int    %s_ctx_parse_buffer (easyjsonparser_ctx * ctx, const char * buf, size_t len, void * cfg);\n"
+          "\n\n"
+          "#endif // %s\n",
+          g->name, src, guard, guard, g->name, g->name, g->name, g->name, g->name, guard);
+}
+
+
+/// Write the parser.
+
+static void cg_emit_source (cg * g, const char * src, const char * header)
+{
+  fprintf(g->out,
+          "/// \\file\n"
+          "/// \\brief Parser for %s, generated by ejp-codegen from %s.\n"
+          "///\n"
+          "/// Generated code, do not edit.\n"
+          "\n\n"
+          "#include <stdlib.h>\n"
+          "#include <stdint.h>\n"
+          "#include <limits.h>\n"
+          "#include <string.h>\n"
+          "\n"
+          "#include \"easyjsonparser.h\"\n",
+          g->name, src);
+  for (size_t i = 0; i < g->n_includes; i++)
+    fprintf(g->out, "#include \"%s\"\n", g->includes[i]);
+  fprintf(g->out, "#include \"%s\"\n\n\n", header);
+
+  fprintf(g->out, "/// The schema, as tables for the library's own parser, and for the errors\n"
+                  "/// reported by this one.\n\n");
+  cg_emit_tables(g, &g->root);
+  fprintf(g->out, "static easyjsonparser_schema %s_root = { NULL, EASYJSONPARSER_SCHEMA_%s, %s_schema + 1, NULL };\n\n\n",
+          g->name, g->root.type == EASYJSONPARSER_SCHEMA_MAP ? "MAP" : "LST", g->name);
+
+  fprintf(g->out, "/// Local function declarations.\n\n");
+  cg_emit_prototypes(g, &g->root);
+  fprintf(g->out, "\n\n");
+
+  fprintf(g->out,
+          "/// Parse \\p len bytes of JSON at \\p buf, with the context \\p ctx.\n"
+          "\n"
+          "int %s_ctx_parse_buffer (easyjsonparser_ctx * ctx, const char * buf, size_t len, void * cfg)\n"
+          "{\n"
+          "  easyjsonparser_stack stack;\n"
+          "  stack.key  = NULL;\n"
+          "  stack.prev = NULL;\n"
+          "  stack.ctx  = ctx;\n"
+          "\n"
+          "  easyjsonparser_cursor cur;\n"
+          "  int retval = easyjsonparser_scan_init(ctx, &cur, buf, len);\n"
+          "  if (retval == EASYJSONPARSER_SUCCESS)\n"
+          "    retval = %s_parse_%d(&cur, &%s_root, &stack, cfg);\n"
+          "  if (retval == EASYJSONPARSER_SUCCESS)\n"
+          "    retval = easyjsonparser_scan_finish(&cur);\n"
+          "\n"
+          "  return retval;\n"
+          "}\n"
+          "\n\n"
+          "/// Parse the zero byte terminated JSON string \\p input_string, with the\n"
+          "/// context \\p ctx.\n"
+          "\n"
+          "int %s_ctx_parse_string (easyjsonparser_ctx * ctx, const char * input_string, void * cfg)\n"
+          "{\n"
+          "  return %s_ctx_parse_buffer(ctx, input_string, strlen(input_string), cfg);\n"
+          "}\n"
+          "\n\n"
+          "/// Parse \\p len bytes of JSON at \\p buf.\n"
+          "\n"
+          "int %s_parse_buffer (const char * buf, size_t len, void * cfg)\n"
+          "{\n"
+          "  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();\n"
+          "  if (ctx == NULL)\n"
+          "    return EASYJSONPARSER_ERROR_MEMORY;\n"
+          "\n"
+          "  int retval = %s_ctx_parse_buffer(ctx, buf, len, cfg);\n"
+          "\n"
+          "  easyjsonparser_ctx_free(ctx);\n"
+          "  return retval;\n"
+          "}\n"
+          "\n\n"
+          "/// Parse the zero byte terminated JSON string \\p input_string.\n"
+          "\n"
+          "int %s_parse_string (const char * input_string, void * cfg)\n"
+          "{\n"
+          "  return %s_parse_buffer(input_string, strlen(input_string), cfg);\n"
+          "}\n"
+          "\n\n",
+          g->name, g->name, g->root.id, g->name,
+          g->name, g->name,
+          g->name, g->name,
+          g->name, g->name);
+
+  fprintf(g->out, "/// The maps and lists of the schema.\n\n");
+  cg_emit_functions(g, &g->root);
+}
+
+
+/// Read the whole of \p filename, returning its length in \p len.
+
+static char * cg_slurp (const char * filename, size_t * len)
+{
+  FILE * f = fopen(filename, "rb");
+  if (f == NULL)
+    return NULL;
+
+  size_t size = 4096;
+  char * buf  = (char *) malloc(size);
+  size_t n    = 0;
+  size_t got;
+  while (buf != NULL && (got = fread(buf + n, 1, size - n, f)) > 0) {
+    n += got;
+    if (n == size) {
+      char * new_buf = (char *) realloc(buf, size *= 2);
+      if (new_buf == NULL)
+        free(buf);
+      buf = new_buf;
+    }
+  }
+  fclose(f);
+
+  *len = n;
+  return buf;
+}
+
+
+/// Open \p filename for writing the generated code to, or give up.
+
+static FILE * cg_open (const char * filename)
+{
+  FILE * f = fopen(filename, "w");
+  if (f == NULL) {
+    fprintf(stderr, "ejp-codegen: could not open %s for writing\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  return f;
+}
+
+
+int main (int argc, char ** argv)
+{
+  if (argc != 4) {
+    fprintf(stderr, "usage: ejp-codegen DESCRIPTION OUTPUT.c OUTPUT.h\n");
+    return EXIT_FAILURE;
+  }
+
+  cg g;
+  memset(&g, 0, sizeof(g));
+  g.filename = argv[1];
+
+  size_t len;
+  char * desc = cg_slurp(argv[1], &len);
+  if (desc == NULL) {
+    fprintf(stderr, "ejp-codegen: could not read %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  g.ctx = easyjsonparser_ctx_new();
+
+  easyjsonparser_cursor top;
+  if (easyjsonparser_cursor_init(g.ctx, &top, desc, len) != EASYJSONPARSER_SUCCESS
+      || easyjsonparser_cursor_type(&top) != EASYJSONPARSER_SCHEMA_MAP)
+    cg_fail(&g, "the description must be a map");
+
+  g.name        = cg_get_str(&g, &top, "name", 1);
+  g.struct_type = cg_get_str(&g, &top, "struct", 0);
+
+  easyjsonparser_cursor inc, elem;
+  if (easyjsonparser_cursor_find_key(&top, "include", &inc) == EASYJSONPARSER_SUCCESS) {
+    if (easyjsonparser_cursor_type(&inc) == EASYJSONPARSER_SCHEMA_STR) {
+      if ((g.includes = (char **) malloc(sizeof(char *))) == NULL)
+        cg_fail(&g, "out of memory reading \"include\"");
+      g.includes[0] = cg_get_str(&g, &top, "include", 1);
+      g.n_includes  = 1;
+    } else {
+      int retval = easyjsonparser_cursor_first(&inc, &elem);
+      for (; retval == EASYJSONPARSER_SUCCESS; retval = easyjsonparser_cursor_next(&elem)) {
+        const char * str;
+        if (easyjsonparser_cursor_get_str(&elem, &str, NULL) != EASYJSONPARSER_SUCCESS)
+          cg_fail(&g, "\"include\" must be a string or list of strings");
+        char ** includes = (char **) realloc(g.includes, (g.n_includes + 1) * sizeof(char *));
+        if (includes == NULL || (includes[g.n_includes] = strdup(str)) == NULL)
+          cg_fail(&g, "out of memory reading \"include\"");
+        g.includes = includes;
+        g.n_includes++;
+      }
+    }
+  }
+
+  char * root = cg_get_str(&g, &top, "root", 1);
+  if (strcmp(root, "map") == 0)
+    g.root.type = EASYJSONPARSER_SCHEMA_MAP;
+  else if (strcmp(root, "lst") == 0)
+    g.root.type = EASYJSONPARSER_SCHEMA_LST;
+  else
+    cg_fail(&g, "\"root\" must be \"map\" or \"lst\"");
+  free(root);
+
+  cg_read_entries(&g, &top, &g.root, "the root");
+
+  // The header guard is made of the header file name.
+  const char * base = strrchr(argv[3], '/') != NULL ? strrchr(argv[3], '/') + 1 : argv[3];
+  char guard[256];
+  size_t i = 0;
+  for (; base[i] != '\0' && i < sizeof(guard) - 10; i++)
+    guard[i] = (base[i] >= 'a' && base[i] <= 'z') ? base[i] - 'a' + 'A'
+             : (base[i] >= 'A' && base[i] <= 'Z') || (base[i] >= '0' && base[i] <= '9') ? base[i]
+             : '_';
+  strcpy(guard + i, "_INCLUDED");
+
+  const char * src = strrchr(argv[1], '/') != NULL ? strrchr(argv[1], '/') + 1 : argv[1];
+
+  g.out = cg_open(argv[3]);
+  cg_emit_header(&g, src, guard);
+  fclose(g.out);
+
+  g.out = cg_open(argv[2]);
+  cg_emit_source(&g, src, base);
+  fclose(g.out);
+
+  easyjsonparser_ctx_free(g.ctx);
+  free(desc);
+
+  return EXIT_SUCCESS;
+}
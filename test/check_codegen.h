@@ -0,0 +1,32 @@
+/// \file
+/// \brief Handlers and struct for the parser generated from check_codegen.json.
+
+
+#ifndef CHECK_CODEGEN_INCLUDED
+#define CHECK_CODEGEN_INCLUDED
+
+
+#include "easyjsonparser.h"
+
+
+/// The structure the parser generated from check_codegen.json parses into.
+
+typedef struct {
+  char *  name;
+  int     port;
+  int64_t ts;
+  double  ratio;
+  int     ssl;
+  char    log[512];
+} check_codegen_cfg;
+
+
+extern void   check_codegen_str_handler (easyjsonparser_stack * stack, char * val, check_codegen_cfg * cfg);
+extern void   check_codegen_int_handler (easyjsonparser_stack * stack, int val, check_codegen_cfg * cfg);
+extern void   check_codegen_i64_handler (easyjsonparser_stack * stack, int64_t val, check_codegen_cfg * cfg);
+extern void   check_codegen_dbl_handler (easyjsonparser_stack * stack, double val, check_codegen_cfg * cfg);
+extern void   check_codegen_bool_handler (easyjsonparser_stack * stack, int val, check_codegen_cfg * cfg);
+extern void   check_codegen_null_handler (easyjsonparser_stack * stack, check_codegen_cfg * cfg);
+
+
+#endif // CHECK_CODEGEN_INCLUDED
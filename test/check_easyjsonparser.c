@@ -1,14 +1,21 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/wait.h>
+#include <pthread.h>
 
 #include "easyjsonparser_check.h"
 
 #include "easyjsonparser.h"
+#include "easyjsonparser_internal.h"
+#include "check_codegen.h"
+#include "check_codegen_parser.h"
 
 
 #define SHOW_LOG_OUTPUT 1
@@ -54,6 +61,26 @@ int test_quashing_errhandler (int err_code, const void * data, const char * reas
   return EASYJSONPARSER_SUCCESS;
 }
 
+char g_lazy_path[256];
+char g_lazy_errmsg[256];
+
+int test_lazy_quashing_errhandler (int err_code, const void * data, const char * reason, easyjsonparser_error * err)
+{
+  g_errhandler_count++;
+  snprintf(g_lazy_path, sizeof(g_lazy_path), "%s", ((char * const *) data)[1]);
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+int test_lazy_message_errhandler (int err_code, const void * data, const char * reason, easyjsonparser_error * err)
+{
+  g_errhandler_count++;
+  snprintf(g_lazy_errmsg, sizeof(g_lazy_errmsg), "%s", easyjsonparser_error_message(err));
+  snprintf(g_lazy_path, sizeof(g_lazy_path), "%s", ((char * const *) data)[1]);
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
 
 // Tests.
 
@@ -246,6 +273,113 @@ START_TEST (parse_unknown_key_somekeys_success)
 }
 END_TEST
 
+START_TEST (parse_unknown_key_subtree_success)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("nice", NULL, "nice kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"naughty\": {\"a\": [1, 2.5, \"x\", null, true]}, \"nice\": \"ok\"}", ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 1);
+}
+END_TEST
+
+void parse_lenient_map_handler (easyjsonparser_stack * stack, char * val, int * callcount)
+{
+  (*callcount)++;
+  ck_assert_str_eq(val, "ok");
+}
+
+START_TEST (parse_lenient_map_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sub_ys)
+    EASYJSONPARSER_STR("nice", parse_lenient_map_handler, "nice kvp"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP_LENIENT("lenient", sub_ys, "lenient sub map"),
+    EASYJSONPARSER_MAP("strict", sub_ys, "strict sub map"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(all_ys, EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN)
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub map"),
+    EASYJSONPARSER_STR("nice", parse_lenient_map_handler, "nice kvp"),
+    EASYJSONPARSER_END();
+
+  static const char * unknown =
+    "\"naughty\": {\"a\": [1, -2.5e10, \"x]}\\\"{\", null, true, {\"b\": \"[[\"}], \"c\": {}}, "
+    "\"s\": \"{\\\\\", \"n\": 12345678901234567890123, \"t\": true, \"l\": [[], [[]]], ";
+
+  char json[512];
+  int callcount = 0;
+
+  sprintf(json, "{\"lenient\": {%s\"nice\": \"ok\"}, \"strict\": {\"nice\": \"ok\"}}", unknown);
+  ck_assert_int_eq(easyjsonparser_parse_string(json, ys, &callcount), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(callcount, 2);
+  ck_assert_int_eq(g_errhandler_count, 0);
+
+  sprintf(json, "{\"lenient\": {\"nice\": \"ok\"}, \"strict\": {\"nice\": \"ok\", \"naughty\": 1}}");
+  ck_assert_int_eq(easyjsonparser_parse_string(json, ys, &callcount), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 1);
+
+  sprintf(json, "{%s\"sub\": {%s\"nice\": \"ok\"}, \"nice\": \"ok\"}", unknown, unknown);
+  for (int isa = EJP_ISA_SCALAR; isa <= EJP_ISA_BEST; isa++) {
+    for (size_t index_min = 0; index_min <= 1; index_min++) {
+      easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+      ctx->index_min = index_min ? SIZE_MAX : 0;
+      ctx->isa = isa;
+
+      callcount = 0;
+      ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, all_ys, &callcount), EASYJSONPARSER_SUCCESS);
+      ck_assert_int_eq(callcount, 2);
+
+      easyjsonparser_ctx_free(ctx);
+    }
+  }
+  ck_assert_int_eq(g_errhandler_count, 1);
+}
+END_TEST
+
+START_TEST (parse_mismatch_quashed_skips_value)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_INT("bar", NULL, "bar test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": {\"deeper\": [{}]}, \"bar\": 123}", ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 1);
+}
+END_TEST
+
+START_TEST (cursor_mismatch_quashed_fails)
+{
+  static const char * json = "{\"a\": 1, \"b\": \"x\"}";
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_cursor root, a, b, val;
+  const char * str = NULL;
+  int64_t ival = 0;
+  double dval = 0;
+  int bval = 0;
+
+  ck_assert_int_eq(easyjsonparser_cursor_init(ctx, &root, json, strlen(json)), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "a", &a), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "b", &b), EASYJSONPARSER_SUCCESS);
+
+  // Quashing the error leaves no value of the type asked for, so each still
+  // fails.
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&a, "c", &val), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP);
+  ck_assert_int_eq(easyjsonparser_cursor_first(&a, &val), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST);
+  ck_assert_int_eq(easyjsonparser_cursor_at(&a, 0, &val), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST);
+  ck_assert_int_eq(easyjsonparser_cursor_get_str(&a, &str, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING);
+  ck_assert_int_eq(easyjsonparser_cursor_get_int(&b, &ival), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  ck_assert_int_eq(easyjsonparser_cursor_get_double(&b, &dval), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_DOUBLE);
+  ck_assert_int_eq(easyjsonparser_cursor_get_bool(&a, &bval), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_BOOL);
+  ck_assert_int_eq(g_errhandler_count, 7);
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
 int calls_string_handler_callback_handler_callcount = 0;
 
 void calls_string_handler_callback_handler (easyjsonparser_stack * stack, char * val, void * extra)
@@ -375,239 +509,2654 @@ START_TEST (handler_callback_stack_traces_path)
 }
 END_TEST
 
-START_TEST (parse_badschema_fails_errlogs)
-{
-  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
-    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
-    EASYJSONPARSER_END();
+int calls_string_handler_unescapes_handler_callcount = 0;
 
-  ys[0].type = 123;
+void calls_string_handler_unescapes_handler (easyjsonparser_stack * stack, char * val, void * extra)
+{
+  calls_string_handler_unescapes_handler_callcount++;
 
-  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": \"fooval\"}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_INVALID);
-  ck_assert_int_eq(g_log_count_errs, 1);
+  ck_assert_int_eq(strcmp(val, "a\"b\\c/\n\u00e9\u20ac\U0001f600"), 0);
 }
-END_TEST
 
-START_TEST (parse_file_success)
+START_TEST (calls_string_handler_unescapes)
 {
-  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
-    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", calls_string_handler_unescapes_handler, "foo test kvp"),
     EASYJSONPARSER_END();
 
-  int fd = open("check_json_test_input_file.json", O_CREAT | O_WRONLY | O_TRUNC, 0666);
-  ck_assert_int_ge(fd, 0);
-  ck_assert_int_eq(write(fd, "{\"foo\": \"fooval\"}\n", strlen("{\"foo\": \"fooval\"}\n")), strlen("{\"foo\": \"fooval\"}\n"));
-  close(fd);
-
-  ck_assert_int_eq(easyjsonparser_parse_file("check_json_test_input_file.json", empty_ys, NULL), EASYJSONPARSER_SUCCESS);
-
-  unlink("check_json_test_input_file.json");
+  calls_string_handler_unescapes_handler_callcount = 0;
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": \"a\\\"b\\\\c\\/\\n\\u00e9\\u20ac\\ud83d\\ude00\"}", ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_string_handler_unescapes_handler_callcount, 1);
 }
 END_TEST
 
-START_TEST (parse_file_nonexisting_fails_errlogs)
+void calls_string_handler_unescapes_long_handler (easyjsonparser_stack * stack, char * val, char * expected)
 {
-  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
-    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
-    EASYJSONPARSER_END();
-
-  ck_assert_int_eq(easyjsonparser_parse_file("check_json_test_input_nonexisting_file.json", empty_ys, NULL), EASYJSONPARSER_ERROR_FILEOPEN);
-  ck_assert_int_eq(g_log_count_errs, 1);
+  ck_assert_str_eq(val, expected);
 }
-END_TEST
 
-START_TEST (parse_expected_list_fails_errlogs)
+START_TEST (calls_string_handler_unescapes_long)
 {
-  static EASYJSONPARSER_SUBSCHEMA(sublist_ys)
-    EASYJSONPARSER_STR(NULL, NULL, "foo test kvp"),
-    EASYJSONPARSER_END();
   static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
-    EASYJSONPARSER_LST("sub", sublist_ys, "sub data"),
+    EASYJSONPARSER_STR("foo", calls_string_handler_unescapes_long_handler, "foo test kvp"),
     EASYJSONPARSER_END();
 
-  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\":{\"deeper\":{\"foo\":\"fooval\"}}}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST);
-  ck_assert_int_eq(g_log_count_errs, 1);
+  // Escapes either side of each sixteen byte boundary, and a long run
+  // without any.
+  for (int at = 0; at < 40; at++) {
+    char json[256], expected[128];
+    memset(expected, 'x', 100);
+    expected[at] = '"';
+    expected[at + 1] = '\\';
+    expected[100] = '\0';
+    snprintf(json, sizeof(json), "{\"foo\": \"%.*s\\\"\\\\%s\"}", at, expected, expected + at + 2);
+    ck_assert_int_eq(easyjsonparser_parse_string(json, ys, expected), EASYJSONPARSER_SUCCESS);
+  }
 }
 END_TEST
 
-START_TEST (parse_expected_map_fails_errlogs)
+const char * calls_string_view_handler_input;
+int calls_string_view_handler_callcount = 0;
+int calls_string_view_handler_input_callcount = 0;
+
+void calls_string_view_handler (easyjsonparser_stack * stack, const char * ptr, size_t len, int flags, void * extra)
+{
+  calls_string_view_handler_callcount++;
+
+  if (strcmp(stack->key, "foo") == 0) {
+    ck_assert_int_eq(len, 5);
+    ck_assert_int_eq(memcmp(ptr, "fo\"oo", len), 0);
+    ck_assert_int_eq(flags & EASYJSONPARSER_STRVIEW_INPUT, 0);
+  } else {
+    ck_assert_int_eq(len, 6);
+    ck_assert_int_eq(memcmp(ptr, "barbar", len), 0);
+    if (flags & EASYJSONPARSER_STRVIEW_INPUT) {
+      calls_string_view_handler_input_callcount++;
+      ck_assert(ptr > calls_string_view_handler_input && ptr + len < calls_string_view_handler_input + strlen(calls_string_view_handler_input));
+    }
+  }
+}
+
+START_TEST (calls_string_view_handler_callback)
 {
-  static EASYJSONPARSER_SUBSCHEMA(subobj_ys)
-    EASYJSONPARSER_END();
   static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
-    EASYJSONPARSER_MAP("sub", subobj_ys, "sub data"),
+    EASYJSONPARSER_STR_VIEW("foo", calls_string_view_handler, "foo test kvp"),
+    EASYJSONPARSER_STR_VIEW("bar", calls_string_view_handler, "bar test kvp"),
     EASYJSONPARSER_END();
 
-  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\":\"unexpectedval\"}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP);
+  calls_string_view_handler_input = "{\"foo\": \"fo\\\"oo\", \"bar\": \"barbar\"}";
+  calls_string_view_handler_callcount = 0;
+  ck_assert_int_eq(easyjsonparser_parse_string(calls_string_view_handler_input, ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_string_view_handler_callcount, 2);
+
+  easyjsonparser_schema * compiled_ys = easyjsonparser_schema_compile(ys);
+  ck_assert_ptr_ne(compiled_ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parse_string(calls_string_view_handler_input, compiled_ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_string_view_handler_callcount, 4);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"bar\": 1}", compiled_ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING);
   ck_assert_int_eq(g_log_count_errs, 1);
+  easyjsonparser_schema_free(compiled_ys);
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_backend(ctx, EASYJSONPARSER_BACKEND_NATIVE);
+  calls_string_view_handler_input_callcount = 0;
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, calls_string_view_handler_input, ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_string_view_handler_callcount, 6);
+  ck_assert_int_eq(calls_string_view_handler_input_callcount, 1);
+  easyjsonparser_ctx_free(ctx);
 }
 END_TEST
 
-START_TEST (parse_expected_str_fails_errlogs)
+typedef struct {
+  char * name;
+  int    port;
+  double ratio;
+  int    ssl;
+  int    other;
+} parse_fields_cfg;
+
+void parse_fields_other_handler (easyjsonparser_stack * stack, int val, parse_fields_cfg * cfg)
+{
+  cfg->other = val * 2;
+}
+
+START_TEST (parse_fields_success)
 {
+  static EASYJSONPARSER_SUBSCHEMA(sub_ys)
+    EASYJSONPARSER_STR_FIELD("name", parse_fields_cfg, name, "name field"),
+    EASYJSONPARSER_INT_FIELD("port", parse_fields_cfg, port, "port field"),
+    EASYJSONPARSER_DBL_FIELD("ratio", parse_fields_cfg, ratio, "ratio field"),
+    EASYJSONPARSER_BOO_FIELD("ssl", parse_fields_cfg, ssl, "ssl field"),
+    EASYJSONPARSER_INT("other", parse_fields_other_handler, "other kvp"),
+    EASYJSONPARSER_END();
   static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
-    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub obj"),
     EASYJSONPARSER_END();
 
-  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\":{\"deeper\":{}}}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING);
+  parse_fields_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\": {\"name\": \"fo\\no\", \"port\": 80, \"ratio\": 0.5, \"ssl\": true, \"other\": 4}}", ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(strcmp(cfg.name, "fo\no"), 0);
+  ck_assert_int_eq(cfg.port, 80);
+  ck_assert(cfg.ratio == 0.5);
+  ck_assert_int_eq(cfg.ssl, 1);
+  ck_assert_int_eq(cfg.other, 8);
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\": {\"name\": \"bar\", \"ssl\": false}}", ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(strcmp(cfg.name, "bar"), 0);
+  ck_assert_int_eq(cfg.port, 80);
+  ck_assert_int_eq(cfg.ssl, 0);
+
+  easyjsonparser_schema * compiled_ys = easyjsonparser_schema_compile(ys);
+  ck_assert_ptr_ne(compiled_ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\": {\"name\": \"baz\", \"port\": 443}}", compiled_ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(strcmp(cfg.name, "baz"), 0);
+  ck_assert_int_eq(cfg.port, 443);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\": {\"port\": \"443\"}}", compiled_ys, &cfg), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
   ck_assert_int_eq(g_log_count_errs, 1);
+  easyjsonparser_schema_free(compiled_ys);
+
+  free(cfg.name);
 }
 END_TEST
 
-START_TEST (parse_expected_int_fails_errlogs)
+START_TEST (parse_lone_surrogate_success)
 {
   static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
-    EASYJSONPARSER_INT("bar", NULL, "bar test kvp"),
+    EASYJSONPARSER_STR_FIELD("name", parse_fields_cfg, name, "name field"),
     EASYJSONPARSER_END();
 
-  ck_assert_int_eq(easyjsonparser_parse_string("{\"bar\":{\"deeper\":{}}}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
-  ck_assert_int_eq(g_log_count_errs, 1);
+  parse_fields_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+
+  // Each half of a pair on its own becomes U+FFFD, a whole pair its code
+  // point.
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"name\": \"\\ud800x\\udc00\\ud800\\ud800\\ud83d\\ude00\"}", ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(cfg.name, "\xef\xbf\xbdx\xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd\xf0\x9f\x98\x80");
+
+  free(cfg.name);
 }
 END_TEST
 
-START_TEST (stack_path_renders_empty_stack)
-{
-  easyjsonparser_stack stack1;
-  stack1.key  = NULL;
-  stack1.prev = NULL;
+typedef struct {
+  int64_t ts;
+  int64_t counter;
+  int     small;
+} parse_i64_cfg;
 
-  ck_assert_int_eq(strcmp(easyjsonparser_stack_path(&stack1), "/"), 0);
+void parse_i64_counter_handler (easyjsonparser_stack * stack, int64_t val, parse_i64_cfg * cfg)
+{
+  cfg->counter = val;
 }
-END_TEST
 
-START_TEST (stack_path_renders_nonempty_stack)
+START_TEST (parse_i64_success)
 {
-  easyjsonparser_stack stack1;
-  stack1.key  = NULL;
-  stack1.prev = NULL;
-  easyjsonparser_stack stack2;
-  stack2.key  = "foo";
-  stack2.prev = &stack1;
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_I64_FIELD("ts", parse_i64_cfg, ts, "timestamp field"),
+    EASYJSONPARSER_I64("counter", parse_i64_counter_handler, "counter kvp"),
+    EASYJSONPARSER_INT_FIELD("small", parse_i64_cfg, small, "int field"),
+    EASYJSONPARSER_END();
 
-  ck_assert_int_eq(strcmp(easyjsonparser_stack_path(&stack2), "/foo"), 0);
+  parse_i64_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
 
-  easyjsonparser_stack stack3;
-  stack3.key  = "bar";
-  stack3.prev = &stack2;
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"ts\": 1700000000123, \"counter\": -9223372036854775808, \"small\": 12345678901}", ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert(cfg.ts == INT64_C(1700000000123));
+  ck_assert(cfg.counter == INT64_MIN);
+  ck_assert_int_eq(cfg.small, INT32_MAX);
 
-  ck_assert_int_eq(strcmp(easyjsonparser_stack_path(&stack3), "/foo/bar"), 0);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"ts\": 12345678901234567, \"counter\": 9223372036854775807}", ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert(cfg.ts == INT64_C(12345678901234567));
+  ck_assert(cfg.counter == INT64_MAX);
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"ts\": 1.5}", ys, &cfg), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  ck_assert_int_eq(g_log_count_errs, 1);
 }
 END_TEST
 
+typedef struct {
+  int64_t isum;
+  double  dsum;
+  size_t  next;
+  size_t  len;
+  int     calls;
+} parse_arrays_cfg;
 
-// Fixtures.
-
-void setup_logger (void)
+void parse_arrays_int_handler (easyjsonparser_stack * stack, const int64_t * vals, size_t n, size_t offset, parse_arrays_cfg * cfg)
 {
-  g_log_count_all  = 0;
-  g_log_count_errs = 0;
-
-  easyjsonparser_set_logger(test_logger);
+  ck_assert_uint_eq(offset, cfg->next);
+  ck_assert(n <= EJP_ARRAY_BATCH);
+  for (size_t i = 0; i < n; i++) {
+    ck_assert(vals[i] == (int64_t) (offset + i) * 1000000007);
+    cfg->isum += vals[i];
+  }
+  cfg->next += n;
+  cfg->calls++;
+  if (n == 0)
+    cfg->len = offset;
 }
 
-void teardown_logger (void)
+void parse_arrays_dbl_handler (easyjsonparser_stack * stack, const double * vals, size_t n, size_t offset, parse_arrays_cfg * cfg)
 {
-  easyjsonparser_set_logger(NULL);
+  ck_assert_uint_eq(offset, cfg->next);
+  for (size_t i = 0; i < n; i++)
+    cfg->dsum += vals[i];
+  cfg->next += n;
+  cfg->calls++;
+  if (n == 0)
+    cfg->len = offset;
 }
 
-void setup_default_logger (void)
+START_TEST (parse_typed_arrays_success)
 {
-  easyjsonparser_set_loglevel(EASYJSONPARSER_LOG_LEVEL_ERROR);
-  easyjsonparser_set_logger(NULL);
+  static EASYJSONPARSER_SCHEMA(int_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_INT_ARRAY("ids", parse_arrays_int_handler, "ids array"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(dbl_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_DBL_ARRAY("xs", parse_arrays_dbl_handler, "xs array"),
+    EASYJSONPARSER_END();
+
+  enum { NUMS = EJP_ARRAY_BATCH * 2 + 7 };
+
+  char * json = (char *) malloc(NUMS * 24 + 32);
+  char * p = json + sprintf(json, "{\"ids\": [");
+  int64_t isum = 0;
+  for (int i = 0; i < NUMS; i++) {
+    p += sprintf(p, "%s%lld", i ? ", " : "", (long long) i * 1000000007);
+    isum += (int64_t) i * 1000000007;
+  }
+  sprintf(p, "]}");
+
+  parse_arrays_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  ck_assert_int_eq(easyjsonparser_parse_string(json, int_ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert(cfg.isum == isum);
+  ck_assert_uint_eq(cfg.len, NUMS);
+  ck_assert_int_eq(cfg.calls, 4);
+  free(json);
+
+  memset(&cfg, 0, sizeof(cfg));
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"ids\": []}", int_ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_uint_eq(cfg.len, 0);
+  ck_assert_int_eq(cfg.calls, 1);
+
+  memset(&cfg, 0, sizeof(cfg));
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"xs\": [1.5, -2, 0.25e1]}", dbl_ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert(cfg.dsum == 2.0);
+  ck_assert_uint_eq(cfg.len, 3);
+  ck_assert_int_eq(cfg.calls, 2);
+
+  memset(&cfg, 0, sizeof(cfg));
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"ids\": [0, 1.5]}", int_ys, &cfg), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  ck_assert_int_eq(g_log_count_errs, 1);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"xs\": {}}", dbl_ys, &cfg), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST);
+  ck_assert_int_eq(g_log_count_errs, 2);
 }
+END_TEST
 
-void teardown_default_logger (void)
+void parse_mixed_list_str_handler (easyjsonparser_stack * stack, char * val, char * log)
 {
-  easyjsonparser_set_logger(NULL);
+  strcat(log, "s:");
+  strcat(log, val);
+  strcat(log, " ");
 }
 
-void setup_passthrough_errhandler (void)
+void parse_mixed_list_int_handler (easyjsonparser_stack * stack, int64_t val, char * log)
 {
-  easyjsonparser_set_errhandler(test_passthrough_errhandler);
+  sprintf(log + strlen(log), "i:%lld ", (long long) val);
 }
 
-void teardown_passthrough_errhandler (void)
+void parse_mixed_list_url_handler (easyjsonparser_stack * stack, char * val, char * log)
 {
-  easyjsonparser_set_errhandler(NULL);
+  strcat(log, "url:");
+  strcat(log, val);
+  strcat(log, " ");
 }
 
-void setup_quashing_errhandler (void)
+void parse_mixed_list_text_handler (easyjsonparser_stack * stack, char * val, char * log)
 {
-  easyjsonparser_set_errhandler(test_quashing_errhandler);
+  strcat(log, "text:");
+  strcat(log, val);
+  strcat(log, " ");
 }
 
-void teardown_quashing_errhandler (void)
+void parse_mixed_list_null_handler (easyjsonparser_stack * stack, char * log)
 {
-  easyjsonparser_set_errhandler(NULL);
+  strcat(log, "null ");
 }
 
+START_TEST (parse_mixed_list_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(link_ys)
+    EASYJSONPARSER_STR("url", parse_mixed_list_url_handler, "link url"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(note_ys)
+    EASYJSONPARSER_STR("text", parse_mixed_list_text_handler, "note text"),
+    EASYJSONPARSER_INT("id", NULL, "note id"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(items_ys)
+    EASYJSONPARSER_STR(NULL, parse_mixed_list_str_handler, "item string"),
+    EASYJSONPARSER_I64(NULL, parse_mixed_list_int_handler, "item integer"),
+    EASYJSONPARSER_MAP("url", link_ys, "item link"),
+    EASYJSONPARSER_MAP("text", note_ys, "item note"),
+    EASYJSONPARSER_NUL(NULL, parse_mixed_list_null_handler, "item null"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("items", items_ys, "items list"),
+    EASYJSONPARSER_END();
 
-// Suite.
+  char log[256] = "";
 
-void parse_success_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
-{
-  tcase_add_test(tc, parse_kvp_str_success);
-  tcase_add_test(tc, parse_kvp_int_success);
-  tcase_add_test(tc, parse_kvp_double_success);
-  tcase_add_test(tc, parse_kvp_boolean_success);
-  tcase_add_test(tc, parse_sub_kvp_str_success);
-  tcase_add_test(tc, parse_sub_kvp_int_success);
-  tcase_add_test(tc, parse_sub_map_str_success);
-  tcase_add_test(tc, parse_sub_freekey_success);
-  tcase_add_test(tc, parse_sublist_str_success);
-  tcase_add_test(tc, parse_sublist_int_success);
-  tcase_add_test(tc, parse_sublist_map_success);
-  tcase_add_test(tc, calls_string_handler_callback);
-  tcase_add_test(tc, calls_int_handler_callback);
-  tcase_add_test(tc, calls_double_handler_callback);
-  tcase_add_test(tc, calls_boolean_handler_callback);
-  tcase_add_test(tc, handler_callback_stack_traces_path);
-  tcase_add_test(tc, parse_file_success);
-  tcase_add_test(tc, stack_path_renders_empty_stack);
-  tcase_add_test(tc, stack_path_renders_nonempty_stack);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"items\": [\"a\", 1, {\"url\": \"x\"}, {\"id\": 7, \"text\": \"y\"}, null, -2, \"b\"]}", ys, log), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(log, "s:a i:1 url:x text:y null i:-2 s:b ");
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"items\": [\"a\", true]}", ys, log), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING);
+  ck_assert_int_eq(g_log_count_errs, 1);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"items\": [{\"id\": 1}]}", ys, log), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING);
+  ck_assert_int_eq(g_log_count_errs, 2);
 }
+END_TEST
 
-void parse_failure_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+START_TEST (parse_mixed_list_first_match)
 {
-  tcase_add_test(tc, parse_unknown_key_somekeys_fails_errlogs);
-  tcase_add_test(tc, parse_badschema_fails_errlogs);
-  tcase_add_test(tc, parse_file_nonexisting_fails_errlogs);
-  tcase_add_test(tc, parse_expected_list_fails_errlogs);
-  tcase_add_test(tc, parse_expected_map_fails_errlogs);
-  tcase_add_test(tc, parse_expected_str_fails_errlogs);
-  tcase_add_test(tc, parse_expected_int_fails_errlogs);
+  static EASYJSONPARSER_SUBSCHEMA(link_ys)
+    EASYJSONPARSER_STR("url", parse_mixed_list_url_handler, "link url"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(note_ys)
+    EASYJSONPARSER_STR("text", parse_mixed_list_text_handler, "note text"),
+    EASYJSONPARSER_STR("url", NULL, "note url"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(items_ys)
+    EASYJSONPARSER_STR(NULL, parse_mixed_list_str_handler, "item string"),
+    EASYJSONPARSER_STR(NULL, parse_mixed_list_url_handler, "item string again"),
+    EASYJSONPARSER_MAP("text", note_ys, "item note"),
+    EASYJSONPARSER_MAP(NULL, link_ys, "item link"),
+    EASYJSONPARSER_MAP("url", note_ys, "item link again"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("items", items_ys, "items list"),
+    EASYJSONPARSER_END();
+
+  char log[256] = "";
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"items\": [\"a\", {\"url\": \"x\", \"text\": \"y\"}, {\"url\": \"z\"}, \"b\"]}", ys, log), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(log, "s:a text:y url:z s:b ");
+
+  // Of several keyed entries the first the object has a key for is used,
+  // whatever the order of the keys in the object.
+  static EASYJSONPARSER_SUBSCHEMA(keyed_items_ys)
+    EASYJSONPARSER_MAP("text", note_ys, "item note"),
+    EASYJSONPARSER_MAP("url", link_ys, "item link"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(keyed_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("items", keyed_items_ys, "items list"),
+    EASYJSONPARSER_END();
+
+  log[0] = '\0';
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"items\": [{\"url\": \"x\", \"text\": \"y\"}, {\"url\": \"z\"}, {\"u\\u0072l\": \"w\"}]}", keyed_ys, log), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(log, "text:y url:z url:w ");
 }
+END_TEST
 
-void parse_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+void parse_deep_leaf_handler (easyjsonparser_stack * stack, int val, int * depth)
 {
-  parse_success_tests(tc, s, tags, fixtures, extra);
-  parse_failure_tests(tc, s, tags, fixtures, extra);
-
-  build_suite(add_tag(tags, "alt_errhandler"),
-              add_fixture(fixtures, setup_passthrough_errhandler, teardown_passthrough_errhandler),
-              parse_failure_tests,
-              s, NULL);
+  for (*depth = 0; stack->prev != NULL; stack = stack->prev)
+    if (strcmp(stack->key, "a") == 0)
+      (*depth)++;
 }
 
-void default_logger_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+START_TEST (parse_deep_nesting_success)
 {
-  tcase_add_test(tc, parse_kvp_str_success);
-  tcase_add_test(tc, parse_kvp_str_success_with_trace_log);
-  tcase_add_test(tc, parse_unknown_key_somekeys_fails);
+  static EASYJSONPARSER_SUBSCHEMA(nest_ys)
+    EASYJSONPARSER_MAP("a", nest_ys, "nested map"),
+    EASYJSONPARSER_INT("v", parse_deep_leaf_handler, "leaf value"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("a", nest_ys, "nested map"),
+    EASYJSONPARSER_END();
+
+  enum { DEPTH = 20000 };
+
+  char * json = (char *) malloc(DEPTH * 12 + 64);
+  char * p = json;
+  for (int i = 0; i < DEPTH; i++)
+    p += sprintf(p, "{\"a\": ");
+  p += sprintf(p, "{\"v\": 1}");
+  for (int i = 0; i < DEPTH; i++)
+    *p++ = '}';
+  *p = '\0';
+
+  // Far deeper than the C stack would allow were each level a call.
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_backend(ctx, EASYJSONPARSER_BACKEND_NATIVE);
+  easyjsonparser_ctx_set_max_depth(ctx, DEPTH + 1);
+  int depth = 0;
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, ys, &depth), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(depth, DEPTH);
+  depth = 0;
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, ys, &depth), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(depth, DEPTH);
+
+  easyjsonparser_ctx_set_max_depth(ctx, DEPTH);
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, ys, &depth), EASYJSONPARSER_ERROR_PARSE_DEPTH);
+  ck_assert_int_eq(g_log_count_errs, 1);
+
+  easyjsonparser_ctx_reset(ctx);
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, ys, &depth), EASYJSONPARSER_ERROR_PARSE_DEPTH);
+  ck_assert_int_eq(g_log_count_errs, 2);
+  easyjsonparser_ctx_free(ctx);
+
+  free(json);
 }
+END_TEST
 
-void errhandler_override_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+typedef struct {
+  double * expected;
+  int      seen;
+} parse_doubles_cfg;
+
+void parse_doubles_handler (easyjsonparser_stack * stack, double val, parse_doubles_cfg * cfg)
 {
-  tcase_add_test(tc, parse_unknown_key_nokeys_success);
-  tcase_add_test(tc, parse_unknown_key_somekeys_success);
+  double expected = cfg->expected[cfg->seen++];
+  ck_assert_msg(memcmp(&val, &expected, sizeof(val)) == 0, "double %d is %.17g, not %.17g", cfg->seen - 1, val, expected);
 }
 
-Suite * mk_suite()
+START_TEST (parse_doubles_exact_success)
 {
-  Suite * s = suite_create("easyjsonparser");
+  static EASYJSONPARSER_SUBSCHEMA(nums_ys)
+    EASYJSONPARSER_DBL(NULL, parse_doubles_handler, "number"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("nums", nums_ys, "numbers"),
+    EASYJSONPARSER_END();
 
-  char ** tags        = new_tags();
-  void (**fixtures)() = new_fixtures();
+  static const char * hard[] = {
+    "0.1", "0.0", "-0.0", "1e0", "1.7976931348623157e308", "1.7976931348623159e308",
+    "2.2250738585072011e-308", "2.2250738585072014e-308", "4.9406564584124654e-324",
+    "2.4703282292062328e-324", "1e-400", "1e400", "9007199254740993e0",
+    "9007199254740992.5", "9007199254740993.0000000000000001", "123456789012345678901234567890e-10",
+    "0.000000000000000000000000000000000000001234567890123456789", "7.3177701707893310e15",
+    "1.00000000000000011102230246251565404236316680908203125", "5e-324", "-1.5e-10",
+    "1.448997445238699", "3.0e22", "3.0e23", "2.5e-5", "1e22", "1e23", "8.41e21",
+  };
+  enum { NUMS = 30000 };
+
+  size_t n_hard = sizeof(hard) / sizeof(hard[0]);
+  char * json = (char *) malloc(NUMS * 48 + 32);
+  double * expected = (double *) malloc(NUMS * sizeof(double));
+  char * p = json + sprintf(json, "{\"nums\": [");
+
+  // The hard cases, then random doubles printed exactly, then random
+  // digit strings with random exponents, each checked against strtod.
+  uint64_t r = 0x9e3779b97f4a7c15ull;
+  for (int i = 0; i < NUMS; i++) {
+    char num[48];
+    r ^= r << 13;
+    r ^= r >> 7;
+    r ^= r << 17;
+    if ((size_t) i < n_hard) {
+      snprintf(num, sizeof(num), "%s", hard[i]);
+    } else if (i % 2) {
+      double d;
+      uint64_t bits = r & ~(0x7ffull << 52);
+      bits |= ((r >> 52) % 0x7ff) << 52;
+      memcpy(&d, &bits, sizeof(d));
+      snprintf(num, sizeof(num), "%.17g", d);
+      if (strpbrk(num, ".e") == NULL)
+        strcat(num, ".0");
+    } else {
+      int len = snprintf(num, sizeof(num), "%llu", (unsigned long long) (r >> (r % 40)));
+      snprintf(num + len, sizeof(num) - len, "e%d", (int) ((r >> 40) % 700) - 350);
+    }
+    expected[i] = strtod(num, NULL);
+    p += sprintf(p, "%s%s", i ? ", " : "", num);
+  }
+  sprintf(p, "]}");
+
+  parse_doubles_cfg cfg;
+  cfg.expected = expected;
+  cfg.seen     = 0;
+  ck_assert_int_eq(easyjsonparser_parse_string(json, ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(cfg.seen, NUMS);
+
+  free(expected);
+  free(json);
+}
+END_TEST
+
+START_TEST (arena_alloc_success)
+{
+  easyjsonparser_arena * arena = easyjsonparser_arena_new();
+  ck_assert_ptr_ne(arena, NULL);
+
+  char * strs[1000];
+  for (int i = 0; i < 1000; i++) {
+    char str[16];
+    snprintf(str, sizeof(str), "str%d", i);
+    strs[i] = easyjsonparser_arena_strdup(arena, str);
+    ck_assert_ptr_ne(strs[i], NULL);
+
+    double * dbl = (double *) easyjsonparser_arena_alloc(arena, sizeof(double));
+    ck_assert_ptr_ne(dbl, NULL);
+    ck_assert_int_eq((uintptr_t) dbl % sizeof(double), 0);
+    *dbl = i;
+  }
+  for (int i = 0; i < 1000; i++) {
+    char str[16];
+    snprintf(str, sizeof(str), "str%d", i);
+    ck_assert_int_eq(strcmp(strs[i], str), 0);
+  }
+
+  char * big = (char *) easyjsonparser_arena_alloc(arena, 4 * 1024 * 1024);
+  ck_assert_ptr_ne(big, NULL);
+  memset(big, 'x', 4 * 1024 * 1024);
+
+  char * abc = easyjsonparser_arena_strndup(arena, "abcdef", 3);
+  ck_assert_int_eq(strcmp(abc, "abc"), 0);
+
+  easyjsonparser_arena_reset(arena);
+  abc = easyjsonparser_arena_strndup(arena, "abcdef", 3);
+  ck_assert_int_eq(strcmp(abc, "abc"), 0);
+
+  easyjsonparser_arena_free(arena);
+}
+END_TEST
+
+typedef struct {
+  char * name;
+  char * kept[4];
+  int    kept_len;
+} parse_arena_cfg;
+
+void parse_arena_kept_handler (easyjsonparser_stack * stack, char * val, parse_arena_cfg * cfg)
+{
+  easyjsonparser_arena * arena = easyjsonparser_stack_arena(stack);
+  ck_assert_ptr_ne(arena, NULL);
+
+  cfg->kept[cfg->kept_len++] = easyjsonparser_arena_strdup(arena, val);
+  for (int i = 0; i < cfg->kept_len; i++)
+    ck_assert_int_eq(strcmp(cfg->kept[i], i == 0 ? "read" : i == 1 ? "write" : "admin"), 0);
+}
+
+START_TEST (parse_arena_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(kept_ys)
+    EASYJSONPARSER_STR(NULL, parse_arena_kept_handler, "kept value"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR_FIELD("name", parse_arena_cfg, name, "name field"),
+    EASYJSONPARSER_LST("kept", kept_ys, "kept list"),
+    EASYJSONPARSER_END();
+
+  const char * input = "{\"name\": \"foo\", \"kept\": [\"read\", \"write\", \"admin\"]}";
+
+  parse_arena_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  ck_assert_int_eq(easyjsonparser_parse_string(input, ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(cfg.kept_len, 3);
+  ck_assert_int_eq(strcmp(cfg.name, "foo"), 0);
+  free(cfg.name);
+
+  easyjsonparser_arena * arena = easyjsonparser_arena_new();
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_arena(ctx, arena);
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.name = "not freed";
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, input, ys, &cfg), EASYJSONPARSER_SUCCESS);
+  easyjsonparser_ctx_free(ctx);
+
+  ck_assert_int_eq(cfg.kept_len, 3);
+  ck_assert_int_eq(strcmp(cfg.kept[0], "read"), 0);
+  ck_assert_int_eq(strcmp(cfg.kept[2], "admin"), 0);
+  ck_assert_int_eq(strcmp(cfg.name, "foo"), 0);
+  easyjsonparser_arena_free(arena);
+}
+END_TEST
+
+START_TEST (intern_add_success)
+{
+  easyjsonparser_intern * intern = easyjsonparser_intern_new();
+  ck_assert_ptr_ne(intern, NULL);
+
+  const char * strs[10000];
+  for (uint32_t i = 0; i < 10000; i++) {
+    char str[16];
+    snprintf(str, sizeof(str), "str%u", i);
+    uint32_t id;
+    strs[i] = easyjsonparser_intern_add(intern, str, strlen(str), &id);
+    ck_assert_ptr_ne(strs[i], NULL);
+    ck_assert_int_eq(id, i);
+  }
+  ck_assert_int_eq(easyjsonparser_intern_count(intern), 10000);
+
+  for (uint32_t i = 0; i < 10000; i++) {
+    char str[16];
+    snprintf(str, sizeof(str), "str%u", i);
+    uint32_t id;
+    ck_assert_ptr_eq(easyjsonparser_intern_add(intern, str, strlen(str), &id), strs[i]);
+    ck_assert_int_eq(id, i);
+    ck_assert_ptr_eq(easyjsonparser_intern_str(intern, i), strs[i]);
+  }
+  ck_assert_ptr_eq(easyjsonparser_intern_str(intern, 10000), NULL);
+
+  easyjsonparser_intern_reset(intern);
+  ck_assert_int_eq(easyjsonparser_intern_count(intern), 0);
+  uint32_t id;
+  ck_assert_int_eq(strcmp(easyjsonparser_intern_add(intern, "str9", 3, &id), "str"), 0);
+  ck_assert_int_eq(id, 0);
+
+  easyjsonparser_intern_free(intern);
+}
+END_TEST
+
+typedef struct {
+  int version;
+  int a;
+  int b;
+} parse_stop_cfg;
+
+START_TEST (parse_stop_when_complete_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(meta_ys)
+    EASYJSONPARSER_INT_FIELD("a", parse_stop_cfg, a, "a"),
+    EASYJSONPARSER_INT_FIELD("b", parse_stop_cfg, b, "b"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN)
+    EASYJSONPARSER_INT_FIELD("version", parse_stop_cfg, version, "version"),
+    EASYJSONPARSER_MAP("meta", meta_ys, "meta"),
+    EASYJSONPARSER_END();
+
+  // Nothing after the last value wanted is parsed, so need not be JSON.
+  static const char * complete[] = {
+    "{\"meta\": {\"b\": 2, \"a\": 1}, \"skipped\": [1, 2], \"version\": 3, junk",
+    "{\"version\": 3, \"meta\": {\"a\": 1, \"b\": 2, junk",
+    "{\"version\": 3, \"meta\": {\"a\": 1, \"version\": 4, \"b\": 2}} junk",
+    "{\"meta\": {\"a\": 1}, \"version\": 3 junk",
+    "{\"meta\": {\"a\": 1, \"b\": 2}, \"meta\": {}, \"version\": 3, junk",
+  };
+
+  easyjsonparser_schema * compiled_ys = easyjsonparser_schema_compile(ys);
+  ck_assert_ptr_ne(compiled_ys, NULL);
+
+  for (int indexed = 0; indexed <= 1; indexed++) {
+    easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+    easyjsonparser_ctx_set_backend(ctx, EASYJSONPARSER_BACKEND_NATIVE);
+    easyjsonparser_ctx_set_options(ctx, EASYJSONPARSER_OPTION_STOP_WHEN_COMPLETE);
+    ctx->index_min = indexed ? 0 : SIZE_MAX;
+
+    for (size_t i = 0; i < sizeof(complete) / sizeof(complete[0]); i++) {
+      parse_stop_cfg cfg = {0, 0, 0};
+      ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, complete[i], compiled_ys, &cfg), EASYJSONPARSER_SUCCESS);
+      ck_assert_int_eq(cfg.version, 3);
+      ck_assert_int_eq(cfg.a, 1);
+      ck_assert_int_eq(cfg.b, i == 3 ? 0 : 2);
+    }
+
+    // An incomplete document is still read to the end.
+    parse_stop_cfg cfg = {0, 0, 0};
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"meta\": {\"a\": 1, \"b\": 2}} ", compiled_ys, &cfg), EASYJSONPARSER_SUCCESS);
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"meta\": {\"a\": 1, \"b\": 2}} junk", compiled_ys, &cfg), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+
+    // As is everything if the schema is not compiled.
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, complete[1], ys, &cfg), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+
+    easyjsonparser_ctx_free(ctx);
+  }
+
+  ck_assert_int_eq(g_log_count_errs, 4);
+
+  easyjsonparser_schema_free(compiled_ys);
+}
+END_TEST
+
+START_TEST (cursor_success)
+{
+  static const char * json =
+    "{\"skipped\": [1, 2, true], \"str\\\\\\\"ing\": \"a\\tb\", \"sub\": {\"n\": -12, \"d\": 2.5, \"i\": 7, \"b\": true, \"z\": null},"
+    " \"list\": [\"x\", {\"k\": \"]}\"}, [], 3], \"empty\": {}}";
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_cursor root, sub, val, elem;
+  const char * str;
+  size_t len;
+  int64_t ival;
+  double dval;
+  int bval;
+
+  ck_assert_int_eq(easyjsonparser_cursor_init(ctx, &root, json, strlen(json)), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_type(&root), EASYJSONPARSER_SCHEMA_MAP);
+
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "sub", &sub), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&sub, "n", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_int(&val, &ival), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(ival, -12);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&sub, "d", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_double(&val, &dval), EASYJSONPARSER_SUCCESS);
+  ck_assert_double_eq(dval, 2.5);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&sub, "i", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_double(&val, &dval), EASYJSONPARSER_SUCCESS);
+  ck_assert_double_eq(dval, 7.0);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&sub, "b", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_bool(&val, &bval), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(bval, 1);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&sub, "z", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_type(&val), EASYJSONPARSER_SCHEMA_NUL);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&sub, "nope", &val), EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "nope", &val), EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND);
+  ck_assert_int_eq(EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND & EASYJSONPARSER_ERROR_FATAL_BITS, 0);
+  ck_assert_int_ne(EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND & EASYJSONPARSER_ERROR_CURSOR_BITS, 0);
+
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "str\\\"ing", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_str(&val, &str, &len), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(str, "a\tb");
+  ck_assert_int_eq(len, 3);
+
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "list", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_at(&val, 3, &elem), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_int(&elem, &ival), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(ival, 3);
+  ck_assert_int_eq(easyjsonparser_cursor_at(&val, 4, &elem), EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND);
+  ck_assert_int_eq(easyjsonparser_cursor_at(&val, 1, &elem), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&elem, "k", &elem), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_str(&elem, &str, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(str, "]}");
+
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "empty", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_first(&val, &elem), EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND);
+
+  // Iterating over a map gives the keys too.
+  static const char * keys[] = {"n", "d", "i", "b", "z"};
+  int n = 0;
+  int retval = easyjsonparser_cursor_first(&sub, &elem);
+  for (; retval == EASYJSONPARSER_SUCCESS; retval = easyjsonparser_cursor_next(&elem), n++) {
+    ck_assert_int_eq(easyjsonparser_cursor_get_key(&elem, &str, NULL), EASYJSONPARSER_SUCCESS);
+    ck_assert_str_eq(str, keys[n]);
+  }
+  ck_assert_int_eq(retval, EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND);
+  ck_assert_int_eq(n, 5);
+
+  ck_assert_int_eq(g_log_count_errs, 0);
+
+  // Values stepped over are still checked.
+  static const char * bad = "{\"skipped\": [1, 2, tru], \"sub\": {}}";
+  ck_assert_int_eq(easyjsonparser_cursor_init(ctx, &root, bad, strlen(bad)), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "sub", &sub), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+  ck_assert_int_eq(g_log_count_errs, 1);
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+
+void check_codegen_log (easyjsonparser_stack * stack, check_codegen_cfg * cfg, const char * fmt, ...)
+{
+  char path[128];
+  va_list ap;
+  va_start(ap, fmt);
+  sprintf(cfg->log + strlen(cfg->log), "%s=", easyjsonparser_stack_path_r(stack, path, sizeof(path)));
+  vsprintf(cfg->log + strlen(cfg->log), fmt, ap);
+  strcat(cfg->log, " ");
+  va_end(ap);
+}
+
+void check_codegen_str_handler (easyjsonparser_stack * stack, char * val, check_codegen_cfg * cfg)
+{
+  check_codegen_log(stack, cfg, "s:%s", val);
+}
+
+void check_codegen_int_handler (easyjsonparser_stack * stack, int val, check_codegen_cfg * cfg)
+{
+  check_codegen_log(stack, cfg, "i:%d", val);
+}
+
+void check_codegen_i64_handler (easyjsonparser_stack * stack, int64_t val, check_codegen_cfg * cfg)
+{
+  check_codegen_log(stack, cfg, "l:%lld", (long long) val);
+}
+
+void check_codegen_dbl_handler (easyjsonparser_stack * stack, double val, check_codegen_cfg * cfg)
+{
+  check_codegen_log(stack, cfg, "d:%g", val);
+}
+
+void check_codegen_bool_handler (easyjsonparser_stack * stack, int val, check_codegen_cfg * cfg)
+{
+  check_codegen_log(stack, cfg, "b:%d", val);
+}
+
+void check_codegen_null_handler (easyjsonparser_stack * stack, check_codegen_cfg * cfg)
+{
+  check_codegen_log(stack, cfg, "null");
+}
+
+START_TEST (codegen_parse_success)
+{
+  const char * json =
+    "{\"name\": \"ca\\u0066e\", \"port\": 12345678901, \"ts\": 1700000000123, \"ratio\": 0.5,"
+    " \"ssl\": true, \"path\": \"/api\", \"none\": null,"
+    " \"users\": {\"bob\": {\"uid\": 7, \"admin\": false}, \"a\\\"lice\": {\"admin\": true}},"
+    " \"extra\": {\"x\": [1, {\"y\": 2}], \"k\": \"v\"},"
+    " \"items\": [\"a\", -3, 1.5e1, \"b\"], \"\\u0070ort\": 80}";
+
+  // The generated parser and the library given the generated tables agree.
+  check_codegen_cfg cfg, table_cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  memset(&table_cfg, 0, sizeof(table_cfg));
+  ck_assert_int_eq(check_codegen_parse_string(json, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parse_string(json, check_codegen_schema, &table_cfg), EASYJSONPARSER_SUCCESS);
+
+  ck_assert_str_eq(cfg.name, "cafe");
+  ck_assert_int_eq(cfg.port, 80);
+  ck_assert(cfg.ts == INT64_C(1700000000123));
+  ck_assert(cfg.ratio == 0.5);
+  ck_assert_int_eq(cfg.ssl, 1);
+  ck_assert_str_eq(cfg.log, table_cfg.log);
+  ck_assert_str_eq(table_cfg.name, cfg.name);
+  ck_assert_int_eq(table_cfg.port, cfg.port);
+  ck_assert(strstr(cfg.log, "/users/bob/uid=i:7 ") != NULL);
+  ck_assert(strstr(cfg.log, "d:15 ") != NULL);
+  free(cfg.name);
+  free(table_cfg.name);
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  memset(&cfg, 0, sizeof(cfg));
+  ck_assert_int_eq(check_codegen_ctx_parse_string(ctx, " [] ", &cfg), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP);
+  ck_assert_int_eq(g_log_count_errs, 1);
+  ck_assert_int_eq(check_codegen_ctx_parse_string(ctx, "{\"port\": \"80\"}", &cfg), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  ck_assert_int_eq(g_log_count_errs, 2);
+  ck_assert_int_eq(check_codegen_ctx_parse_string(ctx, "{\"ports\": 80}", &cfg), EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY);
+  ck_assert_int_eq(g_log_count_errs, 3);
+  ck_assert_int_eq(check_codegen_ctx_parse_string(ctx, "{\"items\": [true]}", &cfg), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING);
+  ck_assert_int_eq(g_log_count_errs, 4);
+  ck_assert_int_eq(check_codegen_ctx_parse_string(ctx, "{\"users\": {\"bob\": {\"uid\": 1,}}}", &cfg), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+  ck_assert_int_eq(g_log_count_errs, 5);
+  ck_assert_int_eq(check_codegen_ctx_parse_string(ctx, "{\"ssl\": false} x", &cfg), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+  ck_assert_int_eq(g_log_count_errs, 6);
+  ck_assert_int_eq(check_codegen_ctx_parse_string(ctx, "{\"path\": \"\xff\"}", &cfg), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  ck_assert_int_eq(g_log_count_errs, 7);
+  ck_assert_int_eq(check_codegen_ctx_parse_string(ctx, "{\"ssl\": false, \"items\": [], \"users\": {}}", &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(cfg.ssl, 0);
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+typedef struct {
+  char * name;
+  int    port;
+} write_item;
+
+typedef struct {
+  char *     name;
+  int        port;
+  double     ratio;
+  int        ssl;
+  int64_t    ts;
+  write_item items[2];
+  int        nums[3];
+  double     xs[2];
+} write_cfg;
+
+int write_getter (easyjsonparser_stack * stack, easyjsonparser_schema * js, size_t n, easyjsonparser_value * val, void * extra)
+{
+  write_cfg * cfg = (write_cfg *) extra;
+
+  if (strcmp(js->key, "other") == 0) {
+    val->i = 42;
+  } else if (n == 0) {
+    return EASYJSONPARSER_SUCCESS;
+  } else if (strcmp(js->key, "items") == 0) {
+    if (n > 2)
+      return EASYJSONPARSER_WRITE_NONE;
+    val->cfg = &cfg->items[n - 1];
+  } else if (strcmp(js->key, "nums") == 0) {
+    if (n > 3)
+      return EASYJSONPARSER_WRITE_NONE;
+    val->i = cfg->nums[n - 1];
+  } else if (strcmp(js->key, "env") == 0) {
+    if (n > 2)
+      return EASYJSONPARSER_WRITE_NONE;
+    val->key = n == 1 ? "HOME" : "SHELL";
+    val->str = n == 1 ? "/root" : "/bin/sh";
+  } else if (strcmp(js->key, "xs") == 0) {
+    if (n > 2)
+      return EASYJSONPARSER_WRITE_NONE;
+    val->d = cfg->xs[n - 1];
+  }
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+START_TEST (write_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sub_ys)
+    EASYJSONPARSER_STR_FIELD("name", write_cfg, name, "name field"),
+    EASYJSONPARSER_INT_FIELD("port", write_cfg, port, "port field"),
+    EASYJSONPARSER_DBL_FIELD("ratio", write_cfg, ratio, "ratio field"),
+    EASYJSONPARSER_BOO_FIELD("ssl", write_cfg, ssl, "ssl field"),
+    EASYJSONPARSER_I64_FIELD("ts", write_cfg, ts, "timestamp field"),
+    EASYJSONPARSER_INT("other", NULL, "other kvp"),
+    EASYJSONPARSER_NUL("none", NULL, "none kvp"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(item_ys)
+    EASYJSONPARSER_STR_FIELD("name", write_item, name, "item name field"),
+    EASYJSONPARSER_INT_FIELD("port", write_item, port, "item port field"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(items_ys)
+    EASYJSONPARSER_MAP(NULL, item_ys, "item"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(nums_ys)
+    EASYJSONPARSER_INT(NULL, NULL, "number"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(env_ys)
+    EASYJSONPARSER_STR(NULL, NULL, "environment variable"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub obj"),
+    EASYJSONPARSER_LST("items", items_ys, "items list"),
+    EASYJSONPARSER_LST("nums", nums_ys, "numbers list"),
+    EASYJSONPARSER_MAP("env", env_ys, "environment"),
+    EASYJSONPARSER_DBL_ARRAY("xs", NULL, "xs array"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(sub_only_ys, EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN)
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub obj"),
+    EASYJSONPARSER_END();
+
+  static const char * expected =
+    "{\"sub\":{\"name\":\"fo\\\"o\\n\",\"port\":80,\"ratio\":0.5,\"ssl\":true,\"ts\":1700000000123,\"other\":42,\"none\":null},"
+    "\"items\":[{\"name\":\"a\",\"port\":1},{\"name\":\"b\",\"port\":2}],"
+    "\"nums\":[1,-2,3],"
+    "\"env\":{\"HOME\":\"/root\",\"SHELL\":\"/bin/sh\"},"
+    "\"xs\":[0.1,1e23]}";
+
+  write_cfg cfg = {"fo\"o\n", 80, 0.5, 1, INT64_C(1700000000123), {{"a", 1}, {"b", 2}}, {1, -2, 3}, {0.1, 1e23}};
+  char * out;
+  size_t len;
+
+  ck_assert_int_eq(easyjsonparser_write(&out, &len, ys, &cfg, write_getter), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(out, expected);
+  ck_assert_uint_eq(len, strlen(expected));
+
+  // What is written parses back to the same.
+  write_cfg parsed;
+  memset(&parsed, 0, sizeof(parsed));
+  ck_assert_int_eq(easyjsonparser_parse_string(out, sub_only_ys, &parsed), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(parsed.name, cfg.name);
+  ck_assert_int_eq(parsed.port, cfg.port);
+  ck_assert(parsed.ratio == cfg.ratio);
+  ck_assert_int_eq(parsed.ssl, cfg.ssl);
+  ck_assert(parsed.ts == cfg.ts);
+  free(parsed.name);
+  free(out);
+
+  // Into a buffer, just big enough.
+  char buf[512];
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, strlen(expected) + 1, &len, ys, &cfg, write_getter), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(buf, expected);
+  ck_assert_uint_eq(len, strlen(expected));
+
+  // Without a getter, only fields, and the maps they are in, are written,
+  // and a NULL string field is left out.
+  cfg.name = NULL;
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, ys, &cfg, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(buf, "{\"sub\":{\"port\":80,\"ratio\":0.5,\"ssl\":true,\"ts\":1700000000123},\"items\":[],\"nums\":[],\"env\":{},\"xs\":[]}");
+
+  // The same with a compiled schema.
+  easyjsonparser_schema * compiled_ys = easyjsonparser_schema_compile(ys);
+  ck_assert_ptr_ne(compiled_ys, NULL);
+  cfg.name = "fo\"o\n";
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, compiled_ys, &cfg, write_getter), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(buf, expected);
+  easyjsonparser_schema_free(compiled_ys);
+}
+END_TEST
+
+void write_strings_handler (easyjsonparser_stack * stack, char * val, char * expected)
+{
+  ck_assert_str_eq(val, expected);
+}
+
+int write_strings_getter (easyjsonparser_stack * stack, easyjsonparser_schema * js, size_t n, easyjsonparser_value * val, void * str)
+{
+  if (n > 1)
+    return EASYJSONPARSER_WRITE_NONE;
+
+  val->str = (const char *) str;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+int write_strings_view_getter (easyjsonparser_stack * stack, easyjsonparser_schema * js, size_t n, easyjsonparser_value * val, void * views)
+{
+  if (n > 2)
+    return EASYJSONPARSER_WRITE_NONE;
+
+  val->str = n == 1 ? (const char *) views : strstr((const char *) views, "xyz");
+  val->len = n == 1 ? 0 : 3;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+START_TEST (write_strings_success)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_LST)
+    EASYJSONPARSER_STR(NULL, write_strings_handler, "string"),
+    EASYJSONPARSER_END();
+
+  char buf[512];
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, ys, "a\"b\\c\x01\x1f\t\x7f\xc3\xa9", write_strings_getter), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(buf, "[\"a\\\"b\\\\c\\u0001\\u001f\\t\x7f\xc3\xa9\"]");
+
+  // A view is written to its length, an empty one included.
+  static const char * views = "\",\"b\":\"xyz\"}";
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, ys, (void *) views, write_strings_view_getter), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(buf, "[\"\",\"xyz\"]");
+
+  // Each character which must be escaped at every position of strings of
+  // every length up to a few vectors, with each instruction set.
+  static const char specials[] = "\"\\\n\x01\x1f";
+  char str[100];
+  for (int isa = EJP_ISA_SCALAR; isa <= EJP_ISA_BEST; isa++) {
+    easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+    ctx->isa = isa;
+
+    for (size_t len = 1; len < sizeof(str); len++) {
+      for (size_t pos = 0; pos < len; pos++) {
+        memset(str, ' ' + len % 64, len);
+        str[len] = '\0';
+        str[pos] = specials[(len + pos) % (sizeof(specials) - 1)];
+
+        char * out;
+        ck_assert_int_eq(easyjsonparser_ctx_write(ctx, &out, NULL, ys, str, write_strings_getter), EASYJSONPARSER_SUCCESS);
+        ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, out, ys, str), EASYJSONPARSER_SUCCESS);
+        free(out);
+      }
+    }
+
+    easyjsonparser_ctx_free(ctx);
+  }
+}
+END_TEST
+
+/// Count the significant digits of the number formatted at \p num.
+
+int write_numbers_digits (const char * num)
+{
+  char digits[EJP_FORMAT_MAX];
+  int n = 0;
+
+  for (const char * p = num; *p != '\0' && *p != 'e'; p++)
+    if (*p >= '0' && *p <= '9' && (n > 0 || *p != '0'))
+      digits[n++] = *p;
+  while (n > 0 && digits[n - 1] == '0')
+    n--;
+
+  return n;
+}
+
+START_TEST (write_numbers_success)
+{
+  static const double hard[] = {
+    0.1, 0.0, -0.0, 1.0, -1.5, 1e21, 1e22, 1e23, 123456789012345678.0, 9007199254740993.0,
+    1.7976931348623157e308, 2.2250738585072014e-308, 2.2250738585072009e-308, 4.9406564584124654e-324,
+    5e-324, 1e-7, 1.5e-6, 0.000001, 3.0e23, 2.5e-5, 8.41e21, 1.448997445238699, 0.3, 2.0 / 3.0,
+  };
+  enum { NUMS = 100000 };
+
+  size_t n_hard = sizeof(hard) / sizeof(hard[0]);
+  char num[EJP_FORMAT_MAX + 1];
+  char check[EJP_FORMAT_MAX];
+
+  // The hard cases, then random doubles, each of which must convert back
+  // to the same double, with as few digits as any which do.
+  uint64_t r = 0x9e3779b97f4a7c15ull;
+  for (int i = 0; i < NUMS; i++) {
+    r ^= r << 13;
+    r ^= r >> 7;
+    r ^= r << 17;
+
+    double d;
+    if ((size_t) i < n_hard) {
+      d = hard[i];
+    } else {
+      uint64_t bits = r & ~(0x7ffull << 52);
+      bits |= ((r >> 52) % 0x7ff) << 52;
+      memcpy(&d, &bits, sizeof(d));
+    }
+
+    size_t len = ejp_format_double(num, d);
+    ck_assert(len < EJP_FORMAT_MAX);
+    num[len] = '\0';
+    ck_assert_msg(strpbrk(num, ".e") != NULL, "double %.17g formatted as %s", d, num);
+
+    double back = strtod(num, NULL);
+    ck_assert_msg(memcmp(&back, &d, sizeof(d)) == 0, "double %.17g formatted as %s", d, num);
+
+    int shortest = 1;
+    while (shortest < 17) {
+      snprintf(check, sizeof(check), "%.*e", shortest - 1, d);
+      if (strtod(check, NULL) == d)
+        break;
+      shortest++;
+    }
+    ck_assert_msg(write_numbers_digits(num) <= shortest, "double %.17g formatted as %s, not %d digits", d, num, shortest);
+  }
+
+  static const int64_t ints[] = {0, 1, -1, 9, 10, 99, 100, -100, 12345, INT32_MAX, INT32_MIN, INT64_MAX, INT64_MIN};
+  for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+    num[ejp_format_int64(num, ints[i])] = '\0';
+    snprintf(check, sizeof(check), "%lld", (long long) ints[i]);
+    ck_assert_str_eq(num, check);
+  }
+}
+END_TEST
+
+void write_fd_sum_handler (easyjsonparser_stack * stack, int64_t val, int64_t * sum)
+{
+  *sum += val;
+}
+
+int write_fd_getter (easyjsonparser_stack * stack, easyjsonparser_schema * js, size_t n, easyjsonparser_value * val, void * extra)
+{
+  if (n > 100000)
+    return EASYJSONPARSER_WRITE_NONE;
+
+  val->i = n * 1000003;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+START_TEST (write_fd_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(nums_ys)
+    EASYJSONPARSER_I64(NULL, write_fd_sum_handler, "number"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("nums", nums_ys, "numbers"),
+    EASYJSONPARSER_END();
+
+  int fd = open("check_json_test_output_file.json", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  ck_assert_int_ge(fd, 0);
+  ck_assert_int_eq(easyjsonparser_write_fd(fd, ys, NULL, write_fd_getter), EASYJSONPARSER_SUCCESS);
+  close(fd);
+
+  // Well over the buffer, so flushed many times, and the same as written
+  // into memory.
+  char * out;
+  size_t len;
+  ck_assert_int_eq(easyjsonparser_write(&out, &len, ys, NULL, write_fd_getter), EASYJSONPARSER_SUCCESS);
+  ck_assert(len > EJP_WRITE_BUFFER * 4);
+
+  struct stat st;
+  ck_assert_int_eq(stat("check_json_test_output_file.json", &st), 0);
+  ck_assert_uint_eq((size_t) st.st_size, len);
+
+  int64_t sum = 0;
+  ck_assert_int_eq(easyjsonparser_parse_file("check_json_test_output_file.json", ys, &sum), EASYJSONPARSER_SUCCESS);
+  ck_assert(sum == INT64_C(1000003) * 100000 * 100001 / 2);
+
+  free(out);
+  unlink("check_json_test_output_file.json");
+}
+END_TEST
+
+START_TEST (write_unwritable_quashed_omits_value)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_DBL_FIELD("ratio", write_cfg, ratio, "ratio field"),
+    EASYJSONPARSER_INT_FIELD("port", write_cfg, port, "port field"),
+    EASYJSONPARSER_END();
+
+  write_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.ratio = 1.0 / 0.0;
+  cfg.port  = 80;
+
+  char buf[64];
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, ys, &cfg, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_str_eq(buf, "{\"port\":80}");
+  ck_assert_int_eq(g_errhandler_count, 1);
+}
+END_TEST
+
+START_TEST (utf8_validate_success)
+{
+  static const struct { const char * str; int valid; size_t offset; } cases[] = {
+    { "plain ascii",          1, 0 },
+    { "\xc3\xa9",             1, 0 },
+    { "\xe2\x82\xac",         1, 0 },
+    { "\xf0\x9f\x98\x80",     1, 0 },
+    { "\xef\xbf\xbf\xf4\x8f\xbf\xbf", 1, 0 },
+    { "a\x80",                0, 1 },
+    { "\xc0\x80",             0, 0 },
+    { "\xc1\xbf",             0, 0 },
+    { "\xe0\x80\x80",         0, 0 },
+    { "\xed\xa0\x80",         0, 0 },
+    { "\xf0\x80\x80\x80",     0, 0 },
+    { "\xf4\x90\x80\x80",     0, 0 },
+    { "\xf5\x80\x80\x80",     0, 0 },
+    { "\xff",                 0, 0 },
+    { "\xc3\xa9\xe2\x82 ",    0, 2 },
+    { "ab\xe2\x82",           0, 2 },
+  };
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+
+  // Each case at every offset across a vector or two of ASCII.
+  for (int isa = EJP_ISA_SCALAR; isa <= EJP_ISA_BEST; isa++) {
+    ctx->isa = isa;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+      for (size_t pad = 0; pad < 80; pad++) {
+        char buf[128];
+        size_t len = strlen(cases[c].str);
+        memset(buf, ' ', pad);
+        memcpy(buf + pad, cases[c].str, len);
+        size_t offset = SIZE_MAX;
+        ck_assert_int_eq(ejp_utf8_validate(ctx, buf, pad + len, &offset), cases[c].valid);
+        if (!cases[c].valid)
+          ck_assert_int_eq(offset, pad + cases[c].offset);
+      }
+    }
+  }
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+typedef struct {
+  const char * strs[8];
+  uint32_t     ids[8];
+  int          len;
+} parse_intern_cfg;
+
+void parse_intern_handler (easyjsonparser_stack * stack, const char * str, uint32_t id, parse_intern_cfg * cfg)
+{
+  cfg->strs[cfg->len] = str;
+  cfg->ids[cfg->len]  = id;
+  cfg->len++;
+}
+
+START_TEST (parse_intern_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(access_ys)
+    EASYJSONPARSER_STR_INTERN(NULL, parse_intern_handler, "access entry"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("access", access_ys, "access list"),
+    EASYJSONPARSER_END();
+
+  const char * input = "{\"access\": [\"read\", \"write\", \"read\", \"adm\\u0069n\", \"write\", \"admin\"]}";
+
+  parse_intern_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  ck_assert_int_eq(easyjsonparser_parse_string(input, ys, &cfg), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(cfg.len, 6);
+  ck_assert_int_eq(cfg.ids[0], 0);
+  ck_assert_int_eq(cfg.ids[1], 1);
+  ck_assert_int_eq(cfg.ids[2], 0);
+  ck_assert_int_eq(cfg.ids[3], 2);
+  ck_assert_int_eq(cfg.ids[4], 1);
+  ck_assert_int_eq(cfg.ids[5], 2);
+
+  easyjsonparser_intern * intern = easyjsonparser_intern_new();
+  uint32_t admin_id;
+  const char * admin = easyjsonparser_intern_add(intern, "admin", 5, &admin_id);
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_intern(ctx, intern);
+
+  for (int i = 0; i < 2; i++) {
+    memset(&cfg, 0, sizeof(cfg));
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, input, ys, &cfg), EASYJSONPARSER_SUCCESS);
+    ck_assert_int_eq(cfg.len, 6);
+    ck_assert_int_eq(cfg.ids[0], 1);
+    ck_assert_int_eq(cfg.ids[1], 2);
+    ck_assert_int_eq(cfg.ids[3], admin_id);
+    ck_assert_ptr_eq(cfg.strs[0], cfg.strs[2]);
+    ck_assert_ptr_eq(cfg.strs[3], admin);
+    ck_assert_ptr_eq(cfg.strs[5], admin);
+    ck_assert_int_eq(strcmp(cfg.strs[4], "write"), 0);
+  }
+  ck_assert_int_eq(easyjsonparser_intern_count(intern), 3);
+
+  easyjsonparser_ctx_free(ctx);
+  ck_assert_int_eq(strcmp(easyjsonparser_intern_str(intern, cfg.ids[1]), "write"), 0);
+  easyjsonparser_intern_free(intern);
+}
+END_TEST
+
+typedef struct {
+  char ** expected;
+  int     expected_len;
+  int     seen;
+  int     pairs_seen;
+} parse_indexed_cfg;
+
+void parse_indexed_s_handler (easyjsonparser_stack * stack, char * val, parse_indexed_cfg * cfg)
+{
+  ck_assert_int_lt(cfg->seen, cfg->expected_len);
+  ck_assert_str_eq(val, cfg->expected[cfg->seen]);
+  cfg->seen++;
+}
+
+void parse_indexed_pair_handler (easyjsonparser_stack * stack, char * val, parse_indexed_cfg * cfg)
+{
+  ck_assert_int_eq(strlen(val), cfg->pairs_seen < 1 ? 3 : 100000);
+  cfg->pairs_seen++;
+}
+
+/// Build a document of strings full of escapes and structural characters,
+/// with backslash runs and quotes falling at every offset in a 64 byte
+/// block, setting \p expected to the unescaped strings.
+
+static char * parse_indexed_mk_json (int n, char *** expected)
+{
+  size_t json_size = 256 + (size_t) n * 200 + 2 * 100000;
+  char * json = (char *) malloc(json_size);
+  char * p = json;
+
+  *expected = (char **) malloc(n * sizeof(char *));
+
+  p += sprintf(p, "{\"items\": [");
+  for (int i = 0; i < n; i++) {
+    char * exp = (*expected)[i] = (char *) malloc(200);
+    char * e = exp;
+
+    p += sprintf(p, "%s{\"n\": %d, \"s\": \"", i ? ", " : "", i);
+    for (int k = 0; k < i % 67; k++)
+      *p++ = *e++ = 'x';
+    for (int k = 0; k < i % 5; k++) {
+      *p++ = '\\';
+      *p++ = '\\';
+      *e++ = '\\';
+    }
+    const char * raw = i % 3 == 0 ? "{[:,]}" : i % 3 == 1 ? "\\\"}\\\"" : "a\\nb";
+    const char * dec = i % 3 == 0 ? "{[:,]}" : i % 3 == 1 ? "\"}\"" : "a\nb";
+    p += sprintf(p, "%s\"}", raw);
+    e += sprintf(e, "%s", dec);
+  }
+  p += sprintf(p, "], \"pairs\": [\"abc\", \"");
+  memset(p, 'y', 100000);
+  p += 100000;
+  p += sprintf(p, "\"]}");
+
+  return json;
+}
+
+START_TEST (parse_indexed_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(item_ys)
+    EASYJSONPARSER_INT("n", NULL, "number"),
+    EASYJSONPARSER_STR("s", parse_indexed_s_handler, "string"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(items_ys)
+    EASYJSONPARSER_MAP(NULL, item_ys, "item"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(pairs_ys)
+    EASYJSONPARSER_STR(NULL, parse_indexed_pair_handler, "pair"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("items", items_ys, "items"),
+    EASYJSONPARSER_LST("pairs", pairs_ys, "pairs"),
+    EASYJSONPARSER_END();
+
+  parse_indexed_cfg cfg;
+  cfg.expected_len = 3000;
+  char * json = parse_indexed_mk_json(cfg.expected_len, &cfg.expected);
+
+  for (int isa = EJP_ISA_SCALAR; isa <= EJP_ISA_BEST; isa++) {
+    easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+    ctx->index_min = 0;
+    ctx->isa = isa;
+
+    cfg.seen       = 0;
+    cfg.pairs_seen = 0;
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, ys, &cfg), EASYJSONPARSER_SUCCESS);
+    ck_assert_int_eq(cfg.seen, cfg.expected_len);
+    ck_assert_int_eq(cfg.pairs_seen, 2);
+
+    easyjsonparser_ctx_free(ctx);
+  }
+
+  for (int i = 0; i < cfg.expected_len; i++)
+    free(cfg.expected[i]);
+  free(cfg.expected);
+  free(json);
+}
+END_TEST
+
+void parse_trusted_input_handler (easyjsonparser_stack * stack, char * val, int * callcount)
+{
+  (*callcount)++;
+  ck_assert_str_eq(val, "ab\xff");
+}
+
+START_TEST (parse_trusted_input_success)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", parse_trusted_input_handler, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_options(ctx, EASYJSONPARSER_OPTION_TRUSTED_INPUT);
+
+  int callcount = 0;
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"foo\": \"ab\xff\"}", ys, &callcount), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(callcount, 1);
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+START_TEST (compiled_parse_nested_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sub_sub_ys)
+    EASYJSONPARSER_STR("foo", handler_callback_stack_traces_path_foo_callback_handler, "foo test kvp"),
+    EASYJSONPARSER_INT("bar", handler_callback_stack_traces_path_bar_callback_handler, "bar test kvp"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(sub_ys)
+    EASYJSONPARSER_MAP(NULL, sub_sub_ys, "sub sub obj"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub obj"),
+    EASYJSONPARSER_LST("list", sub_sub_ys, "sub list"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_schema * compiled_ys = easyjsonparser_schema_compile(ys);
+  ck_assert_ptr_ne(compiled_ys, NULL);
+
+  handler_callback_stack_traces_path_foo_callback_handler_callcount = 0;
+  handler_callback_stack_traces_path_bar_callback_handler_callcount = 0;
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\":{\"abc\":{\"foo\":\"yadda\",\"bar\":123}}}", compiled_ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(handler_callback_stack_traces_path_foo_callback_handler_callcount, 1);
+  ck_assert_int_eq(handler_callback_stack_traces_path_bar_callback_handler_callcount, 1);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\":{\"abc\":{\"baz\":1}}}", compiled_ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY);
+  ck_assert_int_eq(g_log_count_errs, 1);
+
+  easyjsonparser_schema_free(compiled_ys);
+}
+END_TEST
+
+START_TEST (compiled_parse_many_keys_success)
+{
+  static char keys[100][8];
+  static easyjsonparser_schema ys[102];
+
+  ys[0].type = EASYJSONPARSER_SCHEMA_ROO | EASYJSONPARSER_SCHEMA_MAP;
+  char json[2048];
+  char * p = json + sprintf(json, "{");
+  for (int i = 0; i < 100; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+    ys[i + 1].key   = keys[i];
+    ys[i + 1].type  = EASYJSONPARSER_SCHEMA_INT;
+    ys[i + 1].data  = calls_int_handler_callback_handler;
+    ys[i + 1].descr = "test kvp";
+    p += sprintf(p, "%s\"key%d\": 123", i ? ", " : "", 99 - i);
+  }
+  sprintf(p, "}");
+
+  easyjsonparser_schema * compiled_ys = easyjsonparser_schema_compile(ys);
+  ck_assert_ptr_ne(compiled_ys, NULL);
+
+  calls_int_handler_callback_handler_callcount = 0;
+  ck_assert_int_eq(easyjsonparser_parse_string(json, compiled_ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_int_handler_callback_handler_callcount, 100);
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"key100\": 123}", compiled_ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY);
+
+  easyjsonparser_schema_free(compiled_ys);
+}
+END_TEST
+
+START_TEST (push_parse_bytewise_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sub_sub_ys)
+    EASYJSONPARSER_STR("foo", handler_callback_stack_traces_path_foo_callback_handler, "foo test kvp"),
+    EASYJSONPARSER_INT("bar", handler_callback_stack_traces_path_bar_callback_handler, "bar test kvp"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(sub_ys)
+    EASYJSONPARSER_MAP(NULL, sub_sub_ys, "sub sub obj"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub obj"),
+    EASYJSONPARSER_END();
+
+  const char * json = "{\"sub\":{\"abc\":{\"foo\":\"yadda\",\"bar\":123}}}\n";
+
+  handler_callback_stack_traces_path_foo_callback_handler_callcount = 0;
+  handler_callback_stack_traces_path_bar_callback_handler_callcount = 0;
+
+  easyjsonparser_parser * parser = easyjsonparser_parser_new(ys, NULL);
+  ck_assert_ptr_ne(parser, NULL);
+  for (size_t i = 0; i < strlen(json); i++)
+    ck_assert_int_eq(easyjsonparser_parser_feed(parser, json + i, 1), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_finish(parser), EASYJSONPARSER_SUCCESS);
+  easyjsonparser_parser_free(parser);
+
+  ck_assert_int_eq(handler_callback_stack_traces_path_foo_callback_handler_callcount, 1);
+  ck_assert_int_eq(handler_callback_stack_traces_path_bar_callback_handler_callcount, 1);
+}
+END_TEST
+
+START_TEST (push_parse_chunked_success)
+{
+  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", calls_string_handler_callback_handler, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  calls_string_handler_callback_handler_callcount = 0;
+
+  easyjsonparser_parser * parser = easyjsonparser_parser_new(empty_ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"fo", 4), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "o\": \"foov", 9), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_string_handler_callback_handler_callcount, 0);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "al\"}  \n", 7), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_string_handler_callback_handler_callcount, 1);
+  ck_assert_int_eq(easyjsonparser_parser_finish(parser), EASYJSONPARSER_SUCCESS);
+  easyjsonparser_parser_free(parser);
+}
+END_TEST
+
+START_TEST (push_parse_split_utf8_success)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR_FIELD("name", parse_fields_cfg, name, "name field"),
+    EASYJSONPARSER_END();
+
+  parse_fields_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+
+  // A four byte sequence split three ways.
+  easyjsonparser_parser * parser = easyjsonparser_parser_new(ys, &cfg);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"name\": \"\xf0\x9f", 12), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "\x98", 1), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "\x80\"}", 3), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_finish(parser), EASYJSONPARSER_SUCCESS);
+  easyjsonparser_parser_free(parser);
+
+  ck_assert_str_eq(cfg.name, "\xf0\x9f\x98\x80");
+  free(cfg.name);
+}
+END_TEST
+
+START_TEST (parse_badschema_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  ys[0].type = 123;
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": \"fooval\"}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_INVALID);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_file_success)
+{
+  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  int fd = open("check_json_test_input_file.json", O_CREAT | O_WRONLY | O_TRUNC, 0666);
+  ck_assert_int_ge(fd, 0);
+  ck_assert_int_eq(write(fd, "{\"foo\": \"fooval\"}\n", strlen("{\"foo\": \"fooval\"}\n")), strlen("{\"foo\": \"fooval\"}\n"));
+  close(fd);
+
+  ck_assert_int_eq(easyjsonparser_parse_file("check_json_test_input_file.json", empty_ys, NULL), EASYJSONPARSER_SUCCESS);
+
+  unlink("check_json_test_input_file.json");
+}
+END_TEST
+
+START_TEST (parse_buffer_success)
+{
+  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", calls_string_handler_callback_handler, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  // Deliberately not zero byte terminated, and followed by more data.
+  static const char frames[] = {
+    '{', '"', 'f', 'o', 'o', '"', ':', '"', 'f', 'o', 'o', 'v', 'a', 'l', '"', '}',
+    '{', '"', 'b', 'a', 'd'
+  };
+
+  calls_string_handler_callback_handler_callcount = 0;
+  ck_assert_int_eq(easyjsonparser_parse_buffer(frames, 16, empty_ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_string_handler_callback_handler_callcount, 1);
+}
+END_TEST
+
+START_TEST (parse_file_large_success)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sub_ys)
+    EASYJSONPARSER_INT(NULL, calls_int_handler_callback_handler, "bar test kvp"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("sub", sub_ys, "sub data"),
+    EASYJSONPARSER_END();
+
+  FILE * fh = fopen("check_json_test_input_file.json", "w");
+  ck_assert_ptr_ne(fh, NULL);
+  fprintf(fh, "{\"sub\": [123");
+  for (int i = 1; i < 200000; i++)
+    fprintf(fh, ", 123");
+  fprintf(fh, "]}");
+  fclose(fh);
+
+  calls_int_handler_callback_handler_callcount = 0;
+  ck_assert_int_eq(easyjsonparser_parse_file("check_json_test_input_file.json", ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_int_handler_callback_handler_callcount, 200000);
+
+  unlink("check_json_test_input_file.json");
+}
+END_TEST
+
+START_TEST (parse_file_fifo_success)
+{
+  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", calls_string_handler_callback_handler, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  unlink("check_json_test_input_fifo.json");
+  ck_assert_int_eq(mkfifo("check_json_test_input_fifo.json", 0666), 0);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    int fd = open("check_json_test_input_fifo.json", O_WRONLY);
+    for (int i = 0; i < 10000; i++)
+      if (write(fd, " ", 1) != 1)
+        _exit(1);
+    if (write(fd, "{\"foo\": \"fooval\"}\n", strlen("{\"foo\": \"fooval\"}\n")) < 0)
+      _exit(1);
+    close(fd);
+    _exit(0);
+  }
+
+  calls_string_handler_callback_handler_callcount = 0;
+  ck_assert_int_eq(easyjsonparser_parse_file("check_json_test_input_fifo.json", empty_ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(calls_string_handler_callback_handler_callcount, 1);
+
+  waitpid(pid, NULL, 0);
+  unlink("check_json_test_input_fifo.json");
+}
+END_TEST
+
+START_TEST (parse_file_nonexisting_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_file("check_json_test_input_nonexisting_file.json", empty_ys, NULL), EASYJSONPARSER_ERROR_FILEOPEN);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_expected_list_fails_errlogs)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sublist_ys)
+    EASYJSONPARSER_STR(NULL, NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_LST("sub", sublist_ys, "sub data"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\":{\"deeper\":{\"foo\":\"fooval\"}}}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_LIST);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_expected_map_fails_errlogs)
+{
+  static EASYJSONPARSER_SUBSCHEMA(subobj_ys)
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("sub", subobj_ys, "sub data"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"sub\":\"unexpectedval\"}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_expected_str_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\":{\"deeper\":{}}}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_expected_int_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_INT("bar", NULL, "bar test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"bar\":{\"deeper\":{}}}\n", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (schema_compile_invalid_fails_errlogs)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sub_ys)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub obj"),
+    EASYJSONPARSER_END();
+
+  sub_ys[0].type = 123;
+
+  ck_assert_ptr_eq(easyjsonparser_schema_compile(ys), NULL);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (schema_compile_nochildren_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("sub", NULL, "sub obj"),
+    EASYJSONPARSER_END();
+
+  ck_assert_ptr_eq(easyjsonparser_schema_compile(ys), NULL);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_syntax_error_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": }", ys, NULL), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_trailing_garbage_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": \"fooval\"} x", ys, NULL), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_unterminated_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": \"fooval", ys, NULL), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_indexed_unterminated_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  for (int isa = EJP_ISA_SCALAR; isa < EJP_ISA_BEST; isa++) {
+    easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+    ctx->index_min = 0;
+    ctx->isa = isa;
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"foo\": \"foo\\\"val}", ys, NULL), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+    easyjsonparser_ctx_free(ctx);
+  }
+  ck_assert_int_eq(g_log_count_errs, EJP_ISA_BEST);
+}
+END_TEST
+
+START_TEST (parse_lenient_unterminated_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  for (size_t index_min = 0; index_min <= 1; index_min++) {
+    easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+    ctx->index_min = index_min ? SIZE_MAX : 0;
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"naughty\": {\"a\": [\"}]\"}, \"foo\": \"fooval\"}", ys, NULL), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+    easyjsonparser_ctx_free(ctx);
+  }
+  ck_assert_int_eq(g_log_count_errs, 2);
+}
+END_TEST
+
+START_TEST (parse_lenient_malformed_fails_errlogs)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sub)
+    EASYJSONPARSER_INT("a", NULL, "a test kvp"),
+    EASYJSONPARSER_END();
+
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP_LENIENT("m", sub, "lenient test map"),
+    EASYJSONPARSER_END();
+
+  static const char * json[] = {
+    "{\"m\": {\"x\": [1, 2, }, \"a\": 1}}",
+    "{\"m\": {\"x\": {\"k\": 1], \"a\": 1}}",
+    "{\"m\": {\"x\": @@@, \"a\": 1}}",
+    "{\"m\": {\"x\": tru, \"a\": 1}}",
+    "{\"m\": {\"x\": [nul], \"a\": 1}}",
+    "{\"m\": {\"x\": {\"k\" 1 2}, \"a\": 1}}",
+    "{\"m\": {\"x\": [1 2], \"a\": 1}}",
+    "{\"m\": {\"x\": [+1], \"a\": 1}}",
+    "{\"m\": {\"x\": \"\\q\", \"a\": 1}}",
+  };
+
+  // Each backend has its own syntax error, but both must find it, indexed
+  // or not.
+  for (size_t i = 0; i < sizeof(json) / sizeof(json[0]); i++) {
+    for (size_t index_min = 0; index_min <= 1; index_min++) {
+      easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+      ctx->index_min = index_min ? SIZE_MAX : 0;
+      easyjsonparser_ctx_set_backend(ctx, EASYJSONPARSER_BACKEND_NATIVE);
+      ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json[i], ys, NULL), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+      easyjsonparser_ctx_free(ctx);
+    }
+    easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+    easyjsonparser_ctx_set_backend(ctx, EASYJSONPARSER_BACKEND_JSONC);
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json[i], ys, NULL), EASYJSONPARSER_ERROR_LIBJSONC_PARSE);
+    easyjsonparser_ctx_free(ctx);
+  }
+  ck_assert_int_eq(g_log_count_errs, 3 * sizeof(json) / sizeof(json[0]));
+}
+END_TEST
+
+START_TEST (parse_strict_json_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN)
+    EASYJSONPARSER_STR("s", NULL, "s test kvp"),
+    EASYJSONPARSER_INT("i", NULL, "i test kvp"),
+    EASYJSONPARSER_END();
+
+  // All accepted by json-c, so rejected by the check run after it, and
+  // rejected whether parsed or skipped.
+  static const char * json[] = {
+    "{\"s\": \"a\tb\"}",
+    "{\"s\": \"a\\n\x01\"}",
+    "{\"x\": [\"a\nb\"]}",
+    "{\"i\": 01}",
+    "{\"i\": -01}",
+    "{\"x\": [00]}",
+    "{\"x\": [1, 2,]}",
+    "{\"i\": NaN}",
+  };
+
+  for (size_t i = 0; i < sizeof(json) / sizeof(json[0]); i++) {
+    for (size_t b = 0; b < 3; b++) {
+      easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+      ctx->index_min = b == 1 ? 0 : SIZE_MAX;
+      easyjsonparser_ctx_set_backend(ctx, b < 2 ? EASYJSONPARSER_BACKEND_NATIVE : EASYJSONPARSER_BACKEND_JSONC);
+      ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json[i], ys, NULL), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+      easyjsonparser_ctx_free(ctx);
+    }
+  }
+  ck_assert_int_eq(g_log_count_errs, 3 * sizeof(json) / sizeof(json[0]));
+}
+END_TEST
+
+START_TEST (parse_invalid_utf8_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": \"ab\xed\xa0\x80\"}", ys, NULL), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (parse_too_deep_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_LST)
+    EASYJSONPARSER_END();
+
+  easyjsonparser_set_max_depth(4);
+  ck_assert_int_eq(easyjsonparser_parse_string("[[[[1]]], [[[]]]]", ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parse_string("[[[[[1]]]]]", ys, NULL), EASYJSONPARSER_ERROR_PARSE_DEPTH);
+  ck_assert_int_eq(g_log_count_errs, 1);
+  easyjsonparser_set_max_depth(EJP_MAX_DEPTH);
+}
+END_TEST
+
+START_TEST (parse_stop_when_complete_invalid_utf8_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP | EASYJSONPARSER_SCHEMA_IGN)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_schema * compiled_ys = easyjsonparser_schema_compile(ys);
+  ck_assert_ptr_ne(compiled_ys, NULL);
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_options(ctx, EASYJSONPARSER_OPTION_STOP_WHEN_COMPLETE);
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"bar\": [\"\xc0\xaf\"], \"foo\": \"fooval\"}", compiled_ys, NULL), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"foo\": \"foo\xed\xa0\x80\"}", compiled_ys, NULL), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  easyjsonparser_ctx_free(ctx);
+
+  ck_assert_int_eq(g_log_count_errs, 2);
+
+  easyjsonparser_schema_free(compiled_ys);
+}
+END_TEST
+
+START_TEST (cursor_mismatch_fails_errlogs)
+{
+  static const char * json = "{\"a\": \"x\", \"b\": [1, \"\xc0\xaf\"], \"c\": {\"d\": 1}";
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_cursor root, val;
+  int64_t ival;
+
+  ck_assert_int_eq(easyjsonparser_cursor_init(ctx, &root, json, strlen(json)), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "a", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_int(&val, &ival), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&val, "a", &val), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "b", &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_at(&val, 1, &val), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_cursor_get_str(&val, NULL, NULL), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  ck_assert_int_eq(easyjsonparser_cursor_find_key(&root, "e", &val), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+  ck_assert_int_eq(easyjsonparser_cursor_init(ctx, &root, " ", 1), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+
+  easyjsonparser_ctx_free(ctx);
+
+  ck_assert_int_eq(g_log_count_errs, 5);
+}
+END_TEST
+
+int write_nan_getter (easyjsonparser_stack * stack, easyjsonparser_schema * js, size_t n, easyjsonparser_value * val, void * extra)
+{
+  if (n > 1)
+    return EASYJSONPARSER_WRITE_NONE;
+
+  val->d = 0.0 / 0.0;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+START_TEST (write_fails_errlogs)
+{
+  static EASYJSONPARSER_SUBSCHEMA(sub_ys)
+    EASYJSONPARSER_DBL_FIELD("ratio", write_cfg, ratio, "ratio field"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub obj"),
+    EASYJSONPARSER_END();
+
+  write_cfg cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  char buf[16];
+
+  cfg.ratio = 0.0 / 0.0;
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, ys, &cfg, NULL), EASYJSONPARSER_ERROR_SCHEMA_UNWRITABLE);
+  ck_assert_int_eq(g_log_count_errs, 1);
+
+  cfg.ratio = 1234.5;
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, ys, &cfg, NULL), EASYJSONPARSER_ERROR_WRITE_OVERFLOW);
+  ck_assert_int_eq(g_log_count_errs, 2);
+
+  ck_assert_int_eq(easyjsonparser_write_fd(-1, ys, &cfg, NULL), EASYJSONPARSER_ERROR_FILEWRITE);
+  ck_assert_int_eq(g_log_count_errs, 3);
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_max_depth(ctx, 1);
+  char * out;
+  ck_assert_int_eq(easyjsonparser_ctx_write(ctx, &out, NULL, ys, &cfg, NULL), EASYJSONPARSER_ERROR_PARSE_DEPTH);
+  ck_assert_ptr_eq(out, NULL);
+  easyjsonparser_ctx_free(ctx);
+  ck_assert_int_eq(g_log_count_errs, 4);
+
+  // Entries without keys, the root and list elements, are still reported.
+  static EASYJSONPARSER_SCHEMA(dbl_ys, EASYJSONPARSER_SCHEMA_DBL)
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(list_ys, EASYJSONPARSER_SCHEMA_LST)
+    EASYJSONPARSER_DBL(NULL, NULL, "ratio"),
+    EASYJSONPARSER_END();
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, dbl_ys, NULL, write_nan_getter), EASYJSONPARSER_ERROR_SCHEMA_UNWRITABLE);
+  ck_assert_int_eq(easyjsonparser_write_buffer(buf, sizeof(buf), NULL, list_ys, NULL, write_nan_getter), EASYJSONPARSER_ERROR_SCHEMA_UNWRITABLE);
+  ck_assert_int_eq(g_log_count_errs, 6);
+}
+END_TEST
+
+START_TEST (parse_libjsonc_syntax_error_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": }", ys, NULL), EASYJSONPARSER_ERROR_LIBJSONC_PARSE);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (push_parse_incomplete_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_parser * parser = easyjsonparser_parser_new(ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"foo\": \"foo", 12), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_finish(parser), EASYJSONPARSER_ERROR_LIBJSONC_PARSE);
+  easyjsonparser_parser_free(parser);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (push_parse_schema_error_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_INT("bar", NULL, "bar test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_parser * parser = easyjsonparser_parser_new(ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"bar\": ", 8), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "\"x\"}", 4), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "\n", 1), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  ck_assert_int_eq(easyjsonparser_parser_finish(parser), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT);
+  easyjsonparser_parser_free(parser);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (push_parse_trailing_garbage_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_parser * parser = easyjsonparser_parser_new(ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"foo\": \"x\"} {", 15), EASYJSONPARSER_ERROR_PARSE_UNEXPECTED);
+  easyjsonparser_parser_free(parser);
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (push_parse_invalid_utf8_fails_errlogs)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("s", NULL, "s test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_parser * parser = easyjsonparser_parser_new(ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"s\":\"\xff\xfe\"}", 10), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  ck_assert_int_eq(easyjsonparser_parser_finish(parser), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  easyjsonparser_parser_free(parser);
+
+  // Bad only once the next chunk arrives.
+  parser = easyjsonparser_parser_new(ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"s\":\"\xc3", 7), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "A\"}", 3), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  easyjsonparser_parser_free(parser);
+
+  // Never finished.
+  parser = easyjsonparser_parser_new(ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"s\":\"\xe2\x82", 8), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_finish(parser), EASYJSONPARSER_ERROR_PARSE_UTF8);
+  easyjsonparser_parser_free(parser);
+
+  ck_assert_int_eq(g_log_count_errs, 3);
+}
+END_TEST
+
+START_TEST (ctx_parser_new_success)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  static EASYJSONPARSER_SCHEMA(list_ys, EASYJSONPARSER_SCHEMA_LST)
+    EASYJSONPARSER_END();
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_errhandler(ctx, test_quashing_errhandler);
+  easyjsonparser_ctx_set_max_depth(ctx, 2);
+
+  g_errhandler_count = 0;
+  easyjsonparser_parser * parser = easyjsonparser_ctx_parser_new(ctx, ys, NULL);
+  easyjsonparser_ctx_free(ctx);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "{\"foo\": \"fooval\", \"bar\": 1}", 27), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_finish(parser), EASYJSONPARSER_SUCCESS);
+  easyjsonparser_parser_free(parser);
+  ck_assert_int_eq(g_errhandler_count, 1);
+
+  ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_max_depth(ctx, 2);
+  parser = easyjsonparser_ctx_parser_new(ctx, list_ys, NULL);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "[[", 2), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_parser_feed(parser, "[1]]]", 5), EASYJSONPARSER_ERROR_PARSE_DEPTH);
+  easyjsonparser_parser_free(parser);
+  easyjsonparser_ctx_free(ctx);
+
+  ck_assert_int_eq(g_log_count_errs, 1);
+}
+END_TEST
+
+START_TEST (ctx_parse_reuse_success)
+{
+  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", calls_string_handler_callback_handler, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  ck_assert_ptr_ne(ctx, NULL);
+
+  calls_string_handler_callback_handler_callcount = 0;
+  for (int i = 0; i < 100; i++) {
+    easyjsonparser_ctx_set_backend(ctx, i % 2 ? EASYJSONPARSER_BACKEND_JSONC : EASYJSONPARSER_BACKEND_NATIVE);
+    ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"foo\": \"fooval\"}", empty_ys, NULL), EASYJSONPARSER_SUCCESS);
+    ck_assert_int_eq(easyjsonparser_ctx_parse_buffer(ctx, "{\"foo\": \"fooval\"}xyz", 17, empty_ys, NULL), EASYJSONPARSER_SUCCESS);
+  }
+  ck_assert_int_eq(calls_string_handler_callback_handler_callcount, 200);
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+START_TEST (ctx_parse_file_success)
+{
+  static EASYJSONPARSER_SCHEMA(empty_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  int fd = open("check_json_test_input_file.json", O_CREAT | O_WRONLY | O_TRUNC, 0666);
+  ck_assert_int_ge(fd, 0);
+  ck_assert_int_eq(write(fd, "{\"foo\": \"fooval\"}\n", strlen("{\"foo\": \"fooval\"}\n")), strlen("{\"foo\": \"fooval\"}\n"));
+  close(fd);
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  ck_assert_int_eq(easyjsonparser_ctx_parse_file(ctx, "check_json_test_input_file.json", empty_ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(easyjsonparser_ctx_parse_file(ctx, "check_json_test_input_file.json", empty_ys, NULL), EASYJSONPARSER_SUCCESS);
+  easyjsonparser_ctx_free(ctx);
+
+  unlink("check_json_test_input_file.json");
+}
+END_TEST
+
+START_TEST (ctx_errhandler_is_private)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_errhandler(ctx, test_quashing_errhandler);
+
+  g_errhandler_count = 0;
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"foo\": \"fooval\", \"bar\": 1}", ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 1);
+  ck_assert_int_eq(g_log_count_errs, 0);
+
+  ck_assert_int_eq(easyjsonparser_parse_string("{\"foo\": \"fooval\", \"bar\": 1}", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY);
+  ck_assert_int_eq(g_errhandler_count, 1);
+  ck_assert_int_eq(g_log_count_errs, 1);
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+START_TEST (ctx_errhandler_lazy)
+{
+  static EASYJSONPARSER_SCHEMA(sub_ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("sub", sub_ys, "sub test map"),
+    EASYJSONPARSER_END();
+
+  static const char * json = "{\"sub\": {\"foo\": \"fooval\", \"bar\": 1}}";
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_errhandler_lazy(ctx, test_lazy_quashing_errhandler);
+
+  g_errhandler_count = 0;
+  strcpy(g_lazy_path, "unset");
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 1);
+  ck_assert_str_eq(g_lazy_path, "");
+  ck_assert_int_eq(g_log_count_errs, 0);
+
+  easyjsonparser_ctx_set_errhandler_lazy(ctx, test_lazy_message_errhandler);
+
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 2);
+  ck_assert_str_eq(g_lazy_errmsg, "key bar unexpected while parsing map at /sub");
+  ck_assert_str_eq(g_lazy_path, "/sub");
+
+  easyjsonparser_ctx_set_errhandler(ctx, test_quashing_errhandler);
+
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, json, ys, NULL), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 3);
+  ck_assert_int_eq(g_log_count_errs, 0);
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+START_TEST (ctx_logger_is_private)
+{
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_STR("foo", NULL, "foo test kvp"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_logger(ctx, NULL);
+  easyjsonparser_ctx_set_loglevel(ctx, EASYJSONPARSER_LOG_LEVEL_NONE);
+
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"bar\": 1}", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY);
+  ck_assert_int_eq(g_log_count_errs, 0);
+
+  easyjsonparser_ctx_reset(ctx);
+  ck_assert_int_eq(easyjsonparser_ctx_parse_string(ctx, "{\"bar\": 1}", ys, NULL), EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY);
+  ck_assert_int_eq(g_log_count_errs, 1);
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+#define PARSE_THREADS_STRESS_THREADS 8
+#define PARSE_THREADS_STRESS_PARSES  500
+
+typedef struct {
+  int  thread_num;
+  int  use_ctx;
+  int  user_count;
+  int  uid_sum;
+  int  failures;
+} parse_threads_stress_state;
+
+pthread_key_t parse_threads_stress_path_key;
+
+void parse_threads_stress_password_handler (easyjsonparser_stack * stack, char * val, parse_threads_stress_state * state)
+{
+  char expected[64];
+  snprintf(expected, sizeof(expected), "/users/t%du%s/password", state->thread_num, val + strlen("pw"));
+
+  state->user_count++;
+  if (strcmp(easyjsonparser_stack_path(stack), expected) != 0)
+    state->failures++;
+}
+
+void parse_threads_stress_uid_handler (easyjsonparser_stack * stack, int val, parse_threads_stress_state * state)
+{
+  state->uid_sum += val;
+}
+
+int parse_threads_stress_errhandler (int err_code, const void * data, const char * reason, const char * errmsg)
+{
+  parse_threads_stress_state * state = pthread_getspecific(parse_threads_stress_path_key);
+
+  char expected[64];
+  snprintf(expected, sizeof(expected), "/users/t%du1/password", state->thread_num);
+  if (strcmp(((char **) data)[1], expected) != 0 || strstr(errmsg, expected) == NULL)
+    state->failures++;
+
+  return err_code;
+}
+
+void * parse_threads_stress_thread (void * arg)
+{
+  static EASYJSONPARSER_SUBSCHEMA(user_ys)
+    EASYJSONPARSER_STR("password", parse_threads_stress_password_handler, "user password"),
+    EASYJSONPARSER_INT("uid", parse_threads_stress_uid_handler, "user id"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SUBSCHEMA(users_ys)
+    EASYJSONPARSER_MAP(NULL, user_ys, "user"),
+    EASYJSONPARSER_END();
+  static EASYJSONPARSER_SCHEMA(ys, EASYJSONPARSER_SCHEMA_MAP)
+    EASYJSONPARSER_MAP("users", users_ys, "users"),
+    EASYJSONPARSER_END();
+
+  parse_threads_stress_state * state = arg;
+  pthread_setspecific(parse_threads_stress_path_key, state);
+
+  char good_json[256];
+  char bad_json[256];
+  int t = state->thread_num;
+  snprintf(good_json, sizeof(good_json),
+           "{\"users\": {\"t%du0\": {\"password\": \"pw0\", \"uid\": %d}, \"t%du1\": {\"password\": \"pw1\", \"uid\": %d}}}",
+           t, t, t, t + 1);
+  snprintf(bad_json, sizeof(bad_json),
+           "{\"users\": {\"t%du0\": {\"password\": \"pw0\", \"uid\": %d}, \"t%du1\": {\"password\": 1}}}",
+           t, t, t);
+
+  easyjsonparser_ctx * ctx = NULL;
+  if (state->use_ctx) {
+    ctx = easyjsonparser_ctx_new();
+    easyjsonparser_ctx_set_errhandler(ctx, parse_threads_stress_errhandler);
+    easyjsonparser_ctx_set_backend(ctx, t % 4 < 2 ? EASYJSONPARSER_BACKEND_NATIVE : EASYJSONPARSER_BACKEND_JSONC);
+  }
+
+  for (int i = 0; i < PARSE_THREADS_STRESS_PARSES; i++) {
+    int good_result = ctx != NULL
+      ? easyjsonparser_ctx_parse_string(ctx, good_json, ys, state)
+      : easyjsonparser_parse_string(good_json, ys, state);
+    int bad_result = ctx != NULL
+      ? easyjsonparser_ctx_parse_string(ctx, bad_json, ys, state)
+      : easyjsonparser_parse_string(bad_json, ys, state);
+
+    if (good_result != EASYJSONPARSER_SUCCESS || bad_result != EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING)
+      state->failures++;
+  }
+
+  easyjsonparser_ctx_free(ctx);
+
+  return NULL;
+}
+
+START_TEST (parse_threads_stress_success)
+{
+  pthread_t                  threads[PARSE_THREADS_STRESS_THREADS];
+  parse_threads_stress_state states[PARSE_THREADS_STRESS_THREADS];
+
+  // The process wide settings must not change while other threads parse.
+  easyjsonparser_set_logger(NULL);
+  easyjsonparser_set_loglevel(EASYJSONPARSER_LOG_LEVEL_NONE);
+
+  ck_assert_int_eq(pthread_key_create(&parse_threads_stress_path_key, NULL), 0);
+
+  for (int t = 0; t < PARSE_THREADS_STRESS_THREADS; t++) {
+    memset(&states[t], 0, sizeof(states[t]));
+    states[t].thread_num = t;
+    states[t].use_ctx    = t % 2;
+    ck_assert_int_eq(pthread_create(&threads[t], NULL, parse_threads_stress_thread, &states[t]), 0);
+  }
+
+  for (int t = 0; t < PARSE_THREADS_STRESS_THREADS; t++) {
+    ck_assert_int_eq(pthread_join(threads[t], NULL), 0);
+    ck_assert_int_eq(states[t].failures, 0);
+    ck_assert_int_eq(states[t].user_count, PARSE_THREADS_STRESS_PARSES * 3);
+    ck_assert_int_eq(states[t].uid_sum, PARSE_THREADS_STRESS_PARSES * (3 * t + 1));
+  }
+
+  pthread_key_delete(parse_threads_stress_path_key);
+  easyjsonparser_set_loglevel(EASYJSONPARSER_LOG_LEVEL_ERROR);
+}
+END_TEST
+
+START_TEST (stack_path_renders_empty_stack)
+{
+  easyjsonparser_stack stack1;
+  stack1.key  = NULL;
+  stack1.prev = NULL;
+
+  ck_assert_int_eq(strcmp(easyjsonparser_stack_path(&stack1), "/"), 0);
+}
+END_TEST
+
+START_TEST (stack_path_renders_nonempty_stack)
+{
+  easyjsonparser_stack stack1;
+  stack1.key  = NULL;
+  stack1.prev = NULL;
+  easyjsonparser_stack stack2;
+  stack2.key  = "foo";
+  stack2.prev = &stack1;
+
+  ck_assert_int_eq(strcmp(easyjsonparser_stack_path(&stack2), "/foo"), 0);
+
+  easyjsonparser_stack stack3;
+  stack3.key  = "bar";
+  stack3.prev = &stack2;
+
+  ck_assert_int_eq(strcmp(easyjsonparser_stack_path(&stack3), "/foo/bar"), 0);
+}
+END_TEST
+
+START_TEST (stack_path_r_renders_into_buffer)
+{
+  easyjsonparser_stack stack1;
+  stack1.key  = NULL;
+  stack1.prev = NULL;
+  easyjsonparser_stack stack2;
+  stack2.key  = "foo";
+  stack2.prev = &stack1;
+  easyjsonparser_stack stack3;
+  stack3.key  = "bar";
+  stack3.prev = &stack2;
+
+  char buf[16];
+  ck_assert_ptr_eq(easyjsonparser_stack_path_r(&stack3, buf, sizeof(buf)), buf);
+  ck_assert_int_eq(strcmp(buf, "/foo/bar"), 0);
+
+  char small_buf[7];
+  ck_assert_int_eq(strcmp(easyjsonparser_stack_path_r(&stack3, small_buf, sizeof(small_buf)), "/foo/b"), 0);
+}
+END_TEST
+
+
+// Fixtures.
+
+void setup_logger (void)
+{
+  g_log_count_all  = 0;
+  g_log_count_errs = 0;
+
+  easyjsonparser_set_logger(test_logger);
+}
+
+void teardown_logger (void)
+{
+  easyjsonparser_set_logger(NULL);
+}
+
+void setup_default_logger (void)
+{
+  easyjsonparser_set_loglevel(EASYJSONPARSER_LOG_LEVEL_ERROR);
+  easyjsonparser_set_logger(NULL);
+}
+
+void teardown_default_logger (void)
+{
+  easyjsonparser_set_logger(NULL);
+}
+
+void setup_passthrough_errhandler (void)
+{
+  easyjsonparser_set_errhandler(test_passthrough_errhandler);
+}
+
+void teardown_passthrough_errhandler (void)
+{
+  easyjsonparser_set_errhandler(NULL);
+}
+
+void setup_quashing_errhandler (void)
+{
+  easyjsonparser_set_errhandler(test_quashing_errhandler);
+}
+
+void teardown_quashing_errhandler (void)
+{
+  easyjsonparser_set_errhandler(NULL);
+}
+
+void setup_jsonc_backend (void)
+{
+  easyjsonparser_set_backend(EASYJSONPARSER_BACKEND_JSONC);
+}
+
+void teardown_jsonc_backend (void)
+{
+  easyjsonparser_set_backend(EASYJSONPARSER_BACKEND_NATIVE);
+}
+
+
+// Suite.
+
+void parse_success_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  tcase_add_test(tc, parse_kvp_str_success);
+  tcase_add_test(tc, parse_kvp_int_success);
+  tcase_add_test(tc, parse_kvp_double_success);
+  tcase_add_test(tc, parse_kvp_boolean_success);
+  tcase_add_test(tc, parse_sub_kvp_str_success);
+  tcase_add_test(tc, parse_sub_kvp_int_success);
+  tcase_add_test(tc, parse_sub_map_str_success);
+  tcase_add_test(tc, parse_sub_freekey_success);
+  tcase_add_test(tc, parse_sublist_str_success);
+  tcase_add_test(tc, parse_sublist_int_success);
+  tcase_add_test(tc, parse_sublist_map_success);
+  tcase_add_test(tc, parse_mixed_list_success);
+  tcase_add_test(tc, parse_mixed_list_first_match);
+  tcase_add_test(tc, calls_string_handler_callback);
+  tcase_add_test(tc, calls_int_handler_callback);
+  tcase_add_test(tc, calls_double_handler_callback);
+  tcase_add_test(tc, calls_boolean_handler_callback);
+  tcase_add_test(tc, handler_callback_stack_traces_path);
+  tcase_add_test(tc, calls_string_handler_unescapes);
+  tcase_add_test(tc, calls_string_handler_unescapes_long);
+  tcase_add_test(tc, calls_string_view_handler_callback);
+  tcase_add_test(tc, parse_fields_success);
+  tcase_add_test(tc, parse_lone_surrogate_success);
+  tcase_add_test(tc, parse_i64_success);
+  tcase_add_test(tc, parse_typed_arrays_success);
+  tcase_add_test(tc, parse_doubles_exact_success);
+  tcase_add_test(tc, parse_arena_success);
+  tcase_add_test(tc, parse_intern_success);
+  tcase_add_test(tc, parse_indexed_success);
+  tcase_add_test(tc, parse_trusted_input_success);
+  tcase_add_test(tc, compiled_parse_nested_success);
+  tcase_add_test(tc, compiled_parse_many_keys_success);
+  tcase_add_test(tc, parse_buffer_success);
+  tcase_add_test(tc, parse_file_success);
+  tcase_add_test(tc, parse_file_large_success);
+  tcase_add_test(tc, parse_file_fifo_success);
+  tcase_add_test(tc, push_parse_bytewise_success);
+  tcase_add_test(tc, push_parse_chunked_success);
+  tcase_add_test(tc, push_parse_split_utf8_success);
+  tcase_add_test(tc, stack_path_renders_empty_stack);
+  tcase_add_test(tc, stack_path_renders_nonempty_stack);
+  tcase_add_test(tc, stack_path_r_renders_into_buffer);
+}
+
+void parse_failure_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  tcase_add_test(tc, parse_unknown_key_somekeys_fails_errlogs);
+  tcase_add_test(tc, parse_badschema_fails_errlogs);
+  tcase_add_test(tc, parse_file_nonexisting_fails_errlogs);
+  tcase_add_test(tc, parse_expected_list_fails_errlogs);
+  tcase_add_test(tc, parse_expected_map_fails_errlogs);
+  tcase_add_test(tc, parse_expected_str_fails_errlogs);
+  tcase_add_test(tc, parse_expected_int_fails_errlogs);
+  tcase_add_test(tc, parse_invalid_utf8_fails_errlogs);
+  tcase_add_test(tc, parse_lenient_malformed_fails_errlogs);
+  tcase_add_test(tc, parse_strict_json_fails_errlogs);
+  tcase_add_test(tc, parse_too_deep_fails_errlogs);
+  tcase_add_test(tc, schema_compile_invalid_fails_errlogs);
+  tcase_add_test(tc, schema_compile_nochildren_fails_errlogs);
+  tcase_add_test(tc, push_parse_incomplete_fails_errlogs);
+  tcase_add_test(tc, push_parse_schema_error_fails_errlogs);
+  tcase_add_test(tc, push_parse_trailing_garbage_fails_errlogs);
+  tcase_add_test(tc, push_parse_invalid_utf8_fails_errlogs);
+}
+
+void native_parse_failure_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  tcase_add_test(tc, parse_syntax_error_fails_errlogs);
+  tcase_add_test(tc, parse_trailing_garbage_fails_errlogs);
+  tcase_add_test(tc, parse_unterminated_fails_errlogs);
+  tcase_add_test(tc, parse_indexed_unterminated_fails_errlogs);
+  tcase_add_test(tc, parse_lenient_unterminated_fails_errlogs);
+  tcase_add_test(tc, parse_stop_when_complete_invalid_utf8_fails_errlogs);
+  tcase_add_test(tc, cursor_mismatch_fails_errlogs);
+  tcase_add_test(tc, write_fails_errlogs);
+}
+
+void jsonc_parse_failure_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  tcase_add_test(tc, parse_libjsonc_syntax_error_fails_errlogs);
+}
+
+void jsonc_backend_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  parse_success_tests(tc, s, tags, fixtures, extra);
+  parse_failure_tests(tc, s, tags, fixtures, extra);
+  jsonc_parse_failure_tests(tc, s, tags, fixtures, extra);
+}
+
+void ctx_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  tcase_add_test(tc, ctx_parse_reuse_success);
+  tcase_add_test(tc, ctx_parse_file_success);
+  tcase_add_test(tc, ctx_errhandler_is_private);
+  tcase_add_test(tc, ctx_errhandler_lazy);
+  tcase_add_test(tc, ctx_parser_new_success);
+  tcase_add_test(tc, ctx_logger_is_private);
+  tcase_add_test(tc, parse_threads_stress_success);
+  tcase_add_test(tc, arena_alloc_success);
+  tcase_add_test(tc, intern_add_success);
+  tcase_add_test(tc, utf8_validate_success);
+  tcase_add_test(tc, parse_stop_when_complete_success);
+  tcase_add_test(tc, parse_deep_nesting_success);
+  tcase_add_test(tc, cursor_success);
+  tcase_add_test(tc, codegen_parse_success);
+  tcase_add_test(tc, write_success);
+  tcase_add_test(tc, write_strings_success);
+  tcase_add_test(tc, write_numbers_success);
+  tcase_add_test(tc, write_fd_success);
+}
+
+void parse_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  parse_success_tests(tc, s, tags, fixtures, extra);
+  parse_failure_tests(tc, s, tags, fixtures, extra);
+  native_parse_failure_tests(tc, s, tags, fixtures, extra);
+
+  build_suite(add_tag(tags, "ctx"),
+              fixtures,
+              ctx_tests,
+              s, NULL);
+
+  build_suite(add_tag(tags, "jsonc_backend"),
+              add_fixture(fixtures, setup_jsonc_backend, teardown_jsonc_backend),
+              jsonc_backend_tests,
+              s, NULL);
+
+  build_suite(add_tag(tags, "alt_errhandler"),
+              add_fixture(fixtures, setup_passthrough_errhandler, teardown_passthrough_errhandler),
+              parse_failure_tests,
+              s, NULL);
+}
+
+void default_logger_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  tcase_add_test(tc, parse_kvp_str_success);
+  tcase_add_test(tc, parse_kvp_str_success_with_trace_log);
+  tcase_add_test(tc, parse_unknown_key_somekeys_fails);
+}
+
+void errhandler_override_tests (TCase * tc, Suite * s, char ** tags, void (**fixtures)(), void * extra)
+{
+  tcase_add_test(tc, parse_unknown_key_nokeys_success);
+  tcase_add_test(tc, parse_unknown_key_somekeys_success);
+  tcase_add_test(tc, parse_unknown_key_subtree_success);
+  tcase_add_test(tc, parse_mismatch_quashed_skips_value);
+  tcase_add_test(tc, cursor_mismatch_quashed_fails);
+  tcase_add_test(tc, parse_lenient_map_success);
+  tcase_add_test(tc, write_unwritable_quashed_omits_value);
+}
+
+Suite * mk_suite()
+{
+  Suite * s = suite_create("easyjsonparser");
+
+  char ** tags        = new_tags();
+  void (**fixtures)() = new_fixtures();
 
   build_suite(add_tag(tags, "parse"),
               add_fixture(fixtures, setup_logger, teardown_logger),
@@ -624,6 +3173,12 @@ Suite * mk_suite()
               errhandler_override_tests,
               s, NULL);
 
+  build_suite(add_tag(add_tag(tags, "quash_errors"), "jsonc_backend"),
+              add_fixture(add_fixture(fixtures, setup_quashing_errhandler, teardown_quashing_errhandler),
+                          setup_jsonc_backend, teardown_jsonc_backend),
+              errhandler_override_tests,
+              s, NULL);
+
   return s;
 }
 
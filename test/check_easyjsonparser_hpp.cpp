@@ -0,0 +1,475 @@
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "easyjsonparser_check.h"
+
+#include "easyjsonparser.hpp"
+
+
+// Globals set by the error handler callbacks.
+
+int g_errhandler_count = 0;
+int g_errhandler_code  = EASYJSONPARSER_SUCCESS;
+
+
+// Error handler callbacks.
+
+int test_passthrough_errhandler (int err_code, const void * data, const char * reason, const char * errmsg)
+{
+  g_errhandler_count++;
+  g_errhandler_code = err_code;
+
+  return err_code;
+}
+
+int test_quashing_errhandler (int err_code, const void * data, const char * reason, const char * errmsg)
+{
+  g_errhandler_count++;
+  g_errhandler_code = err_code;
+
+  return EASYJSONPARSER_SUCCESS;
+}
+
+
+// Configuration parsed into.
+
+struct hpp_cfg {
+  std::string                   name;
+  int                           port     = 0;
+  int64_t                       ts       = 0;
+  double                        ratio    = 0;
+  bool                          ssl      = false;
+  int                           nulls    = 0;
+  std::map<std::string, int>    users;
+  std::vector<std::string>      log;
+  std::string                   last_path;
+};
+
+void hpp_log_str (easyjsonparser_stack * stack, std::string_view val, hpp_cfg & cfg)
+{
+  cfg.log.push_back("str:" + std::string(val));
+  cfg.last_path = easyjsonparser_stack_path(stack);
+}
+
+constexpr auto hpp_schema = ejp::map(nullptr, "test config",
+  ejp::str("name", &hpp_cfg::name, "name"),
+  ejp::integer("port", &hpp_cfg::port, "port"),
+  ejp::i64("ts", [](int64_t ts, hpp_cfg & cfg) { cfg.ts = ts; }, "timestamp"),
+  ejp::dbl("ratio", &hpp_cfg::ratio, "ratio"),
+  ejp::boo("ssl", &hpp_cfg::ssl, "use SSL"),
+  ejp::nul("unset", [](hpp_cfg & cfg) { cfg.nulls++; }, "unset"),
+  ejp::str("ignored", nullptr, "ignored"),
+  ejp::map("users", "users by name",
+    ejp::integer(nullptr, [](easyjsonparser_stack * stack, int uid, hpp_cfg & cfg) { cfg.users[stack->key] = uid; }, "uid")),
+  ejp::lst("log", "mixed list",
+    ejp::str(nullptr, hpp_log_str, "string element"),
+    ejp::integer(nullptr, [](int n, hpp_cfg & cfg) { cfg.log.push_back("int:" + std::to_string(n)); }, "int element"),
+    ejp::map(nullptr, "map element",
+      ejp::str("msg", hpp_log_str, "message"))),
+  ejp::map_lenient("extra", "lenient map",
+    ejp::boo("known", nullptr, "known key")));
+
+
+// Tests.
+
+START_TEST (hpp_parse_success)
+{
+  static const char json[] =
+    "{\"name\": \"srv\", \"port\": 8080, \"ts\": 9007199254740993, \"ratio\": 0.5,"
+    " \"ssl\": true, \"unset\": null, \"ignored\": \"x\","
+    " \"users\": {\"bob\": 1000, \"alice\": 1001},"
+    " \"log\": [\"a\", 2, {\"msg\": \"m\"}, \"b\"],"
+    " \"extra\": {\"known\": false, \"unknown\": [1, {\"x\": 2}]}}";
+
+  hpp_cfg cfg;
+  ck_assert_int_eq(ejp::parse_string(json, hpp_schema, cfg), EASYJSONPARSER_SUCCESS);
+
+  ck_assert_str_eq(cfg.name.c_str(), "srv");
+  ck_assert_int_eq(cfg.port, 8080);
+  ck_assert(cfg.ts == INT64_C(9007199254740993));
+  ck_assert(cfg.ratio == 0.5);
+  ck_assert(cfg.ssl);
+  ck_assert_int_eq(cfg.nulls, 1);
+  ck_assert_int_eq(cfg.users.size(), 2);
+  ck_assert_int_eq(cfg.users["bob"], 1000);
+  ck_assert_int_eq(cfg.users["alice"], 1001);
+  ck_assert_int_eq(cfg.log.size(), 4);
+  ck_assert_str_eq(cfg.log[0].c_str(), "str:a");
+  ck_assert_str_eq(cfg.log[1].c_str(), "int:2");
+  ck_assert_str_eq(cfg.log[2].c_str(), "str:m");
+  ck_assert_str_eq(cfg.log[3].c_str(), "str:b");
+  ck_assert_str_eq(cfg.last_path.c_str(), "/log");
+
+  hpp_cfg empty;
+  ck_assert_int_eq(ejp::parse_string("{}", hpp_schema, empty), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(ejp::parse_string(" { \"users\": {}, \"log\": [] } ", hpp_schema, empty), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(empty.users.size(), 0);
+  ck_assert_int_eq(empty.log.size(), 0);
+}
+END_TEST
+
+START_TEST (hpp_parse_ctx_success)
+{
+  constexpr auto schema = ejp::lst(nullptr, "numbers",
+    ejp::integer(nullptr, [](int n, std::vector<int> & v) { v.push_back(n); }, "number"));
+
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  std::string json = "[1, 2, 3]";
+
+  for (int i = 0; i < 3; i++) {
+    std::vector<int> v;
+    ck_assert_int_eq(ejp::parse_buffer(ctx, json.data(), json.size(), schema, v), EASYJSONPARSER_SUCCESS);
+    ck_assert_int_eq(v.size(), 3);
+    ck_assert_int_eq(v[2], 3);
+  }
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+START_TEST (hpp_parse_fails)
+{
+  easyjsonparser_set_errhandler(test_passthrough_errhandler);
+
+  struct {
+    const char * json;
+    int          code;
+  } cases[] = {
+    { "{\"nokey\": 1}",            EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY },
+    { "{\"port\": \"80\"}",        EASYJSONPARSER_ERROR_SCHEMA_MANDATES_INT },
+    { "{\"ratio\": 1}",            EASYJSONPARSER_ERROR_SCHEMA_MANDATES_DOUBLE },
+    { "{\"users\": []}",           EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP },
+    { "{\"log\": [true]}",         EASYJSONPARSER_ERROR_SCHEMA_MANDATES_STRING },
+    { "[]",                        EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP },
+    { "{\"port\": 1",              EASYJSONPARSER_ERROR_PARSE_UNEXPECTED },
+    { "{\"port\": 1} x",           EASYJSONPARSER_ERROR_PARSE_UNEXPECTED },
+    { "{\"name\": \"\xff\"}",      EASYJSONPARSER_ERROR_PARSE_UTF8 },
+  };
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    hpp_cfg cfg;
+    g_errhandler_count = 0;
+    ck_assert_int_eq(ejp::parse_string(cases[i].json, hpp_schema, cfg), cases[i].code);
+    ck_assert_int_eq(g_errhandler_count, 1);
+    ck_assert_int_eq(g_errhandler_code, cases[i].code);
+  }
+
+  easyjsonparser_set_errhandler(NULL);
+}
+END_TEST
+
+START_TEST (hpp_parse_quashed_success)
+{
+  easyjsonparser_set_errhandler(test_quashing_errhandler);
+
+  hpp_cfg cfg;
+  g_errhandler_count = 0;
+  ck_assert_int_eq(ejp::parse_string("{\"nokey\": {\"a\": [1]}, \"port\": \"80\", \"log\": [true, \"a\"], \"name\": \"n\"}", hpp_schema, cfg),
+                   EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 3);
+  ck_assert_int_eq(cfg.port, 0);
+  ck_assert_int_eq(cfg.log.size(), 1);
+  ck_assert_str_eq(cfg.name.c_str(), "n");
+
+  easyjsonparser_set_errhandler(NULL);
+}
+END_TEST
+
+START_TEST (hpp_parse_list_first_match)
+{
+  constexpr auto schema = ejp::lst(nullptr, "items",
+    ejp::str(nullptr, [](std::string_view s, std::vector<std::string> & v) { v.push_back("s:" + std::string(s)); }, "string"),
+    ejp::str(nullptr, [](std::string_view s, std::vector<std::string> & v) { v.push_back("again:" + std::string(s)); }, "string again"),
+    ejp::map("text", "note",
+      ejp::str("text", [](std::string_view s, std::vector<std::string> & v) { v.push_back("text:" + std::string(s)); }, "note text"),
+      ejp::str("url", nullptr, "note url")),
+    ejp::map(nullptr, "link",
+      ejp::str("url", [](std::string_view s, std::vector<std::string> & v) { v.push_back("url:" + std::string(s)); }, "link url")));
+
+  std::vector<std::string> v;
+  ck_assert_int_eq(ejp::parse_string("[\"a\", {\"url\": \"x\", \"text\": \"y\"}, {\"url\": \"z\"}, \"b\"]", schema, v), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(v.size(), 4);
+  ck_assert_str_eq(v[0].c_str(), "s:a");
+  ck_assert_str_eq(v[1].c_str(), "text:y");
+  ck_assert_str_eq(v[2].c_str(), "url:z");
+  ck_assert_str_eq(v[3].c_str(), "s:b");
+
+  constexpr auto keyed = ejp::lst(nullptr, "notes",
+    ejp::map("text", "note",
+      ejp::str("text", nullptr, "note text")));
+
+  easyjsonparser_set_errhandler(test_passthrough_errhandler);
+  g_errhandler_count = 0;
+  ck_assert_int_eq(ejp::parse_string("[{\"text\": \"y\"}, {}]", keyed, v), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP);
+  ck_assert_int_eq(g_errhandler_count, 1);
+  easyjsonparser_set_errhandler(NULL);
+}
+END_TEST
+
+
+// Return the events pulled by \p parser, one word each.
+
+std::string hpp_pull_trace (ejp::pull_parser & parser)
+{
+  std::string trace;
+
+  for (auto & ev : parser) {
+    if (!trace.empty())
+      trace += ' ';
+    if (!ev.key.empty() && ev.type != ejp::event_type::map_end && ev.type != ejp::event_type::list_end)
+      trace += std::string(ev.key) + ':';
+    switch (ev.type) {
+    case ejp::event_type::map_begin:  trace += '{'; break;
+    case ejp::event_type::map_end:    trace += '}'; break;
+    case ejp::event_type::list_begin: trace += '['; break;
+    case ejp::event_type::list_end:   trace += ']'; break;
+    case ejp::event_type::str:        trace += "s(" + std::string(ev.str) + ')'; break;
+    case ejp::event_type::integer:    trace += "i(" + std::to_string(ev.integer) + ')'; break;
+    case ejp::event_type::dbl:        trace += "d(" + std::to_string(ev.dbl) + ')'; break;
+    case ejp::event_type::boolean:    trace += ev.boolean ? "true" : "false"; break;
+    case ejp::event_type::null:       trace += "null"; break;
+    }
+  }
+
+  return trace;
+}
+
+static EASYJSONPARSER_SCHEMA(hpp_pull_user_schema, EASYJSONPARSER_SCHEMA_MAP)
+  EASYJSONPARSER_I64("uid", NULL, "user id"),
+  EASYJSONPARSER_END();
+
+static EASYJSONPARSER_SCHEMA(hpp_pull_group_schema, EASYJSONPARSER_SCHEMA_MAP)
+  EASYJSONPARSER_STR("group", NULL, "group name"),
+  EASYJSONPARSER_END();
+
+static EASYJSONPARSER_SCHEMA(hpp_pull_users_schema, EASYJSONPARSER_SCHEMA_MAP)
+  EASYJSONPARSER_MAP(NULL, hpp_pull_user_schema + 1, "user by name"),
+  EASYJSONPARSER_END();
+
+static EASYJSONPARSER_SCHEMA(hpp_pull_members_schema, EASYJSONPARSER_SCHEMA_LST)
+  EASYJSONPARSER_MAP("group", hpp_pull_group_schema + 1, "group member"),
+  EASYJSONPARSER_MAP(NULL, hpp_pull_user_schema + 1, "user member"),
+  EASYJSONPARSER_STR(NULL, NULL, "name member"),
+  EASYJSONPARSER_END();
+
+static EASYJSONPARSER_SCHEMA(hpp_pull_extra_schema, EASYJSONPARSER_SCHEMA_MAP)
+  EASYJSONPARSER_BOO("known", NULL, "known key"),
+  EASYJSONPARSER_END();
+
+static EASYJSONPARSER_SCHEMA(hpp_pull_schema, EASYJSONPARSER_SCHEMA_MAP)
+  EASYJSONPARSER_STR("name", NULL, "name"),
+  EASYJSONPARSER_INT("port", NULL, "port"),
+  EASYJSONPARSER_DBL("ratio", NULL, "ratio"),
+  EASYJSONPARSER_NUL("unset", NULL, "unset"),
+  EASYJSONPARSER_MAP("users", hpp_pull_users_schema + 1, "users"),
+  EASYJSONPARSER_LST("members", hpp_pull_members_schema + 1, "members"),
+  EASYJSONPARSER_DBL_ARRAY("weights", NULL, "weights"),
+  EASYJSONPARSER_MAP_LENIENT("extra", hpp_pull_extra_schema + 1, "lenient map"),
+  EASYJSONPARSER_END();
+
+START_TEST (hpp_pull_success)
+{
+  static const char json[] =
+    "{\"name\": \"srv\", \"port\": 99999999999, \"ratio\": 0.5, \"unset\": null,"
+    " \"users\": {\"bob\": {\"uid\": 1000}, \"al\\u0069ce\": {}},"
+    " \"members\": [{\"uid\": 7}, \"carol\", {\"group\": \"wheel\"}],"
+    " \"weights\": [1, 2.5],"
+    " \"extra\": {\"unknown\": [1, 2], \"known\": true}}";
+
+  ejp::pull_parser schemaless(json, sizeof(json) - 1);
+  ck_assert_str_eq(hpp_pull_trace(schemaless).c_str(),
+                   "{ name:s(srv) port:i(99999999999) ratio:d(0.500000) unset:null"
+                   " users:{ bob:{ uid:i(1000) } alice:{ } }"
+                   " members:[ { uid:i(7) } s(carol) { group:s(wheel) } ]"
+                   " weights:[ i(1) d(2.500000) ]"
+                   " extra:{ unknown:[ i(1) i(2) ] known:true } }");
+  ck_assert_int_eq(schemaless.result(), EASYJSONPARSER_SUCCESS);
+
+  auto checked = ejp::events(json, hpp_pull_schema);
+  ck_assert_str_eq(hpp_pull_trace(checked).c_str(),
+                   "{ name:s(srv) port:i(2147483647) ratio:d(0.500000) unset:null"
+                   " users:{ bob:{ uid:i(1000) } alice:{ } }"
+                   " members:[ { uid:i(7) } s(carol) { group:s(wheel) } ]"
+                   " weights:[ d(1.000000) d(2.500000) ]"
+                   " extra:{ known:true } }");
+  ck_assert_int_eq(checked.result(), EASYJSONPARSER_SUCCESS);
+
+  auto empty = ejp::events("[]");
+  ck_assert_str_eq(hpp_pull_trace(empty).c_str(), "[ ]");
+  auto scalar = ejp::events(" 42 ");
+  ck_assert_str_eq(hpp_pull_trace(scalar).c_str(), "i(42)");
+}
+END_TEST
+
+START_TEST (hpp_pull_stack_success)
+{
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  std::vector<std::string> paths;
+
+  static const char json[] = "{\"users\": {\"bob\": {\"uid\": 1000}}, \"members\": [{\"uid\": 7}]}";
+  ejp::pull_parser parser(ctx, json, sizeof(json) - 1, hpp_pull_schema);
+  ejp::event ev;
+  while (parser.next(ev) == EASYJSONPARSER_SUCCESS)
+    if (ev.type == ejp::event_type::integer) {
+      paths.push_back(easyjsonparser_stack_path(ev.stack));
+      ck_assert_ptr_ne(ev.schema, NULL);
+      ck_assert_str_eq(ev.schema->key, "uid");
+    }
+
+  ck_assert_int_eq(parser.next(ev), EASYJSONPARSER_ERROR_CURSOR_NOT_FOUND);
+  ck_assert_int_eq(parser.result(), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(paths.size(), 2);
+  ck_assert_str_eq(paths[0].c_str(), "/users/bob/uid");
+  ck_assert_str_eq(paths[1].c_str(), "/members/uid");
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+START_TEST (hpp_pull_skip_success)
+{
+  static const char json[] = "{\"users\": {\"bob\": {\"uid\": 1000}}, \"port\": 80, \"members\": []}";
+  ejp::pull_parser parser(json, sizeof(json) - 1, hpp_pull_schema);
+  std::string trace;
+  ejp::event ev;
+
+  while (parser.next(ev) == EASYJSONPARSER_SUCCESS) {
+    trace += std::string(ev.key) + ' ';
+    if (ev.key == "users" || ev.key == "members")
+      ck_assert_int_eq(parser.skip(), EASYJSONPARSER_SUCCESS);
+  }
+
+  ck_assert_str_eq(trace.c_str(), " users port members  ");
+  ck_assert_int_eq(parser.result(), EASYJSONPARSER_SUCCESS);
+}
+END_TEST
+
+START_TEST (hpp_pull_fails)
+{
+  easyjsonparser_set_errhandler(test_passthrough_errhandler);
+
+  struct {
+    const char * json;
+    const char * trace;
+    int          code;
+  } cases[] = {
+    { "{\"port\": 1, \"nokey\": 1}", "{ port:i(1)",       EASYJSONPARSER_ERROR_SCHEMA_UNEXPECTED_KEY },
+    { "{\"ratio\": 1}",              "{",                 EASYJSONPARSER_ERROR_SCHEMA_MANDATES_DOUBLE },
+    { "{\"users\": []}",             "{",                 EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP },
+    { "{\"members\": [1]}",          "{ members:[",       EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP },
+    { "{\"weights\": [\"a\"]}",      "{ weights:[",       EASYJSONPARSER_ERROR_SCHEMA_MANDATES_DOUBLE },
+    { "[]",                          "",                  EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP },
+    { "{\"port\": 1",                "{ port:i(1)",       EASYJSONPARSER_ERROR_PARSE_UNEXPECTED },
+    { "{\"port\": 1} x",             "{ port:i(1) }",     EASYJSONPARSER_ERROR_PARSE_UNEXPECTED },
+    { "{\"name\": \"\xff\"}",        "",                  EASYJSONPARSER_ERROR_PARSE_UTF8 },
+  };
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    g_errhandler_count = 0;
+    auto parser = ejp::events(cases[i].json, hpp_pull_schema);
+    ck_assert_str_eq(hpp_pull_trace(parser).c_str(), cases[i].trace);
+    ck_assert_int_eq(parser.result(), cases[i].code);
+    ck_assert_int_eq(g_errhandler_count, 1);
+    ck_assert_int_eq(g_errhandler_code, cases[i].code);
+  }
+
+  easyjsonparser_set_errhandler(test_quashing_errhandler);
+
+  g_errhandler_count = 0;
+  auto parser = ejp::events("{\"nokey\": {\"a\": [1]}, \"port\": \"80\", \"members\": [true, \"a\"], \"name\": \"n\"}", hpp_pull_schema);
+  ck_assert_str_eq(hpp_pull_trace(parser).c_str(), "{ members:[ s(a) ] name:s(n) }");
+  ck_assert_int_eq(parser.result(), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 3);
+
+  easyjsonparser_set_errhandler(NULL);
+}
+END_TEST
+
+START_TEST (hpp_pull_depth_fails)
+{
+  easyjsonparser_ctx * ctx = easyjsonparser_ctx_new();
+  easyjsonparser_ctx_set_errhandler(ctx, test_passthrough_errhandler);
+  easyjsonparser_ctx_set_max_depth(ctx, 3);
+
+  static const char ok[] = "[[{\"a\": 1}]]";
+  ejp::pull_parser fits(ctx, ok, sizeof(ok) - 1);
+  ck_assert_str_eq(hpp_pull_trace(fits).c_str(), "[ [ { a:i(1) } ] ]");
+  ck_assert_int_eq(fits.result(), EASYJSONPARSER_SUCCESS);
+
+  std::string deep(100000, '[');
+  g_errhandler_count = 0;
+  ejp::pull_parser parser(ctx, deep.data(), deep.size());
+  ck_assert_str_eq(hpp_pull_trace(parser).c_str(), "[ [ [");
+  ck_assert_int_eq(parser.result(), EASYJSONPARSER_ERROR_PARSE_DEPTH);
+  ck_assert_int_eq(g_errhandler_count, 1);
+  ck_assert_int_eq(g_errhandler_code, EASYJSONPARSER_ERROR_PARSE_DEPTH);
+
+  easyjsonparser_ctx_free(ctx);
+}
+END_TEST
+
+START_TEST (hpp_pull_list_keyed_fails)
+{
+  static EASYJSONPARSER_SCHEMA(groups_schema, EASYJSONPARSER_SCHEMA_LST)
+    EASYJSONPARSER_MAP("group", hpp_pull_group_schema + 1, "group member"),
+    EASYJSONPARSER_END();
+
+  easyjsonparser_set_errhandler(test_passthrough_errhandler);
+
+  g_errhandler_count = 0;
+  auto parser = ejp::events("[{\"group\": \"wheel\"}, {\"uid\": 7}]", groups_schema);
+  ck_assert_str_eq(hpp_pull_trace(parser).c_str(), "[ { group:s(wheel) }");
+  ck_assert_int_eq(parser.result(), EASYJSONPARSER_ERROR_SCHEMA_MANDATES_MAP);
+  ck_assert_int_eq(g_errhandler_count, 1);
+
+  easyjsonparser_set_errhandler(test_quashing_errhandler);
+
+  g_errhandler_count = 0;
+  auto quashed = ejp::events("[{\"uid\": 7}, {\"group\": \"wheel\"}]", groups_schema);
+  ck_assert_str_eq(hpp_pull_trace(quashed).c_str(), "[ { group:s(wheel) } ]");
+  ck_assert_int_eq(quashed.result(), EASYJSONPARSER_SUCCESS);
+  ck_assert_int_eq(g_errhandler_count, 1);
+
+  easyjsonparser_set_errhandler(NULL);
+}
+END_TEST
+
+
+// Suite.
+
+Suite * mk_suite ()
+{
+  Suite * s  = suite_create("easyjsonparser_hpp");
+  TCase * tc = tcase_create("hpp");
+
+  tcase_add_test(tc, hpp_parse_success);
+  tcase_add_test(tc, hpp_parse_ctx_success);
+  tcase_add_test(tc, hpp_parse_fails);
+  tcase_add_test(tc, hpp_parse_quashed_success);
+  tcase_add_test(tc, hpp_parse_list_first_match);
+  tcase_add_test(tc, hpp_pull_success);
+  tcase_add_test(tc, hpp_pull_stack_success);
+  tcase_add_test(tc, hpp_pull_skip_success);
+  tcase_add_test(tc, hpp_pull_fails);
+  tcase_add_test(tc, hpp_pull_depth_fails);
+  tcase_add_test(tc, hpp_pull_list_keyed_fails);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+
+int main ()
+{
+  Suite * s = mk_suite();
+
+  SRunner * sr = srunner_create(s);
+  srunner_run_all(sr, EASYJSONPARSER_CHECK_SRUNNER_FLAGS);
+  int num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}